@@ -0,0 +1,62 @@
+#include "Histogram.h"
+
+#include <stdio.h>
+
+void Histogram::reset()
+{
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        counts_[i].store(0, std::memory_order_relaxed);
+    }
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+Histogram::Snapshot Histogram::snapshot() const
+{
+    Snapshot snapshot;
+    snapshot.count = 0;
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        snapshot.counts[i] = counts_[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.counts[i];
+    }
+    snapshot.sum = sum_.load(std::memory_order_relaxed);
+    snapshot.max = max_.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+int64_t Histogram::Snapshot::percentile(double p) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(p * count);
+    if (rank >= count)
+    {
+        rank = count - 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        seen += counts[i];
+        if (seen > rank)
+        {
+            // 桶的上界，不超过见过的最大值
+            int64_t upper = i == 0 ? 0 : static_cast<int64_t>((static_cast<uint64_t>(1) << i) - 1);
+            return upper < max ? upper : max;
+        }
+    }
+    return max;
+}
+
+std::string Histogram::Snapshot::toString() const
+{
+    char buf[160];
+    snprintf(buf, sizeof(buf), "count=%llu mean=%.1f p50=%lld p90=%lld p99=%lld max=%lld",
+             static_cast<unsigned long long>(count), mean(),
+             static_cast<long long>(percentile(0.5)), static_cast<long long>(percentile(0.9)),
+             static_cast<long long>(percentile(0.99)), static_cast<long long>(max));
+    return buf;
+}
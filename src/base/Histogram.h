@@ -0,0 +1,64 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+/**
+ * 按2的幂分桶的直方图，多个线程可以同时 record，计数使用 relaxed 原子操作
+ * 第 0 个桶是 0，第 i 个桶是 [2^(i-1), 2^i)，percentile 返回所在桶的上界，误差不超过一倍
+ * 用于观察分布和数量级，例如线程池的排队时间和执行时间
+ */
+class Histogram : noncopyable
+{
+public:
+    static const int kBuckets = 64;
+
+    struct Snapshot
+    {
+        uint64_t counts[kBuckets];
+        uint64_t count;
+        int64_t sum;
+        int64_t max;
+
+        double mean() const { return count == 0 ? 0.0 : static_cast<double>(sum) / count; }
+        // p 取 0~1
+        int64_t percentile(double p) const;
+        // "count=... mean=... p50=... p90=... p99=... max=..."
+        std::string toString() const;
+    };
+
+    Histogram() { reset(); }
+
+    void record(int64_t value)
+    {
+        if (value < 0)
+        {
+            value = 0;
+        }
+        int bucket = value == 0 ? 0 : 64 - __builtin_clzll(static_cast<uint64_t>(value));
+        if (bucket >= kBuckets)
+        {
+            bucket = kBuckets - 1;
+        }
+        counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+        int64_t max = max_.load(std::memory_order_relaxed);
+        while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    Snapshot snapshot() const;
+    void reset();
+
+private:
+    std::atomic<uint64_t> counts_[kBuckets];
+    std::atomic<int64_t> sum_;
+    std::atomic<int64_t> max_;
+};
+
+#endif // HISTOGRAM_H
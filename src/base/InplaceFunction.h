@@ -0,0 +1,227 @@
+#ifndef INPLACE_FUNCTION_H
+#define INPLACE_FUNCTION_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// 默认内联容量，可以放下 std::bind(&Class::func, shared_ptr, 两三个参数)
+const size_t kInplaceFunctionCapacity = 64;
+
+template <typename Signature, size_t Capacity = kInplaceFunctionCapacity>
+class InplaceFunction;
+
+/**
+ * 只能移动的小对象函数包装，用于替代 EventLoop/ThreadPool/Timer 中的 std::function
+ *
+ * std::function 的小对象缓冲区只有16字节，捕获一个 shared_ptr 再加几个参数就会在堆上分配，
+ * 而且 std::function 必须可拷贝，queueInLoop 传递时容易产生额外拷贝
+ * InplaceFunction 把可调用对象直接构造在内部 Capacity 字节的缓冲区中，投递任务不需要分配内存
+ *
+ * 可调用对象超过 Capacity 或者移动构造可能抛异常时退化为堆上分配，保证任意对象都可以使用
+ */
+template <typename R, typename... Args, size_t Capacity>
+class InplaceFunction<R(Args...), Capacity>
+{
+public:
+    InplaceFunction() noexcept
+        : ops_(nullptr)
+    {
+    }
+
+    InplaceFunction(std::nullptr_t) noexcept
+        : ops_(nullptr)
+    {
+    }
+
+    template <typename F,
+              typename = typename std::enable_if<
+                  !std::is_same<typename std::decay<F>::type, InplaceFunction>::value>::type>
+    InplaceFunction(F&& f)
+        : ops_(nullptr)
+    {
+        using Functor = typename std::decay<F>::type;
+        construct<Functor>(std::forward<F>(f), StoreInline<Functor>());
+    }
+
+    InplaceFunction(InplaceFunction&& other) noexcept
+        : ops_(other.ops_)
+    {
+        if (ops_)
+        {
+            ops_->move(&storage_, &other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    InplaceFunction& operator=(InplaceFunction&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            ops_ = other.ops_;
+            if (ops_)
+            {
+                ops_->move(&storage_, &other.storage_);
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    InplaceFunction& operator=(std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    InplaceFunction(const InplaceFunction&) = delete;
+    InplaceFunction& operator=(const InplaceFunction&) = delete;
+
+    ~InplaceFunction()
+    {
+        reset();
+    }
+
+    // 与 std::function 一致，const 对象也可以调用
+    R operator()(Args... args) const
+    {
+        return ops_->invoke(const_cast<Storage*>(&storage_), std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+    // 可调用对象是否存放在内部缓冲区中
+    bool isInline() const noexcept { return ops_ != nullptr && ops_->isInline; }
+
+    static const size_t kCapacity = Capacity;
+
+private:
+    using Storage = typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type;
+
+    // 类型擦除后的操作表，每种可调用对象类型一份
+    struct Ops
+    {
+        R (*invoke)(Storage*, Args&&...);
+        void (*move)(Storage* dst, Storage* src);
+        void (*destroy)(Storage*);
+        bool isInline;
+    };
+
+    template <typename Functor>
+    using StoreInline = std::integral_constant<bool,
+        sizeof(Functor) <= Capacity &&
+        alignof(Functor) <= alignof(std::max_align_t) &&
+        std::is_nothrow_move_constructible<Functor>::value>;
+
+    // 可调用对象直接构造在 storage_ 中
+    template <typename Functor>
+    struct InlineOps
+    {
+        static Functor* get(Storage* s) { return reinterpret_cast<Functor*>(s); }
+
+        static R invoke(Storage* s, Args&&... args)
+        {
+            return (*get(s))(std::forward<Args>(args)...);
+        }
+
+        static void move(Storage* dst, Storage* src)
+        {
+            ::new (static_cast<void*>(dst)) Functor(std::move(*get(src)));
+            get(src)->~Functor();
+        }
+
+        static void destroy(Storage* s)
+        {
+            get(s)->~Functor();
+        }
+
+        static const Ops ops;
+    };
+
+    // 超出容量时 storage_ 中只保存指向堆对象的指针
+    template <typename Functor>
+    struct HeapOps
+    {
+        static Functor*& get(Storage* s) { return *reinterpret_cast<Functor**>(s); }
+
+        static R invoke(Storage* s, Args&&... args)
+        {
+            return (*get(s))(std::forward<Args>(args)...);
+        }
+
+        static void move(Storage* dst, Storage* src)
+        {
+            ::new (static_cast<void*>(dst)) Functor*(get(src));
+            get(src) = nullptr;
+        }
+
+        static void destroy(Storage* s)
+        {
+            delete get(s);
+        }
+
+        static const Ops ops;
+    };
+
+    template <typename Functor, typename F>
+    void construct(F&& f, std::true_type)
+    {
+        ::new (static_cast<void*>(&storage_)) Functor(std::forward<F>(f));
+        ops_ = &InlineOps<Functor>::ops;
+    }
+
+    template <typename Functor, typename F>
+    void construct(F&& f, std::false_type)
+    {
+        ::new (static_cast<void*>(&storage_)) Functor*(new Functor(std::forward<F>(f)));
+        ops_ = &HeapOps<Functor>::ops;
+    }
+
+    void reset() noexcept
+    {
+        if (ops_)
+        {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    Storage storage_;
+    const Ops* ops_;
+};
+
+template <typename R, typename... Args, size_t Capacity>
+template <typename Functor>
+const typename InplaceFunction<R(Args...), Capacity>::Ops
+InplaceFunction<R(Args...), Capacity>::InlineOps<Functor>::ops = {
+    &InlineOps<Functor>::invoke,
+    &InlineOps<Functor>::move,
+    &InlineOps<Functor>::destroy,
+    true,
+};
+
+template <typename R, typename... Args, size_t Capacity>
+template <typename Functor>
+const typename InplaceFunction<R(Args...), Capacity>::Ops
+InplaceFunction<R(Args...), Capacity>::HeapOps<Functor>::ops = {
+    &HeapOps<Functor>::invoke,
+    &HeapOps<Functor>::move,
+    &HeapOps<Functor>::destroy,
+    false,
+};
+
+template <typename R, typename... Args, size_t Capacity>
+inline bool operator==(const InplaceFunction<R(Args...), Capacity>& f, std::nullptr_t) noexcept
+{
+    return !f;
+}
+
+template <typename R, typename... Args, size_t Capacity>
+inline bool operator!=(const InplaceFunction<R(Args...), Capacity>& f, std::nullptr_t) noexcept
+{
+    return static_cast<bool>(f);
+}
+
+#endif // INPLACE_FUNCTION_H
@@ -0,0 +1,7 @@
+#include "TaskFuture.h"
+#include "EventLoop.h"
+
+void detail::postToLoop(EventLoop* loop, InplaceFunction<void()> cb)
+{
+    loop->queueInLoop(std::move(cb));
+}
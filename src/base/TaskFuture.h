@@ -0,0 +1,332 @@
+#ifndef TASK_FUTURE_H
+#define TASK_FUTURE_H
+
+#include "noncopyable.h"
+#include "InplaceFunction.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+class EventLoop;
+
+template <typename T>
+class TaskFuture;
+
+namespace detail
+{
+
+// 把回调交给 loop->queueInLoop，定义在 TaskFuture.cc，避免本头文件依赖 EventLoop.h
+void postToLoop(EventLoop* loop, InplaceFunction<void()> cb);
+
+// 任务结果的存储，void 单独特化
+template <typename T>
+class TaskValue
+{
+public:
+    TaskValue() : has_(false) {}
+    ~TaskValue()
+    {
+        if (has_)
+        {
+            ptr()->~T();
+        }
+    }
+
+    template <typename F>
+    void run(F& f)
+    {
+        ::new (static_cast<void*>(&storage_)) T(f());
+        has_ = true;
+    }
+
+    T take() { return std::move(*ptr()); }
+
+private:
+    T* ptr() { return reinterpret_cast<T*>(&storage_); }
+
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage_;
+    bool has_;
+};
+
+template <>
+class TaskValue<void>
+{
+public:
+    template <typename F>
+    void run(F& f) { f(); }
+
+    void take() {}
+};
+
+/**
+ * submit 创建的共享状态，和任务对象一起只分配一次
+ * 引用计数：TaskFuture、投递给线程池的任务、投递给 EventLoop 的后续回调各持有一份
+ */
+template <typename T>
+class TaskState : noncopyable
+{
+public:
+    using Continuation = InplaceFunction<void(TaskFuture<T>&)>;
+
+    TaskState()
+        : refs_(1),
+          ready_(false),
+          loop_(nullptr)
+    {
+    }
+
+    virtual ~TaskState() = default;
+
+    void retain() { refs_.fetch_add(1, std::memory_order_relaxed); }
+
+    void release()
+    {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete this;
+        }
+    }
+
+    // 在线程池中执行，保存结果或异常，然后唤醒等待者、投递后续回调
+    virtual void run() = 0;
+
+    // 任务没有执行就被销毁(例如 stop 之后才投递)，等待者得到异常而不是一直阻塞
+    void abandon()
+    {
+        complete(std::make_exception_ptr(std::runtime_error("ThreadPool task abandoned")));
+    }
+
+    bool ready() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return ready_;
+    }
+
+    void wait() const
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!ready_)
+        {
+            cond_.wait(lock);
+        }
+    }
+
+    T get()
+    {
+        wait();
+        if (error_)
+        {
+            std::rethrow_exception(error_);
+        }
+        return value_.take();
+    }
+
+    // 完成后在 loop 中调用 continuation，已经完成则立即投递
+    void then(EventLoop* loop, Continuation continuation)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            loop_ = loop;
+            continuation_ = std::move(continuation);
+            if (!ready_)
+            {
+                return;
+            }
+        }
+        post();
+    }
+
+protected:
+    template <typename F>
+    void runWith(F& f)
+    {
+        std::exception_ptr error;
+        try
+        {
+            value_.run(f);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        complete(error);
+    }
+
+private:
+    void complete(std::exception_ptr error)
+    {
+        bool hasContinuation;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            error_ = error;
+            ready_ = true;
+            hasContinuation = loop_ != nullptr;
+        }
+        cond_.notify_all();
+        if (hasContinuation)
+        {
+            post();
+        }
+    }
+
+    // 回调持有一份引用，在 loop 线程中交给传给 continuation_ 的 future
+    void post()
+    {
+        retain();
+        TaskState* self = this;
+        postToLoop(loop_, [self] { self->runContinuation(); });
+    }
+
+    void runContinuation();
+
+    std::atomic<int> refs_;
+    mutable std::mutex mutex_;
+    mutable std::condition_variable cond_;
+    bool ready_;
+    std::exception_ptr error_;
+    TaskValue<T> value_;
+    EventLoop* loop_;
+    Continuation continuation_;
+};
+
+// 任务对象 F 直接存放在共享状态中
+template <typename T, typename F>
+class TaskStateImpl : public TaskState<T>
+{
+public:
+    explicit TaskStateImpl(F&& f) : func_(std::move(f)) {}
+    explicit TaskStateImpl(const F& f) : func_(f) {}
+
+    void run() override { this->runWith(func_); }
+
+private:
+    F func_;
+};
+
+/**
+ * 投递给线程池的任务，只有一个指针，总能放进 InplaceFunction 的内部缓冲区
+ * 没有执行就被销毁时标记共享状态为 abandon
+ */
+template <typename T>
+class TaskRunner
+{
+public:
+    explicit TaskRunner(TaskState<T>* state) noexcept : state_(state) {}
+
+    TaskRunner(TaskRunner&& other) noexcept
+        : state_(other.state_)
+    {
+        other.state_ = nullptr;
+    }
+
+    ~TaskRunner()
+    {
+        if (state_)
+        {
+            state_->abandon();
+            state_->release();
+        }
+    }
+
+    void operator()()
+    {
+        TaskState<T>* state = state_;
+        state_ = nullptr;
+        state->run();
+        state->release();
+    }
+
+private:
+    TaskState<T>* state_;
+};
+
+} // namespace detail
+
+/**
+ * ThreadPool::submit 返回的结果，只能移动
+ *
+ * get()    阻塞直到任务完成，返回结果或者重新抛出任务中的异常，只能调用一次
+ * thenInLoop(loop, cb)
+ *          不阻塞，任务完成后通过 loop->queueInLoop 在 loop 线程中调用 cb(future)，
+ *          cb 中对 future 调用 get() 取结果，调用后本对象不再有效
+ *
+ * 典型用法是把 JSON 编码、压缩等 CPU 工作从 I/O loop 交给线程池，结果回到连接所在的 loop 发送：
+ *     pool.submit([body] { return compress(body); })
+ *         .thenInLoop(conn->getLoop(), [conn](TaskFuture<std::string>& f) { conn->send(f.get()); });
+ */
+template <typename T>
+class TaskFuture
+{
+public:
+    using Callback = InplaceFunction<void(TaskFuture&)>;
+
+    TaskFuture() noexcept : state_(nullptr) {}
+
+    // 接管 state 的一份引用
+    explicit TaskFuture(detail::TaskState<T>* state) noexcept : state_(state) {}
+
+    TaskFuture(TaskFuture&& other) noexcept
+        : state_(other.state_)
+    {
+        other.state_ = nullptr;
+    }
+
+    TaskFuture& operator=(TaskFuture&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            state_ = other.state_;
+            other.state_ = nullptr;
+        }
+        return *this;
+    }
+
+    TaskFuture(const TaskFuture&) = delete;
+    TaskFuture& operator=(const TaskFuture&) = delete;
+
+    ~TaskFuture() { reset(); }
+
+    bool valid() const { return state_ != nullptr; }
+    bool ready() const { return state_->ready(); }
+    void wait() const { state_->wait(); }
+    T get() { return state_->get(); }
+
+    // cb 存放在共享状态中，不再单独分配
+    void thenInLoop(EventLoop* loop, Callback cb)
+    {
+        detail::TaskState<T>* state = state_;
+        state_ = nullptr;
+        state->then(loop, std::move(cb));
+        state->release();
+    }
+
+private:
+    void reset()
+    {
+        if (state_)
+        {
+            state_->release();
+            state_ = nullptr;
+        }
+    }
+
+    detail::TaskState<T>* state_;
+};
+
+template <typename T>
+void detail::TaskState<T>::runContinuation()
+{
+    // 接管 post 时增加的引用，调用后立即释放回调捕获的对象(例如 TcpConnectionPtr)
+    TaskFuture<T> future(this);
+    continuation_(future);
+    continuation_ = nullptr;
+}
+
+#endif // TASK_FUTURE_H
@@ -1,10 +1,168 @@
 #include "ThreadPool.h"
+#include "WorkStealingDeque.h"
+#include "SizeClassAllocator.h"
+#include "CurrentThread.h"
+#include "Timestamp.h"
+
+#include <chrono>
+#include <new>
+#include <thread>
+
+namespace
+{
+
+// 找不到任务时再尝试的轮数，之后休眠，单核机器上自旋只会占用投递者的时间
+const int kSpinRounds = 16;
+const int g_spinRounds = std::thread::hardware_concurrency() > 1 ? kSpinRounds : 0;
+
+__thread uint64_t t_seed = 0;
+
+uint64_t nextRandom()
+{
+    if (t_seed == 0)
+    {
+        t_seed = static_cast<uint64_t>(CurrentThread::tid()) * 0x9E3779B97F4A7C15ULL | 1;
+    }
+    // xorshift64
+    t_seed ^= t_seed << 13;
+    t_seed ^= t_seed >> 7;
+    t_seed ^= t_seed << 17;
+    return t_seed;
+}
+
+} // namespace
+
+/**
+ * 任务节点从 SizeClassAllocator 分配，带线程缓存，被其他线程窃取后释放也不需要加锁
+ */
+struct ThreadPool::TaskNode
+{
+    TaskNode(ThreadFunction&& f, int64_t enqueue)
+        : task(std::move(f)),
+          enqueueUs(enqueue),
+          next(nullptr)
+    {
+    }
+
+    ThreadFunction task;
+    int64_t enqueueUs;
+    TaskNode* next;     // 收件箱链表
+
+    static TaskNode* create(ThreadFunction&& f, int64_t enqueueUs)
+    {
+        void* p = SizeClassAllocator::allocate(sizeof(TaskNode));
+        if (p == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        return new (p) TaskNode(std::move(f), enqueueUs);
+    }
+
+    static void destroy(TaskNode* node)
+    {
+        node->~TaskNode();
+        SizeClassAllocator::deallocate(node);
+    }
+};
+
+struct ThreadPool::Worker
+{
+    explicit Worker(ThreadPool* p)
+        : pool(p),
+          inboxHead(nullptr),
+          inboxTail(nullptr),
+          inboxSize(0)
+    {
+    }
+
+    ~Worker()
+    {
+        // stop 之后才投递的任务不会再执行
+        while (TaskNode* node = deque.pop())
+        {
+            TaskNode::destroy(node);
+        }
+        while (inboxHead != nullptr)
+        {
+            TaskNode* next = inboxHead->next;
+            TaskNode::destroy(inboxHead);
+            inboxHead = next;
+        }
+    }
+
+    // 收件箱按投递顺序保存其他线程投递的任务
+    void pushInbox(TaskNode* node)
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        if (inboxTail != nullptr)
+        {
+            inboxTail->next = node;
+        }
+        else
+        {
+            inboxHead = node;
+        }
+        inboxTail = node;
+        inboxSize.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    TaskNode* popInbox()
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        TaskNode* node = inboxHead;
+        if (node != nullptr)
+        {
+            inboxHead = node->next;
+            if (inboxHead == nullptr)
+            {
+                inboxTail = nullptr;
+            }
+            inboxSize.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return node;
+    }
+
+    // 取走整个收件箱
+    TaskNode* takeInbox()
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        TaskNode* head = inboxHead;
+        inboxHead = nullptr;
+        inboxTail = nullptr;
+        inboxSize.store(0, std::memory_order_relaxed);
+        return head;
+    }
+
+    ThreadPool* pool;
+    WorkStealingDeque<TaskNode> deque;
+    std::mutex inboxMutex;
+    TaskNode* inboxHead;
+    TaskNode* inboxTail;
+    std::atomic<size_t> inboxSize;
+};
+
+__thread ThreadPool::Worker* ThreadPool::t_worker = nullptr;
+__thread ThreadPool* ThreadPool::t_pool = nullptr;
 
 ThreadPool::ThreadPool(const std::string& name)
     : mutex_(),
       cond_(),
       name_(name),
-      running_(false)
+      running_(false),
+      threadSize_(0),
+      mode_(kSharedQueue),
+      maxQueueSize_(0),
+      overflowPolicy_(kBlock),
+      blockTimeoutMs_(-1),
+      statsEnabled_(false),
+      blockedProducers_(0),
+      queued_(0),
+      rejected_(0),
+      dropped_(0),
+      callerRuns_(0),
+      blocked_(0),
+      sleepers_(0),
+      wakeups_(0)
 {
 }
 
@@ -21,13 +179,43 @@ ThreadPool::~ThreadPool()
 void ThreadPool::start()
 {
     running_ = true;
+    if (mode_ == kWorkStealing && threadSize_ > 0)
+    {
+        // 所有 Worker 在线程启动前创建好，之后 workers_ 不再改变，窃取时不需要加锁
+        workers_.reserve(threadSize_);
+        for (size_t i = 0; i < threadSize_; ++i)
+        {
+            workers_.emplace_back(new Worker(this));
+        }
+        // start 之前投递的任务轮流分给各个线程
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; !queue_.empty(); ++i)
+        {
+            QueuedTask& queued = queue_.front();
+            workers_[i % threadSize_]->pushInbox(TaskNode::create(std::move(queued.task), queued.enqueueUs));
+            queue_.pop_front();
+            if (countQueued())
+            {
+                queued_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
     threads_.reserve(threadSize_);
     for (int i = 0; i < threadSize_; ++i)
     {
         char id[32];
         snprintf(id, sizeof(id), "%d", i + 1);
-        threads_.emplace_back(new Thread(
-            std::bind(&ThreadPool::runInThread, this), name_ + id));
+        if (workers_.empty())
+        {
+            threads_.emplace_back(new Thread(
+                std::bind(&ThreadPool::runInThread, this), name_ + id));
+        }
+        else
+        {
+            threads_.emplace_back(new Thread(
+                std::bind(&ThreadPool::runWorker, this, i), name_ + id));
+        }
         threads_[i]->start();
     }
     // 不创建新线程
@@ -42,30 +230,180 @@ void ThreadPool::stop()
     std::lock_guard<std::mutex> lock(mutex_);
     running_ = false;
     cond_.notify_all(); // 唤醒所有线程
+    notFull_.notify_all();
 }
 
 size_t ThreadPool::queueSize() const
 {
+    size_t size = 0;
+    for (const auto& worker : workers_)
+    {
+        size += worker->deque.size() + worker->inboxSize.load(std::memory_order_relaxed);
+    }
     std::lock_guard<std::mutex> lock(mutex_);
-    return queue_.size();
+    return size + queue_.size();
 }
 
-void ThreadPool::add(ThreadFunction ThreadFunction)
+bool ThreadPool::add(ThreadFunction task)
 {
-    std::unique_lock<std::mutex> lock(mutex_);
-    queue_.push_back(ThreadFunction);
-    cond_.notify_one();
+    if (!workers_.empty())
+    {
+        return addToWorker(std::move(task));
+    }
+
+    ThreadFunction dropped;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (isFull())
+        {
+            OverflowPolicy policy = overflowPolicy();
+            if (policy == kDropOldest)
+            {
+                dropped = std::move(queue_.front().task);
+                queue_.pop_front();
+            }
+            else if (policy == kBlock)
+            {
+                blocked_.fetch_add(1, std::memory_order_relaxed);
+                blockedProducers_.fetch_add(1, std::memory_order_relaxed);
+                auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(blockTimeoutMs_);
+                while (isFull() && running_)
+                {
+                    if (blockTimeoutMs_ < 0)
+                    {
+                        notFull_.wait(lock);
+                    }
+                    else if (notFull_.wait_until(lock, deadline) == std::cv_status::timeout)
+                    {
+                        break;
+                    }
+                }
+                blockedProducers_.fetch_sub(1, std::memory_order_relaxed);
+                if (isFull() || !running_)
+                {
+                    lock.unlock();
+                    return reject(std::move(task));
+                }
+            }
+            else if (policy == kCallerRuns)
+            {
+                lock.unlock();
+                callerRuns_.fetch_add(1, std::memory_order_relaxed);
+                runTask(task, enqueueTime());
+                return true;
+            }
+            else
+            {
+                lock.unlock();
+                return reject(std::move(task));
+            }
+        }
+        queue_.push_back(QueuedTask{std::move(task), enqueueTime()});
+        if (statsEnabled_)
+        {
+            queueDepth_.record(queue_.size());
+        }
+        cond_.notify_one();
+    }
+    if (dropped != nullptr)
+    {
+        discard(std::move(dropped));
+    }
+    return true;
+}
+
+bool ThreadPool::isFull() const
+{
+    if (maxQueueSize_ == 0)
+    {
+        return false;
+    }
+    size_t queued = workers_.empty() ? queue_.size() : queued_.load(std::memory_order_relaxed);
+    return queued >= maxQueueSize_;
+}
+
+void ThreadPool::runTask(ThreadFunction& task, int64_t enqueueUs)
+{
+    if (task == nullptr)
+    {
+        return;
+    }
+    if (!statsEnabled_)
+    {
+        task();
+        return;
+    }
+    int64_t start = Timestamp::now().microSecondsSinceEpoch();
+    waitUs_.record(start - enqueueUs);
+    task();
+    runUs_.record(Timestamp::now().microSecondsSinceEpoch() - start);
+}
+
+int64_t ThreadPool::enqueueTime() const
+{
+    return statsEnabled_ ? Timestamp::now().microSecondsSinceEpoch() : 0;
+}
+
+// 池内线程等待自己所在的池腾出空间可能永远等不到，改为直接执行
+ThreadPool::OverflowPolicy ThreadPool::overflowPolicy() const
+{
+    return overflowPolicy_ == kBlock && t_pool == this ? kCallerRuns : overflowPolicy_;
+}
+
+bool ThreadPool::reject(ThreadFunction task)
+{
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+    if (rejectCallback_)
+    {
+        rejectCallback_(std::move(task));
+    }
+    return false;
+}
+
+void ThreadPool::discard(ThreadFunction task)
+{
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    if (rejectCallback_)
+    {
+        rejectCallback_(std::move(task));
+    }
+}
+
+ThreadPool::Stats ThreadPool::stats() const
+{
+    Stats stats;
+    stats.queueDepth = queueDepth_.snapshot();
+    stats.waitUs = waitUs_.snapshot();
+    stats.runUs = runUs_.snapshot();
+    stats.rejected = rejected_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    stats.callerRuns = callerRuns_.load(std::memory_order_relaxed);
+    stats.blocked = blocked_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void ThreadPool::resetStats()
+{
+    queueDepth_.reset();
+    waitUs_.reset();
+    runUs_.reset();
+    rejected_ = 0;
+    dropped_ = 0;
+    callerRuns_ = 0;
+    blocked_ = 0;
 }
 
 void ThreadPool::runInThread()
 {
     try 
     {
+        t_pool = this;
         if (threadInitCallback_)
         {
             threadInitCallback_();
         }
         ThreadFunction task;
+        int64_t enqueueUs = 0;
         // 之前写成了 while (true)，这会导致出不去循环
         while (true)
         {
@@ -79,17 +417,341 @@ void ThreadPool::runInThread()
                     }
                     cond_.wait(lock);
                 }
-                task = queue_.front();
+                task = std::move(queue_.front().task);
+                enqueueUs = queue_.front().enqueueUs;
                 queue_.pop_front();
+                if (blockedProducers_.load(std::memory_order_relaxed) > 0)
+                {
+                    notFull_.notify_one();
+                }
             }
-            if (task != nullptr) 
-            {
-                task();
-            }
+            runTask(task, enqueueUs);
         }
     } 
     catch(...) 
     {
         LOG_WARN << "runInThread throw exception";
     }
-}
\ No newline at end of file
+}
+
+/**
+ * 只有设置了上限或者开启统计时才维护 queued_，否则投递路径上没有额外的原子操作
+ * 上限通过 CAS 预留名额保证不会超过，取出任务时归还
+ */
+bool ThreadPool::addToWorker(ThreadFunction task)
+{
+    int64_t depth = 0;
+    if (countQueued() && !reserveSlot(&depth))
+    {
+        OverflowPolicy policy = overflowPolicy();
+        if (policy == kDropOldest)
+        {
+            // 丢弃的任务可能刚好被其他线程取走，重新尝试
+            while (!reserveSlot(&depth))
+            {
+                if (!dropOldest())
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+        else if (policy == kBlock)
+        {
+            if (!waitForSlot(&depth))
+            {
+                return reject(std::move(task));
+            }
+        }
+        else if (policy == kCallerRuns)
+        {
+            callerRuns_.fetch_add(1, std::memory_order_relaxed);
+            runTask(task, enqueueTime());
+            return true;
+        }
+        else
+        {
+            return reject(std::move(task));
+        }
+    }
+    if (statsEnabled_)
+    {
+        queueDepth_.record(depth);
+    }
+
+    TaskNode* node = TaskNode::create(std::move(task), enqueueTime());
+    Worker* self = t_worker;
+    if (self != nullptr && self->pool == this)
+    {
+        self->deque.push(node);
+    }
+    else
+    {
+        workers_[nextRandom() % workers_.size()]->pushInbox(node);
+    }
+    wakeupOne();
+    return true;
+}
+
+bool ThreadPool::reserveSlot(int64_t* depth)
+{
+    if (maxQueueSize_ == 0)
+    {
+        *depth = static_cast<int64_t>(queued_.fetch_add(1) + 1);
+        return true;
+    }
+    size_t queued = queued_.load();
+    do
+    {
+        if (queued >= maxQueueSize_)
+        {
+            return false;
+        }
+    } while (!queued_.compare_exchange_weak(queued, queued + 1));
+    *depth = static_cast<int64_t>(queued + 1);
+    return true;
+}
+
+/**
+ * 先登记 blockedProducers_ 再检查 queued_，taskDequeued 先减少 queued_ 再检查 blockedProducers_，
+ * 两边都是 seq_cst，至少有一方看到对方，等待者持有 mutex_ 直到进入 wait，通知不会丢失
+ */
+bool ThreadPool::waitForSlot(int64_t* depth)
+{
+    blocked_.fetch_add(1, std::memory_order_relaxed);
+    std::unique_lock<std::mutex> lock(mutex_);
+    blockedProducers_.fetch_add(1);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(blockTimeoutMs_);
+    bool reserved = false;
+    while (running_)
+    {
+        if (reserveSlot(depth))
+        {
+            reserved = true;
+            break;
+        }
+        if (blockTimeoutMs_ < 0)
+        {
+            notFull_.wait(lock);
+        }
+        else if (notFull_.wait_until(lock, deadline) == std::cv_status::timeout)
+        {
+            reserved = reserveSlot(depth);
+            break;
+        }
+    }
+    blockedProducers_.fetch_sub(1);
+    return reserved;
+}
+
+/**
+ * 从随机的线程开始，取收件箱中最早的任务，没有则从队列顶部窃取
+ * 各线程之间没有全局顺序，丢弃的是某个线程上最早的任务，而不一定是全局最早的
+ */
+bool ThreadPool::dropOldest()
+{
+    size_t n = workers_.size();
+    size_t start = nextRandom() % n;
+    for (size_t i = 0; i < n; ++i)
+    {
+        Worker* victim = workers_[(start + i) % n].get();
+        TaskNode* node = victim->popInbox();
+        if (node == nullptr)
+        {
+            node = victim->deque.steal();
+        }
+        if (node != nullptr)
+        {
+            queued_.fetch_sub(1);
+            ThreadFunction task(std::move(node->task));
+            TaskNode::destroy(node);
+            discard(std::move(task));
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::taskDequeued()
+{
+    if (!countQueued())
+    {
+        return;
+    }
+    queued_.fetch_sub(1);
+    if (maxQueueSize_ > 0 && blockedProducers_.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        notFull_.notify_one();
+    }
+}
+
+void ThreadPool::runWorker(size_t index)
+{
+    Worker* self = workers_[index].get();
+    t_worker = self;
+    t_pool = this;
+    try
+    {
+        if (threadInitCallback_)
+        {
+            threadInitCallback_();
+        }
+        while (true)
+        {
+            TaskNode* node = findTask(self);
+            for (int spin = 0; node == nullptr && spin < g_spinRounds; ++spin)
+            {
+                std::this_thread::yield();
+                node = findTask(self);
+            }
+            if (node == nullptr)
+            {
+                // 没有任务时才退出，stop 之前投递的任务都会执行完
+                if (!running_)
+                {
+                    break;
+                }
+                park();
+                continue;
+            }
+
+            taskDequeued();
+            // 先取出任务释放节点，任务抛出异常也不会泄漏
+            ThreadFunction task(std::move(node->task));
+            int64_t enqueueUs = node->enqueueUs;
+            TaskNode::destroy(node);
+            runTask(task, enqueueUs);
+        }
+    }
+    catch(...)
+    {
+        LOG_WARN << "runWorker throw exception";
+    }
+    t_worker = nullptr;
+    t_pool = nullptr;
+}
+
+/**
+ * 依次尝试：自己的队列底部 -> 自己的收件箱 -> 随机的其他线程
+ */
+ThreadPool::TaskNode* ThreadPool::findTask(Worker* self)
+{
+    TaskNode* node = self->deque.pop();
+    if (node == nullptr)
+    {
+        node = adoptInbox(self, self);
+    }
+    return node != nullptr ? node : steal(self);
+}
+
+/**
+ * 整体取出 from 的收件箱，第一个直接执行，其余逆序压入 self 的队列，LIFO 取出时仍是投递顺序
+ * 休眠后被唤醒的线程通常自己没有任务，一次取走别人的整个收件箱，之后的任务不需要再逐个加锁
+ */
+ThreadPool::TaskNode* ThreadPool::adoptInbox(Worker* self, Worker* from)
+{
+    if (from->inboxSize.load(std::memory_order_relaxed) == 0)
+    {
+        return nullptr;
+    }
+    TaskNode* node = from->takeInbox();
+    if (node == nullptr)
+    {
+        return nullptr;
+    }
+    TaskNode* reversed = nullptr;
+    for (TaskNode* rest = node->next; rest != nullptr; )
+    {
+        TaskNode* next = rest->next;
+        rest->next = reversed;
+        reversed = rest;
+        rest = next;
+    }
+    while (reversed != nullptr)
+    {
+        TaskNode* next = reversed->next;
+        self->deque.push(reversed);
+        reversed = next;
+    }
+    return node;
+}
+
+// 从随机位置开始遍历其他线程，先窃取队列顶部，再取走收件箱
+ThreadPool::TaskNode* ThreadPool::steal(Worker* self)
+{
+    size_t n = workers_.size();
+    size_t start = nextRandom() % n;
+    for (size_t i = 0; i < n; ++i)
+    {
+        Worker* victim = workers_[(start + i) % n].get();
+        if (victim == self)
+        {
+            continue;
+        }
+        TaskNode* node = victim->deque.steal();
+        if (node == nullptr)
+        {
+            node = adoptInbox(self, victim);
+        }
+        if (node != nullptr)
+        {
+            return node;
+        }
+    }
+    return nullptr;
+}
+
+bool ThreadPool::hasWork() const
+{
+    for (const auto& worker : workers_)
+    {
+        if (worker->deque.size() > 0 || worker->inboxSize.load(std::memory_order_relaxed) > 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * 休眠和唤醒：
+ *   休眠方先增加 sleepers_，再检查一遍所有队列
+ *   投递方先放入任务，再检查 sleepers_，不为0才加锁发出唤醒
+ * 两边都有 seq_cst 屏障，至少有一方能看到另一方的修改，任务不会在所有线程都休眠时被遗漏
+ */
+void ThreadPool::park()
+{
+    sleepers_.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (hasWork())
+    {
+        sleepers_.fetch_sub(1, std::memory_order_relaxed);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (wakeups_ == 0 && running_)
+    {
+        cond_.wait(lock);
+    }
+    if (wakeups_ > 0)
+    {
+        --wakeups_;
+    }
+    sleepers_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void ThreadPool::wakeupOne()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers_.load(std::memory_order_relaxed) > 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // 唤醒次数不超过休眠的线程数，多余的唤醒只会让线程空转一次
+        if (wakeups_ < sleepers_.load(std::memory_order_relaxed))
+        {
+            ++wakeups_;
+            cond_.notify_one();
+        }
+    }
+}
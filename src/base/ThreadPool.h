@@ -4,7 +4,11 @@
 #include "noncopyable.h"
 #include "Thread.h"
 #include "Logging.h"
+#include "InplaceFunction.h"
+#include "TaskFuture.h"
+#include "Histogram.h"
 
+#include <atomic>
 #include <deque>
 #include <vector>
 #include <mutex>
@@ -13,33 +17,173 @@
 class ThreadPool : noncopyable
 {
 public:
-    using ThreadFunction = std::function<void()>;
+    // 任务只能移动，入队不需要为常见的 std::bind 对象分配内存
+    using ThreadFunction = InplaceFunction<void()>;
+    using ThreadInitCallback = std::function<void()>;
+
+    /**
+     * kSharedQueue  所有线程共用一个队列，由一把锁和一个条件变量保护
+     * kWorkStealing 每个线程一个 Chase-Lev 双端队列(见 WorkStealingDeque)：
+     *               池内线程投递的任务放入自己的队列，LIFO 取出
+     *               其他线程(例如 I/O loop)投递的任务随机放入某个线程的收件箱，每个收件箱一把锁，互相不竞争
+     *               自己没有任务时从随机的线程顶部窃取最早的任务
+     *               空闲线程短暂自旋后休眠，投递时只有存在休眠线程才去加锁唤醒
+     */
+    enum Mode
+    {
+        kSharedQueue,
+        kWorkStealing,
+    };
+
+    /**
+     * 排队任务达到 setMaxQueueSize 上限时的处理
+     */
+    enum OverflowPolicy
+    {
+        kBlock,         // 等待队列腾出空间，超时后拒绝；池内线程投递时按 kCallerRuns 处理，避免所有线程互相等待
+        kReject,        // 立即拒绝
+        kCallerRuns,    // 在投递者的线程中直接执行，I/O loop 投递时会阻塞该 loop
+        kDropOldest,    // 丢弃最早排队的任务，放入新任务
+    };
+
+    // 被拒绝或者被丢弃的任务交给回调，例如返回错误响应，不设置则直接销毁
+    using RejectCallback = std::function<void(ThreadFunction)>;
+
+    /**
+     * 用于确定线程数和队列上限
+     * 直方图需要 setStatsEnabled(true)，计数总是记录
+     */
+    struct Stats
+    {
+        Histogram::Snapshot queueDepth; // 每次投递后的排队任务数
+        Histogram::Snapshot waitUs;     // 入队到开始执行(微秒)
+        Histogram::Snapshot runUs;      // 执行时间(微秒)
+        uint64_t rejected;              // 被拒绝的任务数，包括 kBlock 超时
+        uint64_t dropped;               // kDropOldest 丢弃的任务数
+        uint64_t callerRuns;            // 在投递者线程中执行的任务数
+        uint64_t blocked;               // 投递时需要等待的次数
+    };
 
     explicit ThreadPool(const std::string& name = std::string("ThreadPool"));
     ~ThreadPool();
 
-    void setThreadInitCallback(const ThreadFunction& cb) { threadInitCallback_ = cb; }
+    void setThreadInitCallback(const ThreadInitCallback& cb) { threadInitCallback_ = cb; }
     void setThreadSize(const int& num) { threadSize_ = num; }
+    // start 之前设置，没有线程时总是使用 kSharedQueue
+    void setMode(Mode mode) { mode_ = mode; }
+    Mode mode() const { return mode_; }
+    /**
+     * 以下在 start 之前设置
+     * maxSize 为排队任务数上限，0表示不限制(默认)
+     * kBlock 最多等待 blockTimeoutMs 毫秒，小于0表示一直等待，线程池没有运行时直接拒绝
+     */
+    void setMaxQueueSize(size_t maxSize) { maxQueueSize_ = maxSize; }
+    void setOverflowPolicy(OverflowPolicy policy, int blockTimeoutMs = -1)
+    {
+        overflowPolicy_ = policy;
+        blockTimeoutMs_ = blockTimeoutMs;
+    }
+    void setRejectCallback(const RejectCallback& cb) { rejectCallback_ = cb; }
+    // 记录直方图，每个任务多两三次取时间，默认关闭
+    void setStatsEnabled(bool on) { statsEnabled_ = on; }
     void start();
     void stop();
 
     const std::string& name() const { return name_; }
     size_t queueSize() const;
 
-    void add(ThreadFunction ThreadFunction);
+    // 返回 false 表示任务被拒绝，已经交给 RejectCallback
+    bool add(ThreadFunction task);
+
+    Stats stats() const;
+    void resetStats();
+
+    /**
+     * 投递有返回值的任务，通过返回的 TaskFuture 取结果或者在指定的 EventLoop 中继续处理
+     * 任务对象和结果放在同一块共享状态中，投递给队列的只是一个指针，除此之外不再分配内存
+     * 任务没有执行就被丢弃(stop 之后投递)时，get() 抛出异常
+     */
+    template <typename F>
+    TaskFuture<typename std::result_of<F()>::type> submit(F&& f)
+    {
+        using Result = typename std::result_of<F()>::type;
+        using Func = typename std::decay<F>::type;
+        detail::TaskState<Result>* state = new detail::TaskStateImpl<Result, Func>(std::forward<F>(f));
+        // 一份引用给 future，一份给任务
+        state->retain();
+        TaskFuture<Result> future(state);
+        // 被拒绝时任务直接销毁或交给 RejectCallback，future 的 get() 抛出异常
+        add(detail::TaskRunner<Result>(state));
+        return future;
+    }
 
 private:
+    struct TaskNode;
+    struct Worker;
+
+    struct QueuedTask
+    {
+        ThreadFunction task;
+        int64_t enqueueUs;      // 开启统计时记录入队时间
+    };
+
+    // 共享队列模式下调用者持有 mutex_
     bool isFull() const;
     void runInThread();
+    void runTask(ThreadFunction& task, int64_t enqueueUs);
+    int64_t enqueueTime() const;
+    OverflowPolicy overflowPolicy() const;
+    bool reject(ThreadFunction task);
+    void discard(ThreadFunction task);
+
+    // kWorkStealing 模式
+    void runWorker(size_t index);
+    bool addToWorker(ThreadFunction task);
+    bool reserveSlot(int64_t* depth);
+    bool waitForSlot(int64_t* depth);
+    bool dropOldest();
+    void taskDequeued();
+    bool countQueued() const { return maxQueueSize_ > 0 || statsEnabled_; }
+    TaskNode* findTask(Worker* self);
+    TaskNode* adoptInbox(Worker* self, Worker* from);
+    TaskNode* steal(Worker* self);
+    bool hasWork() const;
+    void park();
+    void wakeupOne();
 
     mutable std::mutex mutex_;
     std::condition_variable cond_;
     std::string name_;
-    ThreadFunction threadInitCallback_;
+    ThreadInitCallback threadInitCallback_;
     std::vector<std::unique_ptr<Thread>> threads_;
-    std::deque<ThreadFunction> queue_;
-    bool running_;
+    std::deque<QueuedTask> queue_;
+    std::atomic_bool running_;
     size_t threadSize_;
+    Mode mode_;
+
+    size_t maxQueueSize_;
+    OverflowPolicy overflowPolicy_;
+    int blockTimeoutMs_;
+    RejectCallback rejectCallback_;
+    bool statsEnabled_;
+    std::condition_variable notFull_;
+    std::atomic<int> blockedProducers_;     // 等待队列腾出空间的投递者数
+    std::atomic<size_t> queued_;            // kWorkStealing 模式有上限或者开启统计时的排队任务数
+
+    Histogram queueDepth_;
+    Histogram waitUs_;
+    Histogram runUs_;
+    std::atomic<uint64_t> rejected_;
+    std::atomic<uint64_t> dropped_;
+    std::atomic<uint64_t> callerRuns_;
+    std::atomic<uint64_t> blocked_;
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<int> sleepers_;     // 休眠或者准备休眠的线程数
+    int wakeups_;                   // 已发出还没被领取的唤醒次数，由 mutex_ 保护
+
+    static __thread Worker* t_worker;
+    static __thread ThreadPool* t_pool;     // 当前线程所属的线程池
 };
 
 # endif // THREAD_POOL_H
@@ -0,0 +1,147 @@
+#ifndef WORK_STEALING_DEQUE_H
+#define WORK_STEALING_DEQUE_H
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Chase-Lev 无锁双端队列，存放 T*
+ *
+ * 只有拥有者线程调用 push/pop，在底部进出(LIFO)，刚放入的任务数据还在缓存中
+ * 其他线程调用 steal 从顶部取走最早放入的任务(FIFO)，和拥有者只在剩最后一个元素时竞争同一个 CAS
+ * 数组满时拥有者换成两倍大小的新数组，旧数组可能正被窃取者读取，保留到析构时再释放
+ *
+ * 内存序参考 Lê, Pop, Cohen, Zappa Nardelli, "Correct and Efficient Work-Stealing for Weak Memory Models"
+ */
+template <typename T>
+class WorkStealingDeque : noncopyable
+{
+public:
+    explicit WorkStealingDeque(int64_t capacity = 1024)
+        : top_(0),
+          bottom_(0),
+          array_(new Array(capacity))
+    {
+    }
+
+    ~WorkStealingDeque()
+    {
+        delete array_.load(std::memory_order_relaxed);
+    }
+
+    // 拥有者线程调用
+    void push(T* item)
+    {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        Array* array = array_.load(std::memory_order_relaxed);
+        if (b - t > array->capacity - 1)
+        {
+            array = grow(array, b, t);
+        }
+        array->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // 拥有者线程调用，空时返回 nullptr
+    T* pop()
+    {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        Array* array = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+
+        T* item = nullptr;
+        if (t <= b)
+        {
+            item = array->get(b);
+            if (t == b)
+            {
+                // 最后一个元素，和窃取者竞争
+                if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                {
+                    item = nullptr;
+                }
+                bottom_.store(b + 1, std::memory_order_relaxed);
+            }
+        }
+        else
+        {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // 任意线程调用，空或者竞争失败时返回 nullptr
+    T* steal()
+    {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+        if (t >= b)
+        {
+            return nullptr;
+        }
+        Array* array = array_.load(std::memory_order_acquire);
+        T* item = array->get(t);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            return nullptr;
+        }
+        return item;
+    }
+
+    // 近似值，可以在任意线程调用
+    size_t size() const
+    {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+
+private:
+    struct Array
+    {
+        explicit Array(int64_t cap)
+            : capacity(cap),
+              mask(cap - 1),
+              slots(new std::atomic<T*>[cap])
+        {
+        }
+
+        T* get(int64_t i) const { return slots[i & mask].load(std::memory_order_relaxed); }
+        void put(int64_t i, T* item) { slots[i & mask].store(item, std::memory_order_relaxed); }
+
+        const int64_t capacity;   // 2的幂
+        const int64_t mask;
+        std::unique_ptr<std::atomic<T*>[]> slots;
+    };
+
+    Array* grow(Array* array, int64_t b, int64_t t)
+    {
+        Array* bigger = new Array(array->capacity * 2);
+        for (int64_t i = t; i < b; ++i)
+        {
+            bigger->put(i, array->get(i));
+        }
+        retired_.emplace_back(array);
+        array_.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+    // top_ 被窃取者修改，bottom_ 只被拥有者修改，放在不同的缓存行
+    char pad0_[64];
+    std::atomic<int64_t> top_;
+    char pad1_[64 - sizeof(std::atomic<int64_t>)];
+    std::atomic<int64_t> bottom_;
+    std::atomic<Array*> array_;
+    std::vector<std::unique_ptr<Array>> retired_;
+};
+
+#endif // WORK_STEALING_DEQUE_H
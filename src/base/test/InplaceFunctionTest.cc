@@ -0,0 +1,139 @@
+#include "InplaceFunction.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "ThreadPool.h"
+#include "Timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+ * 统计每个任务投递时的内存分配次数
+ * 替换全局 operator new，计数所有堆分配
+ */
+std::atomic<size_t> g_allocations(0);
+
+void* operator new(size_t size)
+{
+    ++g_allocations;
+    void* p = malloc(size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+// 典型的投递方式：std::bind(&Session::handle, shared_ptr, 几个参数)
+struct Session
+{
+    Session() : sum_(0) {}
+    void handle(int a, int b, int c) { sum_ += a + b + c; }
+    std::atomic<long> sum_;
+};
+
+const int kTasks = 1000 * 1000;
+
+void printResult(const char* name, size_t allocations, Timestamp start, Timestamp end)
+{
+    double us = static_cast<double>(end.microSecondsSinceEpoch() - start.microSecondsSinceEpoch());
+    printf("%-36s allocations/task=%.3f  ns/task=%.1f\n",
+           name, static_cast<double>(allocations) / kTasks, us * 1000 / kTasks);
+}
+
+// 只比较包装本身：构造 + 移动进队列 + 调用
+template <typename Function>
+void benchFunction(const char* name)
+{
+    std::shared_ptr<Session> session = std::make_shared<Session>();
+    std::vector<Function> queue;
+    queue.reserve(kTasks);
+
+    size_t before = g_allocations;
+    Timestamp start = Timestamp::now();
+    for (int i = 0; i < kTasks; ++i)
+    {
+        Function f(std::bind(&Session::handle, session, i, i, i));
+        queue.push_back(std::move(f));
+    }
+    for (const Function& f : queue)
+    {
+        f();
+    }
+    Timestamp end = Timestamp::now();
+    printResult(name, g_allocations - before, start, end);
+}
+
+// 另一个线程通过 queueInLoop 向subLoop投递
+void benchEventLoop()
+{
+    EventLoopThread loopThread;
+    EventLoop* loop = loopThread.startLoop();
+    std::shared_ptr<Session> session = std::make_shared<Session>();
+    std::atomic<int> done(0);
+
+    size_t before = g_allocations;
+    Timestamp start = Timestamp::now();
+    for (int i = 0; i < kTasks; ++i)
+    {
+        loop->queueInLoop(std::bind(&Session::handle, session, i, i, i));
+    }
+    loop->queueInLoop([&done]() { done = 1; });
+    while (!done)
+    {
+        usleep(1000);
+    }
+    Timestamp end = Timestamp::now();
+    printResult("EventLoop::queueInLoop", g_allocations - before, start, end);
+}
+
+void benchThreadPool()
+{
+    ThreadPool pool("BenchPool");
+    pool.setThreadSize(1);
+    pool.start();
+    std::shared_ptr<Session> session = std::make_shared<Session>();
+    std::atomic<int> done(0);
+
+    size_t before = g_allocations;
+    Timestamp start = Timestamp::now();
+    for (int i = 0; i < kTasks; ++i)
+    {
+        pool.add(std::bind(&Session::handle, session, i, i, i));
+    }
+    pool.add([&done]() { done = 1; });
+    while (!done)
+    {
+        usleep(1000);
+    }
+    Timestamp end = Timestamp::now();
+    printResult("ThreadPool::add", g_allocations - before, start, end);
+}
+
+int main()
+{
+    Logger::setLogLevel(Logger::WARN);
+    printf("sizeof(std::function<void()>) = %zu, sizeof(InplaceFunction<void()>) = %zu\n",
+           sizeof(std::function<void()>), sizeof(InplaceFunction<void()>));
+
+    benchFunction<std::function<void()>>("std::function<void()>");
+    benchFunction<InplaceFunction<void()>>("InplaceFunction<void()>");
+    benchEventLoop();
+    benchThreadPool();
+    return 0;
+}
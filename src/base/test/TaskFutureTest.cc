@@ -0,0 +1,205 @@
+#include "TaskFuture.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "ThreadPool.h"
+#include "Timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+/**
+ * ThreadPool::submit 和 TaskFuture::thenInLoop 的正确性，以及每个任务的内存分配次数
+ * 替换全局 operator new，计数经过它的堆分配
+ * kWorkStealing 模式的任务节点从 SizeClassAllocator 分配，不经过 operator new，单独计入
+ */
+std::atomic<size_t> g_allocations(0);
+
+void* operator new(size_t size)
+{
+    ++g_allocations;
+    void* p = malloc(size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+int g_failures = 0;
+
+void check(bool ok, const char* what)
+{
+    printf("%-48s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+    {
+        ++g_failures;
+    }
+}
+
+void waitFor(const std::atomic<int>& flag)
+{
+    while (!flag)
+    {
+        usleep(1000);
+    }
+}
+
+void testGet(ThreadPool& pool)
+{
+    TaskFuture<int> sum = pool.submit([] { return 1 + 2; });
+    check(sum.get() == 3, "submit int, get");
+
+    std::atomic<int> ran(0);
+    TaskFuture<void> v = pool.submit([&ran] { ran = 1; });
+    v.get();
+    check(ran == 1, "submit void, get");
+
+    TaskFuture<std::string> error = pool.submit([]() -> std::string { throw std::runtime_error("boom"); });
+    bool caught = false;
+    try
+    {
+        error.get();
+    }
+    catch (const std::runtime_error& e)
+    {
+        caught = std::string(e.what()) == "boom";
+    }
+    check(caught, "exception rethrown by get");
+}
+
+void testThenInLoop(ThreadPool& pool, EventLoop* loop)
+{
+    // 任务完成前注册
+    std::atomic<int> done(0);
+    std::atomic<bool> inLoop(false);
+    std::string result;
+    pool.submit([] { usleep(10000); return std::string("encoded"); })
+        .thenInLoop(loop, [&](TaskFuture<std::string>& f) {
+            inLoop = loop->isInLoopThread();
+            result = f.get();
+            done = 1;
+        });
+    waitFor(done);
+    check(inLoop && result == "encoded", "thenInLoop before completion runs in loop");
+
+    // 任务完成后注册
+    done = 0;
+    TaskFuture<int> ready = pool.submit([] { return 42; });
+    ready.wait();
+    int value = 0;
+    ready.thenInLoop(loop, [&](TaskFuture<int>& f) {
+        value = f.get();
+        done = 1;
+    });
+    waitFor(done);
+    check(value == 42, "thenInLoop after completion");
+
+    // 回调捕获的对象在回调执行后释放
+    done = 0;
+    std::shared_ptr<int> captured = std::make_shared<int>(7);
+    std::weak_ptr<int> weak = captured;
+    pool.submit([] {}).thenInLoop(loop, [captured, &done](TaskFuture<void>&) { done = 1; });
+    captured.reset();
+    waitFor(done);
+    loop->runInLoop([&done] { done = 2; });
+    while (done != 2)
+    {
+        usleep(1000);
+    }
+    check(weak.expired(), "continuation captures released");
+}
+
+void testAbandoned()
+{
+    TaskFuture<int> future;
+    {
+        ThreadPool pool("Stopped");
+        pool.setThreadSize(1);
+        pool.setMode(ThreadPool::kWorkStealing);
+        pool.start();
+        pool.stop();
+        usleep(10000);
+        future = pool.submit([] { return 1; });
+    }
+    bool caught = false;
+    try
+    {
+        future.get();
+    }
+    catch (const std::runtime_error&)
+    {
+        caught = true;
+    }
+    check(caught, "abandoned task reports an error");
+}
+
+const int kTasks = 200 * 1000;
+
+// 每个任务一次共享状态分配，回调中的对象放在共享状态里
+// nodeAllocations 是每个任务从 SizeClassAllocator 分配的次数，kWorkStealing 模式的任务节点是1次
+void benchAllocations(ThreadPool& pool, EventLoop* loop, const char* name, int nodeAllocations)
+{
+    std::shared_ptr<std::string> body = std::make_shared<std::string>(256, 'x');
+    std::atomic<int> remaining(kTasks);
+    std::atomic<int> done(0);
+
+    size_t before = g_allocations;
+    Timestamp start = Timestamp::now();
+    for (int i = 0; i < kTasks; ++i)
+    {
+        pool.submit([body, i] { return body->size() + i; })
+            .thenInLoop(loop, [&remaining, &done](TaskFuture<size_t>& f) {
+                f.get();
+                if (--remaining == 0)
+                {
+                    done = 1;
+                }
+            });
+    }
+    waitFor(done);
+    Timestamp end = Timestamp::now();
+    double us = static_cast<double>(end.microSecondsSinceEpoch() - start.microSecondsSinceEpoch());
+    double heap = static_cast<double>(g_allocations - before) / kTasks;
+    printf("%-36s allocations/task=%.3f (operator new %.3f + SizeClassAllocator %d)  ns/task=%.1f\n",
+           name, heap + nodeAllocations, heap, nodeAllocations, us * 1000 / kTasks);
+}
+
+int main()
+{
+    Logger::setLogLevel(Logger::WARN);
+    EventLoopThread loopThread;
+    EventLoop* loop = loopThread.startLoop();
+
+    ThreadPool shared("Shared");
+    shared.setThreadSize(2);
+    shared.start();
+    ThreadPool stealing("Stealing");
+    stealing.setThreadSize(2);
+    stealing.setMode(ThreadPool::kWorkStealing);
+    stealing.start();
+
+    testGet(shared);
+    testGet(stealing);
+    testThenInLoop(shared, loop);
+    testThenInLoop(stealing, loop);
+    testAbandoned();
+
+    benchAllocations(shared, loop, "submit+thenInLoop kSharedQueue", 0);
+    benchAllocations(stealing, loop, "submit+thenInLoop kWorkStealing", 1);
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+/**
+ * 小任务吞吐量：kSharedQueue 对比 kWorkStealing，线程数 1 到 64
+ *
+ * external: 4 个线程(模拟 I/O loop)各投递 N 个小任务
+ * fanout:   外部投递少量任务，每个任务在池内再投递一批子任务，走本线程队列
+ * 计时从投递开始，到析构线程池(stop 后等待所有任务执行完)结束
+ *
+ * ./ThreadPoolBench [每个投递线程的任务数]
+ */
+const int kProducers = 4;
+const int kFanout = 64;
+
+__thread uint64_t t_sink = 0;
+
+// 几十纳秒的计算
+void tinyTask()
+{
+    uint64_t x = t_sink + 1;
+    for (int i = 0; i < 16; ++i)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+    }
+    t_sink = x;
+}
+
+std::unique_ptr<ThreadPool> makePool(ThreadPool::Mode mode, int threads)
+{
+    std::unique_ptr<ThreadPool> pool(new ThreadPool("BenchPool"));
+    pool->setMode(mode);
+    pool->setThreadSize(threads);
+    pool->start();
+    return pool;
+}
+
+double benchExternal(ThreadPool::Mode mode, int threads, long tasksPerProducer)
+{
+    std::unique_ptr<ThreadPool> pool = makePool(mode, threads);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    for (int i = 0; i < kProducers; ++i)
+    {
+        producers.emplace_back([&pool, tasksPerProducer] {
+            for (long j = 0; j < tasksPerProducer; ++j)
+            {
+                pool->add(tinyTask);
+            }
+        });
+    }
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+    pool.reset();
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    return kProducers * tasksPerProducer / seconds / 1e6;
+}
+
+double benchFanout(ThreadPool::Mode mode, int threads, long tasks)
+{
+    std::unique_ptr<ThreadPool> pool = makePool(mode, threads);
+    ThreadPool* p = pool.get();
+    long roots = tasks / kFanout;
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < roots; ++i)
+    {
+        pool->add([p] {
+            for (int j = 0; j < kFanout - 1; ++j)
+            {
+                p->add(tinyTask);
+            }
+            tinyTask();
+        });
+    }
+    pool.reset();
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    return roots * kFanout / seconds / 1e6;
+}
+
+int main(int argc, char* argv[])
+{
+    long tasksPerProducer = argc > 1 ? atol(argv[1]) : 250000;
+    const int kThreads[] = {1, 2, 4, 8, 16, 32, 64};
+
+    printf("%-8s %18s %18s %18s %18s\n", "threads",
+           "external shared", "external stealing", "fanout shared", "fanout stealing");
+    for (int threads : kThreads)
+    {
+        double externalShared = benchExternal(ThreadPool::kSharedQueue, threads, tasksPerProducer);
+        double externalStealing = benchExternal(ThreadPool::kWorkStealing, threads, tasksPerProducer);
+        double fanoutShared = benchFanout(ThreadPool::kSharedQueue, threads, kProducers * tasksPerProducer);
+        double fanoutStealing = benchFanout(ThreadPool::kWorkStealing, threads, kProducers * tasksPerProducer);
+        printf("%-8d %13.2f M/s %13.2f M/s %13.2f M/s %13.2f M/s\n", threads,
+               externalShared, externalStealing, fanoutShared, fanoutStealing);
+    }
+    return 0;
+}
@@ -0,0 +1,259 @@
+#include "ThreadPool.h"
+#include "Timestamp.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/**
+ * ThreadPool 队列上限的四种处理方式和统计直方图，两种模式各测一遍
+ * 用一个闸门任务占住唯一的线程，再把队列填满
+ */
+int g_failures = 0;
+
+void check(bool ok, const char* mode, const char* what)
+{
+    printf("%-14s %-40s %s\n", mode, what, ok ? "ok" : "FAILED");
+    if (!ok)
+    {
+        ++g_failures;
+    }
+}
+
+class Gate
+{
+public:
+    Gate() : open_(false), entered_(false) {}
+
+    void pass()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        entered_ = true;
+        enteredCond_.notify_all();
+        while (!open_)
+        {
+            cond_.wait(lock);
+        }
+    }
+
+    void waitEntered()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!entered_)
+        {
+            enteredCond_.wait(lock);
+        }
+    }
+
+    void open()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        open_ = true;
+        cond_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::condition_variable enteredCond_;
+    bool open_;
+    bool entered_;
+};
+
+const size_t kMaxQueue = 4;
+
+// 启动一个线程的线程池，闸门任务开始执行后返回
+void startBlocked(ThreadPool& pool, ThreadPool::Mode mode, ThreadPool::OverflowPolicy policy, Gate& gate,
+                  int blockTimeoutMs = -1)
+{
+    pool.setThreadSize(1);
+    pool.setMode(mode);
+    pool.setMaxQueueSize(kMaxQueue);
+    pool.setOverflowPolicy(policy, blockTimeoutMs);
+    pool.start();
+    pool.add([&gate] { gate.pass(); });
+    gate.waitEntered();
+}
+
+void waitIdle(ThreadPool& pool)
+{
+    while (pool.queueSize() != 0)
+    {
+        usleep(1000);
+    }
+}
+
+void testReject(ThreadPool::Mode mode, const char* name)
+{
+    Gate gate;
+    std::atomic<int> ran(0);
+    std::atomic<int> rejected(0);
+    ThreadPool pool("Reject");
+    pool.setRejectCallback([&rejected](ThreadPool::ThreadFunction) { ++rejected; });
+    startBlocked(pool, mode, ThreadPool::kReject, gate);
+
+    int accepted = 0;
+    for (int i = 0; i < 10; ++i)
+    {
+        accepted += pool.add([&ran] { ++ran; });
+    }
+    check(accepted == static_cast<int>(kMaxQueue), name, "kReject accepts up to the limit");
+    check(rejected == 10 - static_cast<int>(kMaxQueue), name, "kReject passes the rest to the callback");
+    gate.open();
+    waitIdle(pool);
+    pool.stop();
+    check(pool.stats().rejected == 10 - kMaxQueue, name, "kReject counted");
+}
+
+void testCallerRuns(ThreadPool::Mode mode, const char* name)
+{
+    Gate gate;
+    std::atomic<int> inCaller(0);
+    ThreadPool pool("CallerRuns");
+    startBlocked(pool, mode, ThreadPool::kCallerRuns, gate);
+
+    std::thread::id caller = std::this_thread::get_id();
+    for (int i = 0; i < 10; ++i)
+    {
+        pool.add([&inCaller, caller] {
+            if (std::this_thread::get_id() == caller)
+            {
+                ++inCaller;
+            }
+        });
+    }
+    check(inCaller == 10 - static_cast<int>(kMaxQueue), name, "kCallerRuns runs the overflow inline");
+    check(pool.stats().callerRuns == 10 - kMaxQueue, name, "kCallerRuns counted");
+    gate.open();
+    pool.stop();
+}
+
+void testDropOldest(ThreadPool::Mode mode, const char* name)
+{
+    Gate gate;
+    std::atomic<int> ranMask(0);
+    std::atomic<int> dropped(0);
+    ThreadPool pool("DropOldest");
+    pool.setRejectCallback([&dropped](ThreadPool::ThreadFunction) { ++dropped; });
+    startBlocked(pool, mode, ThreadPool::kDropOldest, gate);
+
+    for (int i = 0; i < 10; ++i)
+    {
+        pool.add([&ranMask, i] { ranMask |= 1 << i; });
+    }
+    check(dropped == 10 - static_cast<int>(kMaxQueue), name, "kDropOldest drops the overflow");
+    gate.open();
+    waitIdle(pool);
+    pool.stop();
+    // 只有一个线程，收件箱是 FIFO，留下的是最后投递的几个
+    check(ranMask == ((1 << 10) - (1 << (10 - kMaxQueue))), name, "kDropOldest keeps the newest");
+    check(pool.stats().dropped == 10 - kMaxQueue, name, "kDropOldest counted");
+}
+
+void testBlock(ThreadPool::Mode mode, const char* name)
+{
+    // 等待到线程取走任务
+    {
+        Gate gate;
+        std::atomic<int> ran(0);
+        ThreadPool pool("Block");
+        startBlocked(pool, mode, ThreadPool::kBlock, gate);
+        for (size_t i = 0; i < kMaxQueue; ++i)
+        {
+            pool.add([&ran] { ++ran; });
+        }
+        std::thread opener([&gate] { usleep(20 * 1000); gate.open(); });
+        Timestamp start = Timestamp::now();
+        bool accepted = pool.add([&ran] { ++ran; });
+        int64_t waited = Timestamp::now().microSecondsSinceEpoch() - start.microSecondsSinceEpoch();
+        opener.join();
+        check(accepted && waited >= 10 * 1000, name, "kBlock waits for space");
+        waitIdle(pool);
+        pool.stop();
+        check(pool.stats().blocked == 1, name, "kBlock counted");
+    }
+    // 超时后拒绝
+    {
+        Gate gate;
+        ThreadPool pool("BlockTimeout");
+        startBlocked(pool, mode, ThreadPool::kBlock, gate, 10);
+        for (size_t i = 0; i < kMaxQueue; ++i)
+        {
+            pool.add([] {});
+        }
+        bool accepted = pool.add([] {});
+        check(!accepted && pool.stats().rejected == 1, name, "kBlock rejects after the timeout");
+        gate.open();
+        pool.stop();
+    }
+    // 池内线程投递时按 kCallerRuns 处理，不会等待自己
+    {
+        Gate gate;
+        std::atomic<int> inner(0);
+        std::atomic<int> done(0);
+        ThreadPool pool("BlockInner");
+        startBlocked(pool, mode, ThreadPool::kBlock, gate);
+        gate.open();
+        pool.add([&pool, &inner, &done] {
+            for (size_t i = 0; i < kMaxQueue * 2; ++i)
+            {
+                pool.add([&inner] { ++inner; });
+            }
+            done = 1;
+        });
+        while (done == 0 || inner != static_cast<int>(kMaxQueue * 2))
+        {
+            usleep(1000);
+        }
+        pool.stop();
+        check(pool.stats().callerRuns > 0, name, "kBlock from a pool thread runs inline");
+    }
+}
+
+void testStats(ThreadPool::Mode mode, const char* name)
+{
+    ThreadPool pool("Stats");
+    pool.setThreadSize(2);
+    pool.setMode(mode);
+    pool.setStatsEnabled(true);
+    pool.start();
+    const uint64_t kTasks = 200;
+    for (uint64_t i = 0; i < kTasks; ++i)
+    {
+        pool.add([] { usleep(100); });
+    }
+    // 执行时间在任务返回之后记录
+    while (pool.stats().runUs.count != kTasks)
+    {
+        usleep(1000);
+    }
+    pool.stop();
+    ThreadPool::Stats stats = pool.stats();
+    check(stats.queueDepth.count == kTasks && stats.waitUs.count == kTasks && stats.runUs.count == kTasks,
+          name, "every task recorded");
+    check(stats.runUs.percentile(0.5) >= 64, name, "run time histogram");
+    printf("  queueDepth %s\n  waitUs     %s\n  runUs      %s\n",
+           stats.queueDepth.toString().c_str(), stats.waitUs.toString().c_str(),
+           stats.runUs.toString().c_str());
+    pool.resetStats();
+    check(pool.stats().runUs.count == 0, name, "resetStats");
+}
+
+int main()
+{
+    Logger::setLogLevel(Logger::WARN);
+    const ThreadPool::Mode modes[] = {ThreadPool::kSharedQueue, ThreadPool::kWorkStealing};
+    const char* names[] = {"kSharedQueue", "kWorkStealing"};
+    for (int i = 0; i < 2; ++i)
+    {
+        testReject(modes[i], names[i]);
+        testCallerRuns(modes[i], names[i]);
+        testDropOldest(modes[i], names[i]);
+        testBlock(modes[i], names[i]);
+        testStats(modes[i], names[i]);
+    }
+    return g_failures == 0 ? 0 : 1;
+}
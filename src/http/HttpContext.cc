@@ -1,6 +1,49 @@
 #include "HttpContext.h"
 #include "Buffer.h"
 
+HttpContext::HttpContext()
+    : state_(kExpectRequestLine),
+      poolBlocks_(1),
+      request_(PoolAllocator<char>(&pool_)),
+      requestSequence_(0),
+      responseSequence_(0),
+      closing_(false)
+{
+    pool_.createPool();
+}
+
+HttpContext::~HttpContext()
+{
+    // request_ 在析构函数之后才析构，先换成不使用池的空请求
+    request_ = HttpRequest();
+    pool_.destroyPool();
+}
+
+void HttpContext::reset()
+{
+    state_ = kExpectRequestLine;
+
+    // 请求还没有释放，有内存在用的块数就是这个请求的用量
+    int used = pool_.smallBlocks(true);
+    if (used >= poolBlocks_)
+    {
+        poolBlocks_ = used;
+    }
+    else
+    {
+        // 每个请求向当前用量靠近 1/8
+        poolBlocks_ -= (poolBlocks_ - used + 7) / 8;
+    }
+
+    // 新的空请求不占用池中内存，旧请求在赋值时释放
+    request_ = HttpRequest(PoolAllocator<char>(&pool_));
+    pool_.resetPool();
+    if (pool_.smallBlocks() > poolBlocks_)
+    {
+        pool_.trimPool(poolBlocks_);
+    }
+}
+
 // 解析请求行
 bool HttpContext::processRequestLine(const char *begin, const char *end)
 {
@@ -56,7 +99,8 @@ bool HttpContext::processRequestLine(const char *begin, const char *end)
 // return false if any error
 bool HttpContext::parseRequest(Buffer* buf, Timestamp receiveTime)
 {
-    bool ok = false;
+    // 请求可能分多次到达，只有解析出错才返回false
+    bool ok = true;
     bool hasMore = true;
     while (hasMore)
     {
@@ -2,10 +2,22 @@
 #define HTTP_HTTPCONTEXT_H
 
 #include "HttpRequest.h"
+#include "MemoryPool.h"
+#include "noncopyable.h"
+
+#include <memory>
+#include <map>
+#include <stdint.h>
 
 class Buffer;
+class WebSocketCodec;
 
-class HttpContext
+/**
+ * 每个连接一个 HttpContext，保存解析状态和该连接的内存池
+ * 请求的字符串和头部都从池中分配，一个请求处理完(响应已经交给 writer)后 reset 一次性回收
+ * 池保留的块数跟随最近请求的大小调整，偶尔的大请求之后逐渐把多余的块还给系统
+ */
+class HttpContext : noncopyable
 {
 public:
     // HTTP请求状态
@@ -17,36 +29,55 @@ public:
         kGotAll,            // 解析完毕状态
     };
 
-    HttpContext()
-        : state_(kExpectRequestLine)
+    // 已完成但还不能发送的响应(前面的请求还在处理)
+    struct PendingResponse
     {
-    }
+        std::shared_ptr<Buffer> output;
+        bool close;
+    };
+    using PendingResponseMap = std::map<uint64_t, PendingResponse>;
+
+    HttpContext();
+    ~HttpContext();
 
     bool parseRequest(Buffer* buf, Timestamp receiveTime);
 
     bool gotAll() const { return state_ == kGotAll; }
 
-    // 重置HttpContext状态，异常安全
-    void reset()
-    {
-        state_ = kExpectRequestLine;
-        /**
-         * 构造一个临时空HttpRequest对象，和当前的成员HttpRequest对象交换置空
-         * 然后临时对象析构
-         */
-        HttpRequest dummy;
-        request_.swap(dummy);
-    }
+    // 重置HttpContext状态并回收请求使用的内存，请求回调返回后调用
+    void reset();
 
     const HttpRequest& request() const { return request_; }
 
     HttpRequest& request() { return request_; }
 
+    // 连接升级为WebSocket后，后续数据交给codec解析
+    void upgrade(const std::shared_ptr<WebSocketCodec>& codec) { webSocket_ = codec; }
+    WebSocketCodec* webSocket() const { return webSocket_.get(); }
+
+    // 请求按到达顺序编号，响应按编号顺序发送
+    uint64_t nextRequestSequence() { return requestSequence_++; }
+    uint64_t responseSequence() const { return responseSequence_; }
+    void advanceResponseSequence() { ++responseSequence_; }
+    PendingResponseMap& pendingResponses() { return pendingResponses_; }
+
+    // 某个请求的响应会关闭连接，之后到达的数据都丢弃，不再处理
+    void setClosing() { closing_ = true; }
+    bool closing() const { return closing_; }
+
 private:
     bool processRequestLine(const char *begin, const char *end);
 
     HttpRequestParseState state_;
+    MemoryPool pool_;               // 请求使用的内存池
+    int poolBlocks_;                // 最近请求用到的小块数，衰减的最大值
     HttpRequest request_;
+    std::shared_ptr<WebSocketCodec> webSocket_;
+
+    uint64_t requestSequence_;      // 下一个请求的序号
+    uint64_t responseSequence_;     // 下一个应该发送的响应序号
+    PendingResponseMap pendingResponses_;
+    bool closing_;
 };
 
 #endif // HTTP_HTTPCONTEXT_H
\ No newline at end of file
@@ -3,17 +3,26 @@
 
 #include "noncopyable.h"
 #include "Timestamp.h"
+#include "PoolAllocator.h"
+#include <string>
 #include <unordered_map>
 
+/**
+ * 路径、参数和头部使用 PoolAllocator
+ * HttpContext 解析时传入连接的内存池，拷贝出来的请求使用普通的堆内存，可以交给其他线程
+ */
 class HttpRequest
 {
 public:
     enum Method { kInvalid, kGet, kPost, kHead, kPut, kDelete };
     enum Version { kUnknown, kHttp10, kHttp11 };
 
-    HttpRequest()
+    explicit HttpRequest(const PoolAllocator<char>& alloc = PoolAllocator<char>())
         : method_(kInvalid),
-          version_(kUnknown)
+          version_(kUnknown),
+          path_(alloc),
+          query_(alloc),
+          headers_(0, PoolStringMap::hasher(), PoolStringMap::key_equal(), alloc)
     {        
     }
 
@@ -88,14 +97,17 @@ public:
         path_.assign(start, end);
     }
 
-    const std::string& path() const { return path_; }
+    // 返回拷贝，兼容按 std::string 使用请求的代码，热路径上用 poolPath 避免拷贝
+    std::string path() const { return std::string(path_.data(), path_.size()); }
+    const PoolString& poolPath() const { return path_; }
 
     void setQuery(const char *start, const char *end) 
     {
         query_.assign(start, end);
     }
 
-    const std::string& query() const { return query_; }
+    std::string query() const { return std::string(query_.data(), query_.size()); }
+    const PoolString& poolQuery() const { return query_; }
 
     void setReceiveTime(Timestamp t) 
     { 
@@ -106,35 +118,57 @@ public:
 
     void addHeader(const char *start, const char *colon, const char *end)
     {
-        std::string field(start, colon);
+        PoolString field(start, colon, path_.get_allocator());
         ++colon;
         // 跳过空格
         while (colon < end && isspace(*colon))
         {
             ++colon;
         }
-        std::string value(colon, end);
+        PoolString value(colon, end, path_.get_allocator());
         // value丢掉后面的空格，通过重新截断大小设置
         while (!value.empty() && isspace(value[value.size()-1]))
         {
           value.resize(value.size()-1);
         }
-        headers_[field] = value;
+        // operator[] 默认构造的值不使用池，所以先查找再插入
+        auto it = headers_.find(field);
+        if (it != headers_.end())
+        {
+            it->second = std::move(value);
+        }
+        else
+        {
+            headers_.emplace(std::move(field), std::move(value));
+        }
     }
 
     // 获取请求头部的对应值
     std::string getHeader(const std::string &field) const
     {
         std::string result;
-        auto it = headers_.find(field);
+        // 临时的查找键使用默认分配器，只读查询不占用连接内存池(池中释放的内存要到 reset 才复用)
+        auto it = headers_.find(PoolString(field.data(), field.size(), PoolAllocator<char>()));
         if (it != headers_.end())
         {
-            result = it->second;
+            result.assign(it->second.data(), it->second.size());
+        }
+        return result;
+    }
+
+    // 拷贝出普通的 std::unordered_map，只遍历头部时用 poolHeaders
+    std::unordered_map<std::string, std::string> headers() const
+    {
+        std::unordered_map<std::string, std::string> result;
+        for (const auto& header : headers_)
+        {
+            result.emplace(std::string(header.first.data(), header.first.size()),
+                           std::string(header.second.data(), header.second.size()));
         }
         return result;
     }
 
-    const std::unordered_map<std::string, std::string>& headers() const
+    const PoolStringMap& poolHeaders() const
     {
         return headers_;
     }
@@ -152,10 +186,10 @@ public:
 private:
     Method method_;         // 请求方法
     Version version_;       // 协议版本号
-    std::string path_;      // 请求路径
-    std::string query_;     // 询问参数
+    PoolString path_;       // 请求路径
+    PoolString query_;      // 询问参数
     Timestamp receiveTime_; // 请求时间
-    std::unordered_map<std::string, std::string> headers_; // 请求头部列表
+    PoolStringMap headers_; // 请求头部列表
 };
 
 #endif // HTTP_HTTPREQUEST_H
\ No newline at end of file
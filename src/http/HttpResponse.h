@@ -2,6 +2,7 @@
 #define HTTP_HTTPRESPONSE_H
 
 #include <unordered_map>
+#include <string>
 
 class Buffer;
 class HttpResponse
@@ -15,6 +16,8 @@ public:
         k301MovedPermanently = 301,
         k400BadRequest = 400,
         k404NotFound = 404,
+        k500InternalServerError = 500,
+        k503ServiceUnavailable = 503,
     };  
 
     explicit HttpResponse(bool close)
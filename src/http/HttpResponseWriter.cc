@@ -0,0 +1,88 @@
+#include "HttpResponseWriter.h"
+#include "HttpContext.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Buffer.h"
+#include "Logging.h"
+
+HttpResponseWriter::HttpResponseWriter(const TcpConnectionPtr& conn, uint64_t sequence, bool close)
+    : conn_(conn),
+      sequence_(sequence),
+      response_(close),
+      done_(false)
+{
+}
+
+HttpResponseWriter::~HttpResponseWriter()
+{
+    if (!done_)
+    {
+        LOG_ERROR << "HttpResponseWriter destroyed before done(), sequence=" << sequence_;
+        response_.setStatusCode(HttpResponse::k500InternalServerError);
+        response_.setStatusMessage("Internal Server Error");
+        response_.setCloseConnection(true);
+        finish();
+    }
+}
+
+void HttpResponseWriter::done()
+{
+    if (!done_.exchange(true))
+    {
+        finish();
+    }
+}
+
+void HttpResponseWriter::finish()
+{
+    done_ = true;
+    TcpConnectionPtr conn = conn_.lock();
+    if (!conn)
+    {
+        // 连接已经关闭，丢弃响应
+        return;
+    }
+    // 在调用线程序列化响应，减少loop线程的工作
+    std::shared_ptr<Buffer> output = std::make_shared<Buffer>();
+    response_.appendToBuffer(output.get());
+    conn->getLoop()->runInLoop(std::bind(&HttpResponseWriter::sendInLoop,
+                                         conn, sequence_, output, response_.closeConnection()));
+}
+
+void HttpResponseWriter::sendInLoop(const TcpConnectionPtr& conn,
+                                    uint64_t sequence,
+                                    const std::shared_ptr<Buffer>& output,
+                                    bool close)
+{
+    HttpContext* context = static_cast<HttpContext*>(conn->getContext().get());
+    if (context == nullptr || !conn->connected())
+    {
+        return;
+    }
+
+    // 前面还有请求没有完成，先暂存起来
+    if (sequence != context->responseSequence())
+    {
+        context->pendingResponses()[sequence] = HttpContext::PendingResponse{ output, close };
+        return;
+    }
+
+    conn->send(output.get());
+    context->advanceResponseSequence();
+
+    // 依次发送已经完成的后续响应
+    HttpContext::PendingResponseMap& pending = context->pendingResponses();
+    while (!close && !pending.empty() && pending.begin()->first == context->responseSequence())
+    {
+        conn->send(pending.begin()->second.output.get());
+        close = pending.begin()->second.close;
+        pending.erase(pending.begin());
+        context->advanceResponseSequence();
+    }
+
+    if (close)
+    {
+        pending.clear();
+        conn->shutdown();
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef HTTP_HTTPRESPONSEWRITER_H
+#define HTTP_HTTPRESPONSEWRITER_H
+
+#include "noncopyable.h"
+#include "Callback.h"
+#include "HttpResponse.h"
+
+#include <memory>
+#include <atomic>
+#include <stdint.h>
+
+class Buffer;
+
+/**
+ * 异步HTTP处理器使用的响应对象
+ *
+ * 处理器可以把 HttpResponseWriterPtr 交给 ThreadPool 等其他线程，
+ * 填写好 response() 之后在任意线程调用 done()，
+ * 响应会通过 runInLoop 回到连接所属的loop中发送
+ *
+ * 同一个 keep-alive 连接上的响应按请求到达的顺序发送，
+ * 先完成的后续请求会暂存在 HttpContext 中，直到前面的请求完成
+ */
+class HttpResponseWriter : noncopyable
+{
+public:
+    HttpResponseWriter(const TcpConnectionPtr& conn, uint64_t sequence, bool close);
+    // 没有调用 done() 就被销毁时回复 500，避免连接上后续的响应被一直阻塞
+    ~HttpResponseWriter();
+
+    HttpResponse* response() { return &response_; }
+
+    // 线程安全，只有第一次调用生效
+    void done();
+
+    uint64_t sequence() const { return sequence_; }
+
+private:
+    void finish();
+    static void sendInLoop(const TcpConnectionPtr& conn,
+                           uint64_t sequence,
+                           const std::shared_ptr<Buffer>& output,
+                           bool close);
+
+    std::weak_ptr<TcpConnection> conn_;
+    const uint64_t sequence_;   // 该请求在连接上的序号
+    HttpResponse response_;
+    std::atomic_bool done_;
+};
+
+using HttpResponseWriterPtr = std::shared_ptr<HttpResponseWriter>;
+
+#endif // HTTP_HTTPRESPONSEWRITER_H
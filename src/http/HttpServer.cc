@@ -34,6 +34,11 @@ void HttpServer::start()
 {
     LOG_INFO << "HttpServer[" << server_.name().c_str() << "] starts listening on " << server_.ipPort().c_str();
     server_.start();
+    // 此时subLoop都已经创建，为每个loop建立WebSocket连接集合
+    for (EventLoop* loop : server_.threadPool()->getAllLoops())
+    {
+        webSocketConnections_[loop];
+    }
 }
 
 void HttpServer::onConnection(const TcpConnectionPtr& conn)
@@ -41,10 +46,17 @@ void HttpServer::onConnection(const TcpConnectionPtr& conn)
     if (conn->connected())
     {
         LOG_INFO << "new Connection arrived";
+        // 每个连接保存自己的解析状态，请求可能分多次到达
+        conn->setContext(std::make_shared<HttpContext>());
     }
     else 
     {
         LOG_INFO << "Connection closed";
+        HttpContext* context = static_cast<HttpContext*>(conn->getContext().get());
+        if (context && context->webSocket())
+        {
+            webSocketConnections_[conn->getLoop()].erase(conn);
+        }
     }
 }
 
@@ -54,7 +66,7 @@ void HttpServer::onMessage(const TcpConnectionPtr& conn,
                            Timestamp receiveTime)
 {
     // LOG_INFO << "HttpServer::onMessage";
-    std::unique_ptr<HttpContext> context(new HttpContext);
+    HttpContext* context = static_cast<HttpContext*>(conn->getContext().get());
 
 #if 0
     // 打印请求报文
@@ -62,44 +74,154 @@ void HttpServer::onMessage(const TcpConnectionPtr& conn,
     std::cout << request << std::endl;
 #endif
 
+    // 已经升级的连接，数据都是WebSocket帧
+    if (context->webSocket())
+    {
+        context->webSocket()->onMessage(conn, buf);
+        return;
+    }
+
+    // 已经回复了关闭连接的响应，后面的请求不再执行
+    if (context->closing())
+    {
+        buf->retrieveAll();
+        return;
+    }
+
     // 进行状态机解析
     // 错误则发送 BAD REQUEST 半关闭
     if (!context->parseRequest(buf, receiveTime))
     {
         LOG_INFO << "parseRequest failed!";
-        conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
-        conn->shutdown();
+        onBadRequest(conn, buf);
+        return;
     }
 
-    // 如果成功解析
-    if (context->gotAll())
+    // 如果成功解析，一次读取可能包含多个请求(pipeline)
+    while (context->gotAll())
     {
         LOG_INFO << "parseRequest success!";
-        onRequest(conn, context->request());
+        bool close = onRequest(conn, context->request());
         context->reset();
+
+        if (close)
+        {
+            // 客户端收不到之后的响应，也不应该执行这些请求(例如 PUT/DELETE)
+            context->setClosing();
+            buf->retrieveAll();
+            break;
+        }
+
+        if (context->webSocket())
+        {
+            // 握手请求之后的数据属于WebSocket帧
+            if (buf->readableBytes() > 0)
+            {
+                context->webSocket()->onMessage(conn, buf);
+            }
+            break;
+        }
+        if (!context->parseRequest(buf, receiveTime))
+        {
+            LOG_INFO << "parseRequest failed!";
+            onBadRequest(conn, buf);
+            break;
+        }
     }
 }
 
-void HttpServer::onRequest(const TcpConnectionPtr& conn, const HttpRequest& req)
+bool HttpServer::onRequest(const TcpConnectionPtr& conn, const HttpRequest& req)
 {
+    if (webSocketCallback_ && WebSocketCodec::isUpgradeRequest(req))
+    {
+        onUpgrade(conn, req);
+        return false;
+    }
+
     const std::string& connection = req.getHeader("Connection");
 
     // 判断长连接还是短连接
     bool close = connection == "close" ||
         (req.version() == HttpRequest::kHttp10 && connection != "Keep-Alive");
-    // TODO:这里有问题，但是强制改写了
-    close = true;
-    // 响应信息
-    HttpResponse response(close);
-    // httpCallback_ 由用户传入，怎么写响应体由用户决定
-    // 此处初始化了一些response的信息，比如响应码，回复OK
-    httpCallback_(req, &response);
+    HttpContext* context = static_cast<HttpContext*>(conn->getContext().get());
+    // 响应信息，序号保证同一连接上的响应按请求顺序发送
+    HttpResponseWriterPtr writer(new HttpResponseWriter(conn, context->nextRequestSequence(), close));
+    if (admissionController_ && !admissionController_->admitRequest(conn->getLoop()))
+    {
+        // 过载时不进入业务处理，直接回复503并关闭连接
+        HttpResponse* resp = writer->response();
+        resp->setStatusCode(HttpResponse::k503ServiceUnavailable);
+        resp->setStatusMessage("Service Unavailable");
+        resp->addHeader("Retry-After", "1");
+        resp->setCloseConnection(true);
+        writer->done();
+        return true;
+    }
+    else if (asyncHttpCallback_)
+    {
+        // 处理器可以把writer交给其他线程，完成后再回到loop中发送
+        // 此时 response 可能正在其他线程中修改，只能按请求头判断
+        asyncHttpCallback_(req, writer);
+        return close;
+    }
+    else
+    {
+        // httpCallback_ 由用户传入，怎么写响应体由用户决定
+        // 此处初始化了一些response的信息，比如响应码，回复OK
+        httpCallback_(req, writer->response());
+        writer->done();
+        // 用户也可能主动设置关闭
+        return writer->response()->closeConnection();
+    }
+}
+
+void HttpServer::onBadRequest(const TcpConnectionPtr& conn, Buffer* buf)
+{
+    HttpContext* context = static_cast<HttpContext*>(conn->getContext().get());
+    // 和正常响应一样占用一个序号，前面的异步请求完成后才发送，直接 send 会插到它们前面，
+    // shutdown 之后这些响应也会被丢弃
+    HttpResponseWriterPtr writer(new HttpResponseWriter(conn, context->nextRequestSequence(), true));
+    HttpResponse* resp = writer->response();
+    resp->setStatusCode(HttpResponse::k400BadRequest);
+    resp->setStatusMessage("Bad Request");
+    resp->setCloseConnection(true);
+    writer->done();
+
+    context->setClosing();
+    buf->retrieveAll();
+}
+
+void HttpServer::onUpgrade(const TcpConnectionPtr& conn, const HttpRequest& req)
+{
     Buffer buf;
-    response.appendToBuffer(&buf);
-    // TODO:需要重载 TcpConnection::send 使其可以接收一个缓冲区
+    WebSocketCodec::handshake(req, &buf);
     conn->send(&buf);
-    if (response.closeConnection())
+
+    HttpContext* context = static_cast<HttpContext*>(conn->getContext().get());
+    context->upgrade(std::make_shared<WebSocketCodec>(webSocketCallback_));
+    webSocketConnections_[conn->getLoop()].insert(conn);
+    LOG_INFO << "HttpServer::onUpgrade " << conn->name() << " upgraded to websocket";
+}
+
+void HttpServer::broadcast(const std::string& message, WebSocketCodec::Opcode opcode)
+{
+    // 所有连接共享同一份编码好的帧
+    Buffer buf(message.size() + 10);
+    WebSocketCodec::encodeFrame(&buf, opcode, message.data(), message.size());
+    std::shared_ptr<std::string> frame = std::make_shared<std::string>(buf.retrieveAllAsString());
+
+    for (auto& item : webSocketConnections_)
     {
-        conn->shutdown();
+        EventLoop* loop = item.first;
+        loop->runInLoop(std::bind(&HttpServer::broadcastInLoop, this, loop, frame));
     }
-}
\ No newline at end of file
+}
+
+void HttpServer::broadcastInLoop(EventLoop* loop, const std::shared_ptr<std::string>& frame)
+{
+    for (const TcpConnectionPtr& conn : webSocketConnections_[loop])
+    {
+        // 在loop线程中直接写入socket，写不完的部分才会拷贝到outputBuffer_
+        conn->send(*frame);
+    }
+}
@@ -4,7 +4,11 @@
 #include "TcpServer.h"
 #include "noncopyable.h"
 #include "Logging.h"
+#include "WebSocketCodec.h"
+#include "HttpResponseWriter.h"
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 class HttpRequest;
 class HttpResponse;
@@ -13,6 +17,13 @@ class HttpServer : noncopyable
 {
 public:
     using HttpCallback = std::function<void (const HttpRequest&, HttpResponse*)>;
+    /**
+     * 异步处理器，处理完成后调用 writer->done()，可以在任意线程调用
+     * req 只在回调期间有效，交给其他线程使用时需要拷贝
+     */
+    using AsyncHttpCallback = std::function<void (const HttpRequest&, const HttpResponseWriterPtr&)>;
+    // 升级后的WebSocket连接收到完整消息时的回调
+    using WebSocketCallback = WebSocketCodec::MessageCallback;
 
     HttpServer(EventLoop *loop,
             const InetAddress& listenAddr,
@@ -25,18 +36,60 @@ public:
     {
         httpCallback_ = cb;
     }
+
+    // 设置后优先于 httpCallback_
+    void setAsyncHttpCallback(const AsyncHttpCallback& cb)
+    {
+        asyncHttpCallback_ = cb;
+    }
+
+    // 设置后才会接受 WebSocket 升级请求
+    void setWebSocketCallback(const WebSocketCallback& cb)
+    {
+        webSocketCallback_ = cb;
+    }
     
+    /**
+     * 过载保护，连接和请求共用同一个控制器
+     * 过载时新连接被直接关闭，已有连接上的新请求快速回复 503
+     */
+    void setAdmissionController(const std::shared_ptr<AdmissionController>& controller)
+    {
+        admissionController_ = controller;
+        server_.setAdmissionController(controller);
+    }
+
     void start();
 
+    /**
+     * 向所有 WebSocket 连接推送消息，线程安全
+     * 帧只编码一次，然后投递到每个subLoop，由subLoop发送给自己管理的连接
+     */
+    void broadcast(const std::string& message,
+                   WebSocketCodec::Opcode opcode = WebSocketCodec::kText);
+
 private:
+    // 每个subLoop管理的WebSocket连接，只在对应的loop线程中访问
+    using WebSocketConnections = std::unordered_set<TcpConnectionPtr>;
+
     void onConnection(const TcpConnectionPtr& conn);
     void onMessage(const TcpConnectionPtr &conn,
                     Buffer *buf,
                     Timestamp receiveTime);
-    void onRequest(const TcpConnectionPtr&, const HttpRequest&);
+    // 返回 true 表示响应会关闭连接
+    bool onRequest(const TcpConnectionPtr&, const HttpRequest&);
+    // 解析失败，按请求顺序回复400后关闭连接
+    void onBadRequest(const TcpConnectionPtr&, Buffer*);
+    void onUpgrade(const TcpConnectionPtr&, const HttpRequest&);
+    void broadcastInLoop(EventLoop* loop, const std::shared_ptr<std::string>& frame);
 
     TcpServer server_;
     HttpCallback httpCallback_;
+    AsyncHttpCallback asyncHttpCallback_;
+    WebSocketCallback webSocketCallback_;
+    std::shared_ptr<AdmissionController> admissionController_;
+    // start() 时为每个loop建立一项，之后不再增删键，所以各个loop可以并发访问自己的集合
+    std::unordered_map<EventLoop*, WebSocketConnections> webSocketConnections_;
 };
 
-#endif // HTTP_HTTPSERVER_H
\ No newline at end of file
+#endif // HTTP_HTTPSERVER_H
@@ -0,0 +1,398 @@
+#include "WebSocketCodec.h"
+#include "HttpRequest.h"
+#include "TcpConnection.h"
+#include "Buffer.h"
+#include "Logging.h"
+
+#include <string.h>
+#include <strings.h>
+#include <endian.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+
+const char kWebSocketGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// 控制帧负载最大125字节
+const size_t kMaxControlPayload = 125;
+
+inline uint32_t rotl(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+// 握手只需要计算一次 SHA-1，这里给出一个简单实现，避免引入 OpenSSL 依赖
+void sha1(const std::string& input, unsigned char digest[20])
+{
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+    std::string msg(input);
+    uint64_t bitLen = static_cast<uint64_t>(input.size()) * 8;
+    msg.push_back(static_cast<char>(0x80));
+    while (msg.size() % 64 != 56)
+    {
+        msg.push_back('\0');
+    }
+    for (int i = 7; i >= 0; --i)
+    {
+        msg.push_back(static_cast<char>((bitLen >> (i * 8)) & 0xff));
+    }
+
+    for (size_t chunk = 0; chunk < msg.size(); chunk += 64)
+    {
+        uint32_t w[80];
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(msg.data() + chunk);
+        for (int i = 0; i < 16; ++i)
+        {
+            w[i] = (uint32_t(p[i*4]) << 24) | (uint32_t(p[i*4+1]) << 16) |
+                   (uint32_t(p[i*4+2]) << 8) | uint32_t(p[i*4+3]);
+        }
+        for (int i = 16; i < 80; ++i)
+        {
+            w[i] = rotl(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i)
+        {
+            uint32_t f, k;
+            if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else             { f = b ^ c ^ d;                   k = 0xCA62C1D6; }
+            uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = temp;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+
+    for (int i = 0; i < 5; ++i)
+    {
+        digest[i*4]   = static_cast<unsigned char>(h[i] >> 24);
+        digest[i*4+1] = static_cast<unsigned char>(h[i] >> 16);
+        digest[i*4+2] = static_cast<unsigned char>(h[i] >> 8);
+        digest[i*4+3] = static_cast<unsigned char>(h[i]);
+    }
+}
+
+std::string base64Encode(const unsigned char* data, size_t len)
+{
+    static const char table[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string result;
+    result.reserve((len + 2) / 3 * 4);
+    for (size_t i = 0; i < len; i += 3)
+    {
+        uint32_t n = uint32_t(data[i]) << 16;
+        if (i + 1 < len) n |= uint32_t(data[i+1]) << 8;
+        if (i + 2 < len) n |= uint32_t(data[i+2]);
+        result.push_back(table[(n >> 18) & 0x3f]);
+        result.push_back(table[(n >> 12) & 0x3f]);
+        result.push_back(i + 1 < len ? table[(n >> 6) & 0x3f] : '=');
+        result.push_back(i + 2 < len ? table[n & 0x3f] : '=');
+    }
+    return result;
+}
+
+// 判断以逗号分隔的头部值中是否包含 token(忽略大小写)
+bool headerContainsToken(const std::string& value, const char* token)
+{
+    size_t tokenLen = strlen(token);
+    size_t start = 0;
+    while (start < value.size())
+    {
+        size_t comma = value.find(',', start);
+        if (comma == std::string::npos)
+        {
+            comma = value.size();
+        }
+        size_t b = start, e = comma;
+        while (b < e && isspace(value[b])) ++b;
+        while (e > b && isspace(value[e-1])) --e;
+        if (e - b == tokenLen && ::strncasecmp(value.data() + b, token, tokenLen) == 0)
+        {
+            return true;
+        }
+        start = comma + 1;
+    }
+    return false;
+}
+
+} // namespace
+
+WebSocketCodec::WebSocketCodec(const MessageCallback& cb, size_t maxMessageSize)
+    : messageCallback_(cb),
+      maxMessageSize_(maxMessageSize),
+      fragmentOpcode_(kContinuation),
+      closing_(false),
+      closeTimeout_(kDefaultCloseTimeout)
+{
+}
+
+void WebSocketCodec::applyMask(char* data, size_t len, const char* key)
+{
+    size_t i = 0;
+    uint32_t key32;
+    memcpy(&key32, key, sizeof(key32));
+
+#ifdef __SSE2__
+    // 一次处理16字节
+    const __m128i mask128 = _mm_set1_epi32(static_cast<int>(key32));
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(v, mask128));
+    }
+#endif
+
+    // 一次处理8字节，i 始终是4的倍数，所以掩码相位不变
+    const uint64_t mask64 = (static_cast<uint64_t>(key32) << 32) | key32;
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t v;
+        memcpy(&v, data + i, sizeof(v));
+        v ^= mask64;
+        memcpy(data + i, &v, sizeof(v));
+    }
+
+    for (; i < len; ++i)
+    {
+        data[i] ^= key[i & 3];
+    }
+}
+
+void WebSocketCodec::encodeFrame(Buffer* output, Opcode opcode,
+                                 const char* data, size_t len, bool fin)
+{
+    char header[10];
+    size_t headerLen = 2;
+    header[0] = static_cast<char>((fin ? 0x80 : 0x00) | (opcode & 0x0f));
+    if (len < 126)
+    {
+        header[1] = static_cast<char>(len);
+    }
+    else if (len <= 0xffff)
+    {
+        header[1] = 126;
+        uint16_t n = htobe16(static_cast<uint16_t>(len));
+        memcpy(header + 2, &n, sizeof(n));
+        headerLen += sizeof(n);
+    }
+    else
+    {
+        header[1] = 127;
+        uint64_t n = htobe64(static_cast<uint64_t>(len));
+        memcpy(header + 2, &n, sizeof(n));
+        headerLen += sizeof(n);
+    }
+    output->append(header, headerLen);
+    output->append(data, len);
+}
+
+void WebSocketCodec::send(const TcpConnectionPtr& conn, const std::string& message, Opcode opcode)
+{
+    Buffer buf(message.size() + 10);
+    encodeFrame(&buf, opcode, message.data(), message.size());
+    conn->send(&buf);
+}
+
+bool WebSocketCodec::isUpgradeRequest(const HttpRequest& req)
+{
+    return req.method() == HttpRequest::kGet &&
+           req.version() == HttpRequest::kHttp11 &&
+           headerContainsToken(req.getHeader("Upgrade"), "websocket") &&
+           headerContainsToken(req.getHeader("Connection"), "Upgrade") &&
+           req.getHeader("Sec-WebSocket-Version") == "13" &&
+           !req.getHeader("Sec-WebSocket-Key").empty();
+}
+
+void WebSocketCodec::handshake(const HttpRequest& req, Buffer* output)
+{
+    output->append("HTTP/1.1 101 Switching Protocols\r\n");
+    output->append("Upgrade: websocket\r\n");
+    output->append("Connection: Upgrade\r\n");
+    output->append("Sec-WebSocket-Accept: ");
+    output->append(acceptKey(req.getHeader("Sec-WebSocket-Key")));
+    output->append("\r\n\r\n");
+}
+
+std::string WebSocketCodec::acceptKey(const std::string& secWebSocketKey)
+{
+    unsigned char digest[20];
+    sha1(secWebSocketKey + kWebSocketGuid, digest);
+    return base64Encode(digest, sizeof(digest));
+}
+
+void WebSocketCodec::onMessage(const TcpConnectionPtr& conn, Buffer* buf)
+{
+    if (!closing_)
+    {
+        parseFrames(conn, buf);
+    }
+    if (closing_)
+    {
+        // 对端可能不理会关闭帧继续发送，不能让输入缓冲区一直增长
+        buf->retrieveAll();
+    }
+}
+
+void WebSocketCodec::parseFrames(const TcpConnectionPtr& conn, Buffer* buf)
+{
+    while (!closing_ && buf->readableBytes() >= 2)
+    {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(buf->peek());
+        bool fin = p[0] & 0x80;
+        Opcode opcode = static_cast<Opcode>(p[0] & 0x0f);
+        bool masked = p[1] & 0x80;
+        uint64_t payloadLen = p[1] & 0x7f;
+        size_t headerLen = 2;
+
+        // 没有协商扩展时 RSV 必须为0，客户端发来的帧必须带掩码
+        if ((p[0] & 0x70) || !masked)
+        {
+            closeWithError(conn, kProtocolError);
+            return;
+        }
+
+        if (payloadLen == 126)
+        {
+            if (buf->readableBytes() < headerLen + 2)
+            {
+                return;
+            }
+            uint16_t n;
+            memcpy(&n, p + headerLen, sizeof(n));
+            payloadLen = be16toh(n);
+            headerLen += 2;
+        }
+        else if (payloadLen == 127)
+        {
+            if (buf->readableBytes() < headerLen + 8)
+            {
+                return;
+            }
+            uint64_t n;
+            memcpy(&n, p + headerLen, sizeof(n));
+            payloadLen = be64toh(n);
+            headerLen += 8;
+        }
+
+        bool isControl = opcode & 0x08;
+        if (isControl && (!fin || payloadLen > kMaxControlPayload))
+        {
+            closeWithError(conn, kProtocolError);
+            return;
+        }
+        if (payloadLen > maxMessageSize_ || fragments_.size() + payloadLen > maxMessageSize_)
+        {
+            closeWithError(conn, kMessageTooBig);
+            return;
+        }
+
+        const char* maskKey = buf->peek() + headerLen;
+        headerLen += 4;
+        if (buf->readableBytes() < headerLen + payloadLen)
+        {
+            return;
+        }
+
+        // 负载拷贝出来后再解掩码，控制帧可能穿插在分片消息中间
+        std::string payload(buf->peek() + headerLen, static_cast<size_t>(payloadLen));
+        applyMask(&payload[0], payload.size(), maskKey);
+        buf->retrieve(headerLen + static_cast<size_t>(payloadLen));
+
+        if (isControl)
+        {
+            handleControlFrame(conn, opcode, payload);
+            continue;
+        }
+
+        if (opcode == kContinuation)
+        {
+            // 没有起始分片的延续帧
+            if (fragmentOpcode_ == kContinuation)
+            {
+                closeWithError(conn, kProtocolError);
+                return;
+            }
+            fragments_.append(payload);
+            if (fin)
+            {
+                std::string message;
+                message.swap(fragments_);
+                Opcode messageOpcode = fragmentOpcode_;
+                fragmentOpcode_ = kContinuation;
+                messageCallback_(conn, message, messageOpcode);
+            }
+        }
+        else if (opcode == kText || opcode == kBinary)
+        {
+            // 上一个分片消息还没有结束
+            if (fragmentOpcode_ != kContinuation)
+            {
+                closeWithError(conn, kProtocolError);
+                return;
+            }
+            if (fin)
+            {
+                messageCallback_(conn, payload, opcode);
+            }
+            else
+            {
+                fragmentOpcode_ = opcode;
+                fragments_.swap(payload);
+            }
+        }
+        else
+        {
+            closeWithError(conn, kProtocolError);
+            return;
+        }
+    }
+}
+
+void WebSocketCodec::handleControlFrame(const TcpConnectionPtr& conn, Opcode opcode, const std::string& payload)
+{
+    if (opcode == kPing)
+    {
+        send(conn, payload, kPong);
+    }
+    else if (opcode == kClose)
+    {
+        // 回送对端的状态码后关闭写端
+        sendClose(conn, payload.substr(0, 2));
+    }
+    else if (opcode == kPong)
+    {
+        // 服务端不主动 ping，忽略未请求的 pong
+    }
+    else
+    {
+        closeWithError(conn, kProtocolError);
+    }
+}
+
+void WebSocketCodec::closeWithError(const TcpConnectionPtr& conn, CloseCode code)
+{
+    LOG_INFO << "WebSocketCodec close " << conn->name() << " code=" << static_cast<int>(code);
+    char payload[2];
+    uint16_t n = htobe16(static_cast<uint16_t>(code));
+    memcpy(payload, &n, sizeof(n));
+    sendClose(conn, std::string(payload, sizeof(payload)));
+}
+
+void WebSocketCodec::sendClose(const TcpConnectionPtr& conn, const std::string& payload)
+{
+    closing_ = true;
+    send(conn, payload, kClose);
+    // shutdown 只关闭写端，对端不关闭连接时超时后强制关闭
+    conn->shutdown();
+    conn->forceCloseWithDelay(closeTimeout_);
+}
@@ -0,0 +1,103 @@
+#ifndef HTTP_WEBSOCKETCODEC_H
+#define HTTP_WEBSOCKETCODEC_H
+
+#include "noncopyable.h"
+#include "Callback.h"
+
+#include <string>
+#include <stdint.h>
+
+class Buffer;
+class HttpRequest;
+
+/**
+ * RFC 6455 WebSocket 帧编解码
+ *
+ *  0                   1                   2                   3
+ *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+ * +-+-+-+-+-------+-+-------------+-------------------------------+
+ * |F|R|R|R| opcode|M| Payload len |    Extended payload length    |
+ * |I|S|S|S|  (4)  |A|     (7)     |             (16/64)           |
+ * |N|V|V|V|       |S|             |   (if payload len==126/127)   |
+ * | |1|2|3|       |K|             |                               |
+ * +-+-+-+-+-------+-+-------------+ - - - - - - - - - - - - - - - +
+ * |     Extended payload length continued, if payload len == 127  |
+ * + - - - - - - - - - - - - - - - +-------------------------------+
+ * |                               |Masking-key, if MASK set to 1  |
+ * +-------------------------------+-------------------------------+
+ * | Masking-key (continued)       |          Payload Data         |
+ * +-------------------------------- - - - - - - - - - - - - - - - +
+ *
+ * 每个升级后的连接持有一个 codec，保存分片消息的组装状态
+ * 数据帧组装完整后回调用户，ping/pong/close 控制帧由 codec 内部处理
+ */
+class WebSocketCodec : noncopyable
+{
+public:
+    enum Opcode
+    {
+        kContinuation = 0x0,
+        kText = 0x1,
+        kBinary = 0x2,
+        kClose = 0x8,
+        kPing = 0x9,
+        kPong = 0xA,
+    };
+
+    // 关闭帧状态码
+    enum CloseCode
+    {
+        kNormalClosure = 1000,
+        kProtocolError = 1002,
+        kMessageTooBig = 1009,
+    };
+
+    using MessageCallback = std::function<void(const TcpConnectionPtr&,
+                                               const std::string&,
+                                               Opcode)>;
+
+    explicit WebSocketCodec(const MessageCallback& cb,
+                            size_t maxMessageSize = kDefaultMaxMessageSize);
+
+    /**
+     * 解析 buf 中所有完整的帧，不完整的帧留在 buf 中等待更多数据
+     * 发出关闭帧之后丢弃收到的所有数据，对端 closeTimeout 秒内没有关闭连接则强制关闭
+     */
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf);
+
+    void setCloseTimeout(double seconds) { closeTimeout_ = seconds; }
+
+    // 服务端发送的帧不需要掩码，编码一次即可发送给任意多个连接
+    static void encodeFrame(Buffer* output, Opcode opcode,
+                            const char* data, size_t len, bool fin = true);
+    static void send(const TcpConnectionPtr& conn, const std::string& message,
+                     Opcode opcode = kText);
+
+    // 以机器字为单位批量异或掩码，key 为4字节掩码
+    static void applyMask(char* data, size_t len, const char* key);
+
+    // 判断是否为合法的升级请求，并写入 101 Switching Protocols 握手响应
+    static bool isUpgradeRequest(const HttpRequest& req);
+    static void handshake(const HttpRequest& req, Buffer* output);
+
+    // Sec-WebSocket-Accept = base64(sha1(key + GUID))
+    static std::string acceptKey(const std::string& secWebSocketKey);
+
+    static const size_t kDefaultMaxMessageSize = 16 * 1024 * 1024;
+    static constexpr double kDefaultCloseTimeout = 5.0;
+
+private:
+    void parseFrames(const TcpConnectionPtr& conn, Buffer* buf);
+    void sendClose(const TcpConnectionPtr& conn, const std::string& payload);
+    void handleControlFrame(const TcpConnectionPtr& conn, Opcode opcode, const std::string& payload);
+    void closeWithError(const TcpConnectionPtr& conn, CloseCode code);
+
+    MessageCallback messageCallback_;
+    const size_t maxMessageSize_;
+    Opcode fragmentOpcode_;     // 正在组装的分片消息类型，kContinuation 表示没有分片
+    std::string fragments_;     // 分片消息组装缓冲区
+    bool closing_;              // 已发送关闭帧，不再处理后续数据
+    double closeTimeout_;       // 发送关闭帧后等待对端关闭的秒数
+};
+
+#endif // HTTP_WEBSOCKETCODEC_H
@@ -3,9 +3,13 @@
 #include "HttpResponse.h"
 #include "HttpContext.h"
 #include "Timestamp.h"
+#include "ThreadPool.h"
+
+#include <unistd.h>
 
 extern char favicon[555];
 bool benchmark = false;
+ThreadPool* g_workers = nullptr;
 
 void onRequest(const HttpRequest& req, HttpResponse* resp)
 {
@@ -14,14 +18,14 @@ void onRequest(const HttpRequest& req, HttpResponse* resp)
     // 打印头部
     if (!benchmark)
     {
-        const std::unordered_map<std::string, std::string>& headers = req.headers();
+        const PoolStringMap& headers = req.poolHeaders();
         for (const auto& header : headers)
         {
             std::cout << header.first << ": " << header.second << std::endl;
         }
     }
 
-    if (req.path() == "/")
+    if (req.poolPath() == "/")
     {
         resp->setStatusCode(HttpResponse::k200Ok);
         resp->setStatusMessage("OK");
@@ -32,14 +36,14 @@ void onRequest(const HttpRequest& req, HttpResponse* resp)
             "<body><h1>Hello</h1>Now is " + now +
             "</body></html>");
     }
-    else if (req.path() == "/favicon.ico")
+    else if (req.poolPath() == "/favicon.ico")
     {
         resp->setStatusCode(HttpResponse::k200Ok);
         resp->setStatusMessage("OK");
         resp->setContentType("image/png");
         resp->setBody(std::string(favicon, sizeof favicon));
     }
-    else if (req.path() == "/hello")
+    else if (req.poolPath() == "/hello")
     {
         resp->setStatusCode(HttpResponse::k200Ok);
         resp->setStatusMessage("OK");
@@ -56,11 +60,44 @@ void onRequest(const HttpRequest& req, HttpResponse* resp)
 
 }
 
+// 耗时的请求交给工作线程处理，不会阻塞subLoop上的其他连接
+void onAsyncRequest(const HttpRequest& req, const HttpResponseWriterPtr& writer)
+{
+    if (req.poolPath() == "/slow")
+    {
+        g_workers->add([writer]() {
+            // 模拟数据库查询等耗时操作
+            usleep(100 * 1000);
+            HttpResponse* resp = writer->response();
+            resp->setStatusCode(HttpResponse::k200Ok);
+            resp->setStatusMessage("OK");
+            resp->setContentType("text/plain");
+            resp->setBody("slow response\n");
+            writer->done();
+        });
+        return;
+    }
+    onRequest(req, writer->response());
+    writer->done();
+}
+
+// WebSocket 回声，浏览器中 new WebSocket("ws://host:8080/") 即可测试
+void onWebSocketMessage(const TcpConnectionPtr& conn, const std::string& message, WebSocketCodec::Opcode opcode)
+{
+    WebSocketCodec::send(conn, message, opcode);
+}
+
 int main(int argc, char* argv[])
 {
+    ThreadPool workers("HttpWorker");
+    workers.setThreadSize(4);
+    workers.start();
+    g_workers = &workers;
+
     EventLoop loop;
     HttpServer server(&loop, InetAddress(8080), "http-server");
-    server.setHttpCallback(onRequest);
+    server.setAsyncHttpCallback(onAsyncRequest);
+    server.setWebSocketCallback(onWebSocketMessage);
     server.start();
     loop.loop();
 }
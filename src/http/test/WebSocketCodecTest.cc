@@ -0,0 +1,386 @@
+#include "WebSocketCodec.h"
+#include "HttpRequest.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Buffer.h"
+#include "Logging.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <endian.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+/**
+ * WebSocketCodec 的握手、掩码、帧编解码、分片和控制帧
+ * 服务端连接建立在 socketpair 的一端，从另一端读取 codec 发出的帧
+ */
+int g_failures = 0;
+
+void check(bool ok, const char* what)
+{
+    printf("%-56s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+    {
+        ++g_failures;
+    }
+}
+
+const char kMaskKey[4] = { 0x37, static_cast<char>(0xfa), 0x21, 0x3d };
+
+// 客户端发出的帧，总是带掩码
+std::string clientFrame(int opcode, const std::string& payload, bool fin = true, bool masked = true)
+{
+    std::string frame;
+    frame.push_back(static_cast<char>((fin ? 0x80 : 0x00) | opcode));
+    char maskBit = masked ? static_cast<char>(0x80) : 0;
+    if (payload.size() < 126)
+    {
+        frame.push_back(static_cast<char>(maskBit | payload.size()));
+    }
+    else if (payload.size() <= 0xffff)
+    {
+        frame.push_back(static_cast<char>(maskBit | 126));
+        uint16_t n = htobe16(static_cast<uint16_t>(payload.size()));
+        frame.append(reinterpret_cast<const char*>(&n), sizeof(n));
+    }
+    else
+    {
+        frame.push_back(static_cast<char>(maskBit | 127));
+        uint64_t n = htobe64(payload.size());
+        frame.append(reinterpret_cast<const char*>(&n), sizeof(n));
+    }
+    std::string body(payload);
+    if (masked)
+    {
+        frame.append(kMaskKey, sizeof(kMaskKey));
+        for (size_t i = 0; i < body.size(); ++i)
+        {
+            body[i] ^= kMaskKey[i & 3];
+        }
+    }
+    return frame + body;
+}
+
+std::string closePayload(uint16_t code)
+{
+    uint16_t n = htobe16(code);
+    return std::string(reinterpret_cast<const char*>(&n), sizeof(n));
+}
+
+struct ServerFrame
+{
+    int opcode;
+    std::string payload;
+};
+
+// 解析服务端发出的不带掩码的帧
+std::vector<ServerFrame> parseServerFrames(const std::string& data)
+{
+    std::vector<ServerFrame> frames;
+    size_t pos = 0;
+    while (pos + 2 <= data.size())
+    {
+        int opcode = data[pos] & 0x0f;
+        uint64_t len = data[pos + 1] & 0x7f;
+        pos += 2;
+        if (len == 126)
+        {
+            uint16_t n;
+            memcpy(&n, data.data() + pos, sizeof(n));
+            len = be16toh(n);
+            pos += 2;
+        }
+        else if (len == 127)
+        {
+            uint64_t n;
+            memcpy(&n, data.data() + pos, sizeof(n));
+            len = be64toh(n);
+            pos += 8;
+        }
+        frames.push_back(ServerFrame{ opcode, data.substr(pos, static_cast<size_t>(len)) });
+        pos += static_cast<size_t>(len);
+    }
+    return frames;
+}
+
+/**
+ * 一个服务端连接和一个 codec，收到的消息保存在 messages 中
+ */
+class Peer
+{
+public:
+    explicit Peer(EventLoop* loop, size_t maxMessageSize = WebSocketCodec::kDefaultMaxMessageSize)
+        : codec_([this](const TcpConnectionPtr&, const std::string& message, WebSocketCodec::Opcode opcode) {
+                     messages.push_back(message);
+                     opcodes.push_back(opcode);
+                 },
+                 maxMessageSize),
+          closed(false)
+    {
+        int fds[2];
+        ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+        client_ = fds[1];
+        conn_ = std::make_shared<TcpConnection>(loop, "peer", fds[0], InetAddress(), InetAddress());
+        conn_->setConnectionCallback([](const TcpConnectionPtr&) {});
+        conn_->setCloseCallback([this](const TcpConnectionPtr&) { closed = true; });
+        conn_->connectEstablished();
+    }
+
+    ~Peer()
+    {
+        // 从 Poller 中移除 channel，和 TcpServer 销毁连接的顺序一致
+        conn_->connectDestroyed();
+        ::close(client_);
+    }
+
+    void feed(const std::string& data)
+    {
+        input_.append(data.data(), data.size());
+        codec_.onMessage(conn_, &input_);
+    }
+
+    // 客户端收到的所有帧
+    std::vector<ServerFrame> received()
+    {
+        std::string data;
+        char buf[4096];
+        ssize_t n;
+        while ((n = ::read(client_, buf, sizeof(buf))) > 0)
+        {
+            data.append(buf, n);
+        }
+        return parseServerFrames(data);
+    }
+
+    // 写端已经关闭时 read 返回0
+    bool writeShutdown()
+    {
+        char c;
+        return ::read(client_, &c, 1) == 0;
+    }
+
+    size_t buffered() const { return input_.readableBytes(); }
+    WebSocketCodec& codec() { return codec_; }
+
+    std::vector<std::string> messages;
+    std::vector<WebSocketCodec::Opcode> opcodes;
+    bool closed;
+
+private:
+    WebSocketCodec codec_;
+    TcpConnectionPtr conn_;
+    Buffer input_;
+    int client_;
+};
+
+void testAcceptKey()
+{
+    // RFC 6455 1.3 中的例子
+    check(WebSocketCodec::acceptKey("dGhlIHNhbXBsZSBub25jZQ==") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=",
+          "accept key matches RFC 6455");
+}
+
+void addHeader(HttpRequest& req, const char* line)
+{
+    const char* colon = strchr(line, ':');
+    req.addHeader(line, colon, line + strlen(line));
+}
+
+void testHandshake()
+{
+    HttpRequest req;
+    const char method[] = "GET";
+    req.setMethod(method, method + 3);
+    req.setVersion(HttpRequest::kHttp11);
+    addHeader(req, "Upgrade: websocket");
+    addHeader(req, "Connection: keep-alive, Upgrade");
+    addHeader(req, "Sec-WebSocket-Version: 13");
+    addHeader(req, "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==");
+    check(WebSocketCodec::isUpgradeRequest(req), "upgrade request recognised");
+
+    Buffer output;
+    WebSocketCodec::handshake(req, &output);
+    std::string response = output.retrieveAllAsString();
+    check(response.find("HTTP/1.1 101 Switching Protocols\r\n") == 0 &&
+          response.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") != std::string::npos,
+          "handshake response");
+
+    HttpRequest plain;
+    plain.setMethod(method, method + 3);
+    plain.setVersion(HttpRequest::kHttp11);
+    addHeader(plain, "Connection: keep-alive");
+    check(!WebSocketCodec::isUpgradeRequest(plain), "plain request is not an upgrade");
+}
+
+void testApplyMask()
+{
+    // 和逐字节异或比较，覆盖 SSE2、8字节和剩余字节三段
+    bool same = true;
+    bool restored = true;
+    for (size_t len = 0; len < 100; ++len)
+    {
+        std::string data;
+        for (size_t i = 0; i < len; ++i)
+        {
+            data.push_back(static_cast<char>(i * 7 + 3));
+        }
+        std::string masked(data);
+        WebSocketCodec::applyMask(&masked[0], masked.size(), kMaskKey);
+        for (size_t i = 0; i < len; ++i)
+        {
+            same = same && masked[i] == static_cast<char>(data[i] ^ kMaskKey[i & 3]);
+        }
+        WebSocketCodec::applyMask(&masked[0], masked.size(), kMaskKey);
+        restored = restored && masked == data;
+    }
+    check(same, "applyMask matches bytewise xor");
+    check(restored, "applyMask twice restores the data");
+}
+
+void testEncodeFrame()
+{
+    const size_t lengths[] = { 0, 125, 126, 65535, 65536 };
+    const size_t headers[] = { 2, 2, 4, 4, 10 };
+    bool ok = true;
+    for (int i = 0; i < 5; ++i)
+    {
+        std::string payload(lengths[i], 'a');
+        Buffer buf;
+        WebSocketCodec::encodeFrame(&buf, WebSocketCodec::kBinary, payload.data(), payload.size());
+        std::string frame = buf.retrieveAllAsString();
+        std::vector<ServerFrame> frames = parseServerFrames(frame);
+        ok = ok && frame.size() == headers[i] + lengths[i] && frames.size() == 1 &&
+             frames[0].opcode == WebSocketCodec::kBinary && frames[0].payload == payload;
+    }
+    check(ok, "encodeFrame 7/16/64 bit lengths");
+}
+
+void testMessages(EventLoop* loop)
+{
+    Peer peer(loop);
+    peer.feed(clientFrame(WebSocketCodec::kText, "hello"));
+    check(peer.messages.size() == 1 && peer.messages[0] == "hello" &&
+          peer.opcodes[0] == WebSocketCodec::kText, "single text frame");
+
+    // 一帧分多次到达
+    std::string frame = clientFrame(WebSocketCodec::kBinary, std::string(300, 'b'));
+    peer.feed(frame.substr(0, 1));
+    peer.feed(frame.substr(1, 3));
+    peer.feed(frame.substr(4, 100));
+    check(peer.messages.size() == 1 && peer.buffered() == 104, "partial frame waits for more data");
+    peer.feed(frame.substr(104));
+    check(peer.messages.size() == 2 && peer.messages[1] == std::string(300, 'b') &&
+          peer.buffered() == 0, "16 bit length frame");
+
+    std::string large(70000, 'l');
+    peer.feed(clientFrame(WebSocketCodec::kBinary, large));
+    check(peer.messages.size() == 3 && peer.messages[2] == large, "64 bit length frame");
+}
+
+void testFragmentation(EventLoop* loop)
+{
+    Peer peer(loop);
+    // 分片中间穿插 ping
+    peer.feed(clientFrame(WebSocketCodec::kText, "frag", false) +
+              clientFrame(WebSocketCodec::kPing, "p") +
+              clientFrame(WebSocketCodec::kContinuation, "men", false) +
+              clientFrame(WebSocketCodec::kContinuation, "ted"));
+    check(peer.messages.size() == 1 && peer.messages[0] == "fragmented" &&
+          peer.opcodes[0] == WebSocketCodec::kText, "fragments reassembled");
+    std::vector<ServerFrame> frames = peer.received();
+    check(frames.size() == 1 && frames[0].opcode == WebSocketCodec::kPong && frames[0].payload == "p",
+          "ping inside a fragmented message answered");
+
+    // 没有起始分片的延续帧
+    Peer orphan(loop);
+    orphan.feed(clientFrame(WebSocketCodec::kContinuation, "x"));
+    frames = orphan.received();
+    check(frames.size() == 1 && frames[0].opcode == WebSocketCodec::kClose &&
+          frames[0].payload == closePayload(WebSocketCodec::kProtocolError), "orphan continuation rejected");
+}
+
+void testControlFrames(EventLoop* loop)
+{
+    Peer peer(loop);
+    peer.feed(clientFrame(WebSocketCodec::kPong, "unsolicited"));
+    check(peer.received().empty(), "unsolicited pong ignored");
+
+    peer.feed(clientFrame(WebSocketCodec::kClose, closePayload(WebSocketCodec::kNormalClosure) + "bye"));
+    std::vector<ServerFrame> frames = peer.received();
+    check(frames.size() == 1 && frames[0].opcode == WebSocketCodec::kClose &&
+          frames[0].payload == closePayload(WebSocketCodec::kNormalClosure), "close echoed with status code");
+    check(peer.writeShutdown(), "write side shut down after close");
+
+    Peer bigPing(loop);
+    bigPing.feed(clientFrame(WebSocketCodec::kPing, std::string(126, 'p')));
+    frames = bigPing.received();
+    check(frames.size() == 1 && frames[0].payload == closePayload(WebSocketCodec::kProtocolError),
+          "control frame over 125 bytes rejected");
+
+    Peer fragmentedPing(loop);
+    fragmentedPing.feed(clientFrame(WebSocketCodec::kPing, "p", false));
+    frames = fragmentedPing.received();
+    check(frames.size() == 1 && frames[0].payload == closePayload(WebSocketCodec::kProtocolError),
+          "fragmented control frame rejected");
+}
+
+void testErrors(EventLoop* loop)
+{
+    Peer unmasked(loop);
+    unmasked.feed(clientFrame(WebSocketCodec::kText, "hi", true, false) + "trailing garbage");
+    std::vector<ServerFrame> frames = unmasked.received();
+    check(frames.size() == 1 && frames[0].payload == closePayload(WebSocketCodec::kProtocolError),
+          "unmasked frame rejected");
+    check(unmasked.buffered() == 0, "input discarded after close");
+    // 对端不理会关闭帧继续发送
+    for (int i = 0; i < 100; ++i)
+    {
+        unmasked.feed(std::string(1024, 'z'));
+    }
+    check(unmasked.buffered() == 0 && unmasked.messages.empty(), "input after close does not accumulate");
+
+    Peer tooBig(loop, 1024);
+    tooBig.feed(clientFrame(WebSocketCodec::kBinary, std::string(600, 'a'), false) +
+                clientFrame(WebSocketCodec::kContinuation, std::string(600, 'a')));
+    frames = tooBig.received();
+    check(frames.size() == 1 && frames[0].payload == closePayload(WebSocketCodec::kMessageTooBig),
+          "message over the size limit rejected");
+
+    Peer badOpcode(loop);
+    badOpcode.feed(clientFrame(0x3, "x"));
+    frames = badOpcode.received();
+    check(frames.size() == 1 && frames[0].payload == closePayload(WebSocketCodec::kProtocolError),
+          "reserved opcode rejected");
+}
+
+void testCloseTimeout(EventLoop* loop)
+{
+    Peer peer(loop);
+    peer.codec().setCloseTimeout(0.05);
+    peer.feed(clientFrame(WebSocketCodec::kText, "x", true, false));
+    check(!peer.closed, "connection open right after close frame");
+    // 对端一直不关闭，超时后强制关闭
+    loop->runAfter(0.2, [loop]() { loop->quit(); });
+    loop->loop();
+    check(peer.closed, "connection force closed after the close timeout");
+}
+
+int main()
+{
+    Logger::setLogLevel(Logger::WARN);
+    EventLoop loop;
+    testAcceptKey();
+    testHandshake();
+    testApplyMask();
+    testEncodeFrame();
+    testMessages(&loop);
+    testFragmentation(&loop);
+    testControlFrames(&loop);
+    testErrors(&loop);
+    testCloseTimeout(&loop);
+    return g_failures == 0 ? 0 : 1;
+}
@@ -1,120 +1,328 @@
 #include "AsyncLogging.h"
+#include "Logging.h"
 #include "Timestamp.h"
 
+#include <algorithm>
+#include <chrono>
 #include <stdio.h>
+#include <string.h>
+
+namespace
+{
+
+std::atomic<uint64_t> g_nextAsyncLoggingId(1);
+
+/**
+ * 线程局部的暂存区登记表
+ * 线程退出时把自己的暂存区标记为废弃，AsyncLogging 仍持有 shared_ptr，写完剩余日志后回收
+ */
+struct ThreadStagings
+{
+    ~ThreadStagings()
+    {
+        for (auto& entry : stagings)
+        {
+            entry.second->abandon();
+        }
+    }
+
+    std::vector<std::pair<uint64_t, std::shared_ptr<LogStagingRing>>> stagings;
+};
+
+thread_local ThreadStagings t_stagings;
+// 最近一次使用的实例，绝大多数程序只有一个 AsyncLogging
+__thread uint64_t t_lastId = 0;
+__thread LogStagingRing* t_lastStaging = nullptr;
+
+} // namespace
 
 AsyncLogging::AsyncLogging(const std::string& basename,
                            off_t rollSize,
-                           int flushInterval)
+                           int flushInterval,
+                           size_t stagingSize)
     : flushInterval_(flushInterval),
       running_(false),
       basename_(basename),
       rollSize_(rollSize),
+      stagingSize_(stagingSize),
+      overflowPolicy_(kBlock),
+      blockTimeoutMs_(-1),
+      fileOptions_(),
+      archiver_(),
+      id_(g_nextAsyncLoggingId++),
       thread_(std::bind(&AsyncLogging::threadFunc, this), "Logging"),
       mutex_(),
       cond_(),
-      currentBuffer_(new Buffer),
-      nextBuffer_(new Buffer),
-      buffers_()
+      drained_(),
+      wakeupPending_(false),
+      droppedMessages_(0),
+      droppedBytes_(0),
+      blockedAppends_(0),
+      peakQueuedBytes_(0),
+      stagings_()
 {
-    currentBuffer_->bzero();
-    nextBuffer_->bzero();
-    buffers_.reserve(16);
+    stagings_.reserve(16);
 }
 
 void AsyncLogging::append(const char* logline, int len)
 {
-    // lock在构造函数中自动绑定它的互斥体并加锁，在析构函数中解锁，大大减少了死锁的风险
-    std::lock_guard<std::mutex> lock(mutex_);
-    // 缓冲区剩余空间足够则直接写入
-    if (currentBuffer_->avail() > len)
+    LogStagingRing* staging = (t_lastId == id_) ? t_lastStaging : stagingForThisThread();
+    size_t used = 0;
+    if (staging->tryAppend(logline, len, &used))
     {
-        currentBuffer_->append(logline, len);
+        // 刚越过一半时唤醒后端，其余情况后端按 flushInterval 定时收集
+        if (used >= staging->capacity() / 2 && used - len < staging->capacity() / 2)
+        {
+            wakeupBackend();
+        }
     }
     else
     {
-        // 当前缓冲区空间不够，将新信息写入备用缓冲区
-        buffers_.push_back(std::move(currentBuffer_));
-        if (nextBuffer_) 
-        {
-            currentBuffer_ = std::move(nextBuffer_);
-        } 
-        else 
+        appendSlow(staging, logline, len);
+    }
+}
+
+// 第一次在本线程使用该实例，注册一个新的暂存区
+LogStagingRing* AsyncLogging::stagingForThisThread()
+{
+    for (auto& entry : t_stagings.stagings)
+    {
+        if (entry.first == id_)
         {
-            // 备用缓冲区也不够时，重新分配缓冲区，这种情况很少见
-            currentBuffer_.reset(new Buffer);
+            t_lastId = id_;
+            t_lastStaging = entry.second.get();
+            return t_lastStaging;
         }
-        currentBuffer_->append(logline, len);
-        // 唤醒写入磁盘得后端线程
-        cond_.notify_one();
     }
+
+    StagingPtr staging(new LogStagingRing(stagingSize_));
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stagings_.push_back(staging);
+    }
+    t_stagings.stagings.emplace_back(id_, staging);
+    t_lastId = id_;
+    t_lastStaging = staging.get();
+    return t_lastStaging;
 }
 
-void AsyncLogging::threadFunc()
+// 暂存区已满，按 overflowPolicy_ 处理
+void AsyncLogging::appendSlow(LogStagingRing* staging, const char* logline, size_t len)
 {
-    // output有写入磁盘的接口
-    LogFile output(basename_, rollSize_, false);
-    // 后端缓冲区，用于归还前端得缓冲区，currentBuffer nextBuffer
-    BufferPtr newBuffer1(new Buffer);
-    BufferPtr newBuffer2(new Buffer);
-    newBuffer1->bzero();
-    newBuffer2->bzero();
-    // 缓冲区数组置为16个，用于和前端缓冲区数组进行交换
-    BufferVector buffersToWrite;
-    buffersToWrite.reserve(16);
-    while (running_)
+    // 超过暂存区容量的超长日志分段写入，可能与其他线程的日志交错
+    // 丢掉其中一段会破坏整条日志，所以分段之间总是等待
+    if (LogStagingRing::recordSize(len) > staging->capacity())
     {
+        size_t chunk = staging->capacity() / 2;
+        while (len > 0)
         {
-            // 互斥锁保护，这样别的线程在这段时间就无法向前端Buffer数组写入数据
-            std::unique_lock<std::mutex> lock(mutex_);
-            if (buffers_.empty())
+            size_t n = std::min(chunk, len);
+            if (!waitForSpace(staging, logline, n, kBlock, -1))
             {
-                // 等待三秒也会接触阻塞
-                cond_.wait_for(lock, std::chrono::seconds(3));
+                recordDropped(1, len);
+                return;
             }
+            logline += n;
+            len -= n;
+        }
+        return;
+    }
+
+    if (!waitForSpace(staging, logline, len, overflowPolicy_, blockTimeoutMs_))
+    {
+        recordDropped(1, len);
+    }
+}
 
-            // 此时正使用得buffer也放入buffer数组中（没写完也放进去，避免等待太久才刷新一次）
-            buffers_.push_back(std::move(currentBuffer_));
-            // 归还正使用缓冲区
-            currentBuffer_ = std::move(newBuffer1);
-            // 后端缓冲区和前端缓冲区交换
-            buffersToWrite.swap(buffers_);
-            if (!nextBuffer_)
+// 写入成功返回true，本条日志需要丢弃时返回false
+bool AsyncLogging::waitForSpace(LogStagingRing* staging, const char* logline, size_t len,
+                                OverflowPolicy policy, int timeoutMs)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    bool blocked = false;
+    size_t used = 0;
+    while (!staging->tryAppend(logline, len, &used))
+    {
+        // 后端没有运行时没有人会腾出空间，只能丢弃
+        if (!running_)
+        {
+            fprintf(stderr, "AsyncLogging: staging buffer full, dropping %zu bytes\n", len);
+            return false;
+        }
+        if (policy == kDropNewest)
+        {
+            return false;
+        }
+        if (policy == kDropOldest)
+        {
+            size_t bytes = 0;
+            size_t messages = staging->dropUnclaimed(&bytes);
+            if (messages > 0)
             {
-                nextBuffer_ = std::move(newBuffer2);
+                recordDropped(messages, bytes);
+                continue;
             }
+            // 剩下的都是后端正在写的，等它写完
+        }
+        else if (timeoutMs >= 0 && std::chrono::steady_clock::now() >= deadline)
+        {
+            return false;
+        }
+
+        if (!blocked)
+        {
+            blocked = true;
+            blockedAppends_.fetch_add(1, std::memory_order_relaxed);
         }
+        std::unique_lock<std::mutex> lock(mutex_);
+        wakeupPending_ = true;
+        cond_.notify_one();
+        drained_.wait_for(lock, std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+void AsyncLogging::recordDropped(uint64_t messages, uint64_t bytes)
+{
+    droppedMessages_.fetch_add(messages, std::memory_order_relaxed);
+    droppedBytes_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+/**
+ * 由后端线程调用，汇总上次报告以来丢弃的条数
+ * 汇总通过 LOG_WARN 输出，通常就写回本实例，在下一轮收集时落盘
+ */
+void AsyncLogging::reportDropped(uint64_t* reported)
+{
+    uint64_t dropped = droppedMessages_.load(std::memory_order_relaxed);
+    if (dropped != *reported)
+    {
+        LOG_WARN << "AsyncLogging dropped " << dropped - *reported
+                 << " messages, total " << dropped;
+        *reported = dropped;
+    }
+}
+
+AsyncLogging::Stats AsyncLogging::stats()
+{
+    Stats stats = Stats();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& staging : stagings_)
+        {
+            stats.queuedBytes += staging->usedBytes();
+            stats.capacityBytes += staging->capacity();
+        }
+        stats.producerThreads = stagings_.size();
+    }
+    stats.peakQueuedBytes = std::max(stats.queuedBytes, peakQueuedBytes_.load(std::memory_order_relaxed));
+    stats.droppedMessages = droppedMessages_.load(std::memory_order_relaxed);
+    stats.droppedBytes = droppedBytes_.load(std::memory_order_relaxed);
+    stats.blockedAppends = blockedAppends_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void AsyncLogging::wakeupBackend()
+{
+    if (!wakeupPending_.exchange(true))
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cond_.notify_one();
+    }
+}
+
+void AsyncLogging::threadFunc()
+{
+    // output有写入磁盘的接口
+    LogFile output(basename_, rollSize_, false, 1024, fileOptions_);
+    // 二进制模式下每个文件都带有完整的调用点描述，保留策略删除旧文件后剩下的文件仍然可以解码
+    // 文本模式下描述表为空，不写入任何内容
+    output.setFileHeader([] { return Logger::binarySiteTable(); });
+    if (archiver_)
+    {
+        LogArchiver* archiver = archiver_.get();
+        output.setRollCallback([archiver](const std::string& filename) {
+            archiver->setActiveFile(filename);
+        });
+        archiver->setActiveFile(output.filename());
+    }
+    // 后端持有的暂存区快照，收集时不需要加锁
+    StagingVector stagingsToWrite;
+    stagingsToWrite.reserve(16);
 
-        // 遍历所有 buffer，将其写入文件
-        for (const auto& buffer : buffersToWrite)
+    // 暂存区逐条交出日志，攒成大块再写文件，避免每条日志都走一遍 LogFile::append
+    std::vector<char, HugePageStlAllocator<char, MemoryStats::kAsyncLogging>> batch(kBatchSize);
+    size_t batched = 0;
+    auto flushBatch = [&] {
+        if (batched > 0)
+        {
+            output.append(batch.data(), static_cast<int>(batched));
+            batched = 0;
+        }
+    };
+    auto write = [&](const char* data, size_t len) {
+        if (batched + len > kBatchSize)
         {
-            output.append(buffer->data(), buffer->length());
+            flushBatch();
+            if (len > kBatchSize)
+            {
+                output.append(data, static_cast<int>(len));
+                return;
+            }
         }
+        memcpy(batch.data() + batched, data, len);
+        batched += len;
+    };
+    uint64_t reportedDrops = 0;
 
-        // 只保留两个缓冲区
-        if (buffersToWrite.size() > 2)
+    while (running_)
+    {
         {
-            buffersToWrite.resize(2);
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait_for(lock, std::chrono::seconds(flushInterval_), [this] {
+                return wakeupPending_.load() || !running_;
+            });
+            wakeupPending_ = false;
+
+            // 回收已经退出且数据写完的线程的暂存区
+            stagings_.erase(std::remove_if(stagings_.begin(), stagings_.end(),
+                                           [](const StagingPtr& s) { return s->abandoned() && s->empty(); }),
+                            stagings_.end());
+            stagingsToWrite = stagings_;
         }
 
-        // 归还newBuffer1缓冲区
-        if (!newBuffer1)
+        size_t queued = 0;
+        for (const auto& staging : stagingsToWrite)
         {
-            newBuffer1 = std::move(buffersToWrite.back());
-            buffersToWrite.pop_back();
-            newBuffer1->reset();
+            queued += staging->usedBytes();
+        }
+        if (queued > peakQueuedBytes_.load(std::memory_order_relaxed))
+        {
+            peakQueuedBytes_.store(queued, std::memory_order_relaxed);
         }
 
-        // 归还newBuffer2缓冲区
-        if (!newBuffer2)
+        // 依次收集每个线程的暂存区，写入文件
+        for (const auto& staging : stagingsToWrite)
         {
-            newBuffer2 = std::move(buffersToWrite.back());
-            buffersToWrite.pop_back();
-            newBuffer2->reset();
+            staging->drain(write);
         }
+        flushBatch();
+        drained_.notify_all();
+        reportDropped(&reportedDrops);
 
-        buffersToWrite.clear(); // 清空后端缓冲区队列
         output.flush(); //清空文件缓冲区
     }
+
+    // 退出前把剩余的日志写完，最后一次丢弃汇总也在其中
+    reportDropped(&reportedDrops);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stagingsToWrite = stagings_;
+    }
+    for (const auto& staging : stagingsToWrite)
+    {
+        staging->drain(write);
+    }
+    flushBatch();
     output.flush();
-}
\ No newline at end of file
+}
@@ -6,19 +6,56 @@
 #include "FixedBuffer.h"
 #include "LogStream.h"
 #include "LogFile.h"
-
+#include "LogStagingRing.h"
+#include "LogArchiver.h"
 
 #include <vector>
 #include <memory>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
+#include <stdint.h>
 
-class AsyncLogging
+/**
+ * 异步日志
+ *
+ * 每个前端线程第一次 append 时注册一个自己独占的 LogStagingRing，
+ * 之后写日志只是一次 memcpy 加一次原子发布，前端线程之间没有任何锁竞争
+ * 后端线程依次把每个线程的暂存区写入文件，同一线程的日志保持先后顺序，
+ * 不同线程的日志以后端每次收集为单位交错
+ *
+ * 暂存区超过一半时唤醒后端，每个线程最多占用 stagingSize 字节，总内存为 线程数 * stagingSize
+ * 写满时的处理由 OverflowPolicy 决定，默认等待后端腾出空间，不丢弃日志
+ * 有日志被丢弃时，后端在下一轮收集后输出一条 WARN 汇总丢弃的条数
+ * 开启 HugePageAllocator 之后新建的暂存区和后端的批量写缓冲区使用大页
+ */
+class AsyncLogging : noncopyable
 {
 public:
+    // 暂存区写满时的处理方式
+    enum OverflowPolicy
+    {
+        kBlock,         // 等待后端腾出空间，超时后丢弃本条
+        kDropNewest,    // 立即丢弃本条
+        kDropOldest,    // 丢弃本线程还在排队、尚未被后端取走的旧日志
+    };
+
+    // 队列深度和丢弃统计
+    struct Stats
+    {
+        size_t queuedBytes;         // 所有暂存区中等待写入的字节数
+        size_t peakQueuedBytes;     // 后端收集时观察到的最大值
+        size_t capacityBytes;       // 所有暂存区的总容量
+        size_t producerThreads;     // 已注册暂存区的前端线程数
+        uint64_t droppedMessages;
+        uint64_t droppedBytes;
+        uint64_t blockedAppends;    // 因暂存区写满而等待的次数
+    };
+
     AsyncLogging(const std::string& basename,
                  off_t rollSize,
-                 int flushInterval = 3);
+                 int flushInterval = 3,
+                 size_t stagingSize = kDefaultStagingSize);
     ~AsyncLogging()
     {
         if (running_)
@@ -30,8 +67,34 @@ public:
     // 前端调用 append 写入日志
     void append(const char* logling, int len);
 
+    /**
+     * 暂存区写满时的处理方式，需要在 start 之前设置
+     * kBlock 最多等待 blockTimeoutMs 毫秒，小于0表示一直等待
+     * 超过暂存区容量的超长日志分段写入，分段之间总是等待，不受该选项影响
+     */
+    void setOverflowPolicy(OverflowPolicy policy, int blockTimeoutMs = -1)
+    {
+        overflowPolicy_ = policy;
+        blockTimeoutMs_ = blockTimeoutMs;
+    }
+
+    Stats stats();
+
+    // 日志文件的预分配、O_DIRECT 和后台同步选项，需要在 start 之前设置
+    void setFileOptions(const FileUtil::Options& options) { fileOptions_ = options; }
+
+    // 开启已滚动日志的后台压缩和清理，需要在 start 之前设置
+    void setArchiveOptions(const LogArchiver::Options& options)
+    {
+        archiver_.reset(new LogArchiver(basename_, options));
+    }
+
     void start()
     {
+        if (archiver_)
+        {
+            archiver_->start();
+        }
         running_ = true;
         thread_.start();
     }
@@ -39,28 +102,58 @@ public:
     void stop()
     {
         running_ = false;
-        cond_.notify_one();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cond_.notify_one();
+        }
         thread_.join();
+        if (archiver_)
+        {
+            archiver_->stop();
+        }
     }
 
+    // 每个前端线程暂存区的默认大小
+    static const size_t kDefaultStagingSize = 1024 * 1024;
+
 private:
-    using Buffer = FixedBuffer<kLargeBuffer>;
-    using BufferVector = std::vector<std::unique_ptr<Buffer>>;
-    using BufferPtr = BufferVector::value_type;
+    // 后端合并写入的缓冲区大小
+    static const size_t kBatchSize = 256 * 1024;
 
+    using StagingPtr = std::shared_ptr<LogStagingRing>;
+    using StagingVector = std::vector<StagingPtr>;
+
+    LogStagingRing* stagingForThisThread();
+    void appendSlow(LogStagingRing* staging, const char* logline, size_t len);
+    bool waitForSpace(LogStagingRing* staging, const char* logline, size_t len,
+                      OverflowPolicy policy, int timeoutMs);
+    void recordDropped(uint64_t messages, uint64_t bytes);
+    void reportDropped(uint64_t* reported);
+    void wakeupBackend();
     void threadFunc();
 
     const int flushInterval_;
     std::atomic<bool> running_;
     const std::string basename_;
     const off_t rollSize_;
+    const size_t stagingSize_;
+    OverflowPolicy overflowPolicy_;
+    int blockTimeoutMs_;
+    FileUtil::Options fileOptions_;
+    std::unique_ptr<LogArchiver> archiver_;
+    const uint64_t id_;                 // 区分同一线程中的多个 AsyncLogging 实例
     Thread thread_;
     std::mutex mutex_;
-    std::condition_variable cond_;
+    std::condition_variable cond_;      // 唤醒后端线程
+    std::condition_variable drained_;   // 后端收集完一轮，通知等待空间的前端
+    std::atomic<bool> wakeupPending_;
+
+    std::atomic<uint64_t> droppedMessages_;
+    std::atomic<uint64_t> droppedBytes_;
+    std::atomic<uint64_t> blockedAppends_;
+    std::atomic<size_t> peakQueuedBytes_;
 
-    BufferPtr currentBuffer_;
-    BufferPtr nextBuffer_;
-    BufferVector buffers_;
+    StagingVector stagings_;            // 所有前端线程的暂存区，由 mutex_ 保护
 };
 
-#endif // ASYNC_LOGGING_H
\ No newline at end of file
+#endif // ASYNC_LOGGING_H
@@ -1,57 +1,199 @@
 #include "FileUtil.h"
 #include "Logging.h"
 
-FileUtil::FileUtil(std::string& fileName)
-    : fp_(::fopen(fileName.c_str(), "ae")),
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace
+{
+
+// O_DIRECT 要求缓冲区地址、文件偏移和长度都按块对齐
+const size_t kAlignment = 4096;
+
+size_t alignDown(size_t n) { return n & ~(kAlignment - 1); }
+size_t alignUp(size_t n) { return alignDown(n + kAlignment - 1); }
+
+} // namespace
+
+FileUtil::FileUtil(std::string& fileName, const Options& options, off_t segmentSize)
+    : fd_(::open(fileName.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644)),
+      directFd_(-1),
+      buffer_(nullptr),
+      bufferSize_(std::max(alignUp(options.bufferSize), kAlignment)),
+      bufferLen_(0),
+      fileOffset_(0),
+      syncedOffset_(0),
+      allocatedSize_(0),
+      syncBytes_(options.syncBytes),
       writtenBytes_(0)
 {
-    // 将fd_缓冲区设置为本地的buffer_
-    ::setbuffer(fp_, buffer_, sizeof(buffer_));
+    if (fd_ < 0)
+    {
+        fprintf(stderr, "FileUtil: open %s failed %s\n", fileName.c_str(), getErrnoMsg(errno));
+    }
+    if (::posix_memalign(reinterpret_cast<void**>(&buffer_), kAlignment, bufferSize_) != 0)
+    {
+        abort();
+    }
+
+    // 与原来 fopen("a") 一样追加到已有文件末尾
+    struct stat st;
+    off_t size = (fd_ >= 0 && ::fstat(fd_, &st) == 0) ? st.st_size : 0;
+    fileOffset_ = size;
+    syncedOffset_ = size;
+    allocatedSize_ = size;
+
+    if (fd_ >= 0 && options.directIO)
+    {
+        directFd_ = ::open(fileName.c_str(), O_WRONLY | O_DIRECT | O_CLOEXEC);
+        if (directFd_ < 0)
+        {
+            fprintf(stderr, "FileUtil: O_DIRECT not supported for %s, using buffered writes\n",
+                    fileName.c_str());
+        }
+        else
+        {
+            // 文件末尾不足一页的部分读回缓冲区，保证 fileOffset_ 按页对齐
+            off_t aligned = static_cast<off_t>(alignDown(size));
+            size_t tail = static_cast<size_t>(size - aligned);
+            int readFd = ::open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+            if (tail != 0 && (readFd < 0 || ::pread(readFd, buffer_, tail, aligned) != static_cast<ssize_t>(tail)))
+            {
+                ::close(directFd_);
+                directFd_ = -1;
+            }
+            else
+            {
+                fileOffset_ = aligned;
+                bufferLen_ = tail;
+            }
+            if (readFd >= 0)
+            {
+                ::close(readFd);
+            }
+        }
+    }
+
+    // 预分配不改变文件大小，读日志的程序看不到多余的0
+    if (fd_ >= 0 && options.preallocate && segmentSize > size)
+    {
+        if (::fallocate(fd_, FALLOC_FL_KEEP_SIZE, size, segmentSize - size) == 0)
+        {
+            allocatedSize_ = segmentSize;
+        }
+    }
 }
 
 FileUtil::~FileUtil()
 {
-    ::fclose(fp_);
+    flush();
+    if (fd_ >= 0)
+    {
+        // 归还没有用到的预分配空间，截断到原大小会释放文件末尾之后的块
+        off_t end = fileOffset_ + static_cast<off_t>(bufferLen_);
+        if (allocatedSize_ > end)
+        {
+            ::ftruncate(fd_, end);
+        }
+        ::close(fd_);
+    }
+    if (directFd_ >= 0)
+    {
+        ::close(directFd_);
+    }
+    ::free(buffer_);
 }
 
 void FileUtil::append(const char* data, size_t len)
 {
-    // 记录已经写入的数据大小
-    size_t written = 0;
+    // 记录目前为止写入的数据大小，超过限制会滚动日志
+    writtenBytes_ += len;
 
-    while (written != len)
+    while (len > 0)
     {
-        // 还需写入的数据大小
-        size_t remain = len - written;
-        size_t n = write(data + written, remain);
-        if (n != remain)
+        size_t n = std::min(len, bufferSize_ - bufferLen_);
+        memcpy(buffer_ + bufferLen_, data, n);
+        bufferLen_ += n;
+        data += n;
+        len -= n;
+        if (bufferLen_ == bufferSize_)
         {
-            int err = ferror(fp_);
-            if (err)
-            {
-                fprintf(stderr, "FileUtil::append() failed %s\n", getErrnoMsg(err));
-            }
+            writeBuffer(false);
         }
-        // 更新写入的数据大小
-        written += n;
     }
-    // 记录目前为止写入的数据大小，超过限制会滚动日志
-    writtenBytes_ += written;
 }
 
 void FileUtil::flush()
 {
-    ::fflush(fp_);
+    if (bufferLen_ > 0)
+    {
+        writeBuffer(true);
+    }
 }
 
-size_t FileUtil::write(const char* data, size_t len)
-{
-    /**
-     * size_t fwrite(const void* buffer, size_t size, size_t count, FILE* stream);
-     * -- buffer:指向数据块的指针
-     * -- size:每个数据的大小，单位为Byte(例如：sizeof(int)就是4)
-     * -- count:数据个数
-     * -- stream:文件指针
-     */
-    return ::fwrite_unlocked(data, 1, len, fp_);
-}
\ No newline at end of file
+void FileUtil::sync()
+{
+    if (fd_ >= 0)
+    {
+        ::fdatasync(fd_);
+    }
+}
+
+/**
+ * 写出缓冲区
+ * withTail 为 false 时 directIO 模式下只写整页，不足一页的尾部留到下次
+ */
+void FileUtil::writeBuffer(bool withTail)
+{
+    if (directFd_ >= 0)
+    {
+        size_t aligned = alignDown(bufferLen_);
+        size_t tail = bufferLen_ - aligned;
+        pwriteAll(directFd_, buffer_, aligned, fileOffset_);
+        if (withTail && tail > 0)
+        {
+            pwriteAll(fd_, buffer_ + aligned, tail, fileOffset_ + static_cast<off_t>(aligned));
+        }
+        memmove(buffer_, buffer_ + aligned, tail);
+        fileOffset_ += static_cast<off_t>(aligned);
+        bufferLen_ = tail;
+    }
+    else
+    {
+        pwriteAll(fd_, buffer_, bufferLen_, fileOffset_);
+        fileOffset_ += static_cast<off_t>(bufferLen_);
+        bufferLen_ = 0;
+    }
+
+    // 提前发起异步回写，内核不会攒下大量脏页后集中刷盘导致写入卡顿
+    if (syncBytes_ > 0 && fileOffset_ - syncedOffset_ >= static_cast<off_t>(syncBytes_))
+    {
+        ::sync_file_range(fd_, syncedOffset_, fileOffset_ - syncedOffset_, SYNC_FILE_RANGE_WRITE);
+        syncedOffset_ = fileOffset_;
+    }
+}
+
+void FileUtil::pwriteAll(int fd, const char* data, size_t len, off_t offset)
+{
+    while (len > 0)
+    {
+        ssize_t n = ::pwrite(fd, data, len, offset);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            fprintf(stderr, "FileUtil::append() failed %s\n", getErrnoMsg(errno));
+            return;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+        offset += n;
+    }
+}
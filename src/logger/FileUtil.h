@@ -2,26 +2,73 @@
 #define FILE_UTIL_H
 
 #include <stdio.h>
+#include <sys/types.h>
 #include <string>
 
+/**
+ * 日志文件写入
+ *
+ * 数据先攒在按页对齐的用户态缓冲区中，写满或 flush 时一次 pwrite 写入
+ * 打开时用 fallocate 预分配整个日志段，避免边写边分配磁盘块
+ * 每写入 syncBytes 字节用 sync_file_range 发起异步回写，脏页不会堆积到一次性刷盘
+ * fdatasync 由 LogFile 的后台线程调用，不阻塞写日志的线程
+ *
+ * 开启 directIO 时整块数据用 O_DIRECT 写入，不足一页的尾部通过普通fd写入，
+ * 同时保留在缓冲区中，下次连同后续数据按页重新写一遍
+ */
 class FileUtil
 {
 public:
-    explicit FileUtil(std::string& fileName);
+    struct Options
+    {
+        Options()
+            : preallocate(true),
+              directIO(false),
+              bufferSize(kDefaultBufferSize),
+              syncBytes(kDefaultSyncBytes),
+              syncInterval(1)
+        {
+        }
+
+        bool preallocate;   // 打开时按日志段大小预分配
+        bool directIO;      // 使用 O_DIRECT 绕过页缓存，文件系统不支持时自动退回普通写入
+        size_t bufferSize;  // 用户态缓冲区大小，按页对齐
+        size_t syncBytes;   // 每写入这么多字节发起一次异步回写，0表示不发起
+        int syncInterval;   // LogFile 后台 fdatasync 的间隔(秒)，0表示不启动后台同步
+    };
+
+    static const size_t kDefaultBufferSize = 1024 * 1024;
+    static const size_t kDefaultSyncBytes = 8 * 1024 * 1024;
+
+    explicit FileUtil(std::string& fileName,
+                      const Options& options = Options(),
+                      off_t segmentSize = 0);
     ~FileUtil();
 
     void append(const char* data, size_t len);
 
+    // 缓冲区中的数据写入内核
     void flush();
 
+    // 数据落盘，可以在其他线程调用
+    void sync();
+
     off_t writtenBytes() const { return writtenBytes_; }
 
 private:    
-    size_t write(const char* data, size_t len);
+    void writeBuffer(bool withTail);
+    void pwriteAll(int fd, const char* data, size_t len, off_t offset);
 
-    FILE* fp_;
-    char buffer_[64 * 1024]; // fp_的缓冲区
-    off_t writtenBytes_; // off_t用于指示文件的偏移量
+    int fd_;
+    int directFd_;          // O_DIRECT 打开的fd，未开启时为-1
+    char* buffer_;          // 按页对齐
+    const size_t bufferSize_;
+    size_t bufferLen_;
+    off_t fileOffset_;      // buffer_[0] 对应的文件偏移，directIO 时按页对齐
+    off_t syncedOffset_;    // 已发起回写的位置
+    off_t allocatedSize_;   // 预分配到的位置
+    const size_t syncBytes_;
+    off_t writtenBytes_;    // 本次打开后写入的数据大小，超过限制会滚动日志
 };
 
-#endif // FILE_UTIL_H
\ No newline at end of file
+#endif // FILE_UTIL_H
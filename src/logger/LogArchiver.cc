@@ -0,0 +1,288 @@
+#include "LogArchiver.h"
+#include "CurrentThread.h"
+
+#include <algorithm>
+#include <vector>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <zlib.h>
+
+namespace
+{
+
+const char kLogSuffix[] = ".log";
+const char kArchiveSuffix[] = ".log.gz";
+
+bool endsWith(const std::string& s, const char* suffix)
+{
+    size_t len = strlen(suffix);
+    return s.size() >= len && s.compare(s.size() - len, len, suffix) == 0;
+}
+
+/**
+ * LogFile 生成的文件名：prefix + "%Y%m%d-%H%M%S" + ".log"，压缩后再加 ".gz"
+ * 只按前缀匹配会把同目录下 basename.backup.log 这类其他文件也压缩、删除
+ */
+bool isLogFileName(const std::string& name, const std::string& prefix)
+{
+    static const char kTimePattern[] = "00000000-000000";
+    const size_t timeLen = sizeof(kTimePattern) - 1;
+    if (name.size() < prefix.size() + timeLen || name.compare(0, prefix.size(), prefix) != 0)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < timeLen; ++i)
+    {
+        char c = name[prefix.size() + i];
+        bool ok = kTimePattern[i] == '-' ? c == '-' : isdigit(static_cast<unsigned char>(c)) != 0;
+        if (!ok)
+        {
+            return false;
+        }
+    }
+    std::string suffix = name.substr(prefix.size() + timeLen);
+    return suffix == kLogSuffix || suffix == kArchiveSuffix;
+}
+
+// 线程级别的CPU和IO低优先级，设置失败不影响功能
+void lowerThreadPriority()
+{
+    ::setpriority(PRIO_PROCESS, static_cast<id_t>(CurrentThread::tid()), 19);
+    // IOPRIO_WHO_PROCESS = 1，IOPRIO_CLASS_IDLE = 3
+    ::syscall(SYS_ioprio_set, 1, CurrentThread::tid(), 3 << 13);
+}
+
+struct LogFileInfo
+{
+    std::string path;
+    int64_t size;
+    time_t mtime;
+};
+
+} // namespace
+
+LogArchiver::LogArchiver(const std::string& basename, const Options& options)
+    : options_(options),
+      thread_(std::bind(&LogArchiver::threadFunc, this), "LogArchive"),
+      running_(false),
+      pending_(false)
+{
+    size_t slash = basename.rfind('/');
+    if (slash == std::string::npos)
+    {
+        directory_ = ".";
+        prefix_ = basename + ".";
+    }
+    else
+    {
+        directory_ = slash == 0 ? "/" : basename.substr(0, slash);
+        prefix_ = basename.substr(slash + 1) + ".";
+    }
+}
+
+LogArchiver::~LogArchiver()
+{
+    if (running_)
+    {
+        stop();
+    }
+}
+
+void LogArchiver::start()
+{
+    running_ = true;
+    thread_.start();
+}
+
+void LogArchiver::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    cond_.notify_one();
+    thread_.join();
+}
+
+void LogArchiver::setActiveFile(const std::string& filename)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        activeFile_ = filename;
+        pending_ = true;
+    }
+    cond_.notify_one();
+}
+
+void LogArchiver::threadFunc()
+{
+    lowerThreadPriority();
+    while (true)
+    {
+        std::string activeFile;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait_for(lock, std::chrono::seconds(options_.scanInterval), [this] {
+                return pending_ || !running_;
+            });
+            if (!running_)
+            {
+                break;
+            }
+            pending_ = false;
+            activeFile = activeFile_;
+        }
+        // 还不知道正在写哪个文件时，任何 .log 都可能是它，不做处理
+        if (!activeFile.empty())
+        {
+            archiveOnce(activeFile);
+        }
+    }
+}
+
+void LogArchiver::archiveOnce(const std::string& activeFile)
+{
+    DIR* dir = ::opendir(directory_.c_str());
+    if (dir == nullptr)
+    {
+        return;
+    }
+
+    std::string activeName = activeFile.substr(activeFile.rfind('/') + 1);
+    std::vector<std::string> names;
+    while (struct dirent* entry = ::readdir(dir))
+    {
+        std::string name(entry->d_name);
+        if (isLogFileName(name, prefix_))
+        {
+            names.push_back(name);
+        }
+    }
+    ::closedir(dir);
+
+    std::vector<LogFileInfo> files;
+    int64_t totalBytes = 0;
+    time_t now = ::time(NULL);
+    for (const std::string& name : names)
+    {
+        std::string path = directory_ + "/" + name;
+        if (options_.compress && name != activeName && endsWith(name, kLogSuffix))
+        {
+            std::string archive = path + ".gz";
+            if (compressFile(path, archive, options_.compressionLevel))
+            {
+                ::unlink(path.c_str());
+                path = archive;
+            }
+        }
+
+        struct stat st;
+        if (::stat(path.c_str(), &st) != 0)
+        {
+            continue;
+        }
+        if (name == activeName)
+        {
+            // 正在写的文件只计入总大小
+            totalBytes += st.st_size;
+            continue;
+        }
+        if (options_.maxAge > 0 && now - st.st_mtime > options_.maxAge)
+        {
+            ::unlink(path.c_str());
+            continue;
+        }
+        totalBytes += st.st_size;
+        files.push_back(LogFileInfo{ path, st.st_size, st.st_mtime });
+    }
+
+    if (options_.maxTotalBytes > 0 && totalBytes > options_.maxTotalBytes)
+    {
+        // 文件名中带有时间，按名字排序即按时间排序
+        std::sort(files.begin(), files.end(), [](const LogFileInfo& a, const LogFileInfo& b) {
+            return a.path < b.path;
+        });
+        for (const LogFileInfo& file : files)
+        {
+            if (totalBytes <= options_.maxTotalBytes)
+            {
+                break;
+            }
+            if (::unlink(file.path.c_str()) == 0)
+            {
+                totalBytes -= file.size;
+            }
+        }
+    }
+}
+
+bool LogArchiver::compressFile(const std::string& src, const std::string& dst, int level)
+{
+    int fd = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || ::fstat(fd, &st) != 0)
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        return false;
+    }
+    // 先写临时文件，压缩完成后再改名，中途退出不会留下不完整的 .gz
+    std::string tmp = dst + ".tmp";
+    char mode[8];
+    snprintf(mode, sizeof(mode), "wb%d", std::min(std::max(level, 1), 9));
+    gzFile out = ::gzopen(tmp.c_str(), mode);
+    if (out == nullptr)
+    {
+        ::close(fd);
+        return false;
+    }
+    ::gzbuffer(out, 256 * 1024);
+
+    bool ok = true;
+    std::vector<char> buf(256 * 1024);
+    while (true)
+    {
+        ssize_t n = ::read(fd, buf.data(), buf.size());
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            ok = (n == 0);
+            break;
+        }
+        if (::gzwrite(out, buf.data(), static_cast<unsigned>(n)) != n)
+        {
+            ok = false;
+            break;
+        }
+    }
+    ::close(fd);
+    if (::gzclose(out) != Z_OK)
+    {
+        ok = false;
+    }
+
+    // 保留原文件的修改时间，按保留时间清理时不会因为压缩而重新计时
+    struct timespec times[2] = { st.st_atim, st.st_mtim };
+    ::utimensat(AT_FDCWD, tmp.c_str(), times, 0);
+
+    if (!ok || ::rename(tmp.c_str(), dst.c_str()) != 0)
+    {
+        fprintf(stderr, "LogArchiver: compress %s failed\n", src.c_str());
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,73 @@
+#ifndef LOG_ARCHIVER_H
+#define LOG_ARCHIVER_H
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * 已滚动日志文件的后台压缩和清理
+ *
+ * 独立的低优先级线程(nice 19，IO idle)，不会阻塞日志后端线程
+ * 每次日志滚动或每隔 scanInterval 秒扫描一遍 basename 对应的日志文件：
+ * 1. 除正在写的文件之外，未压缩的 .log 文件压缩为 .log.gz 后删除原文件
+ * 2. 超过 maxAge 的文件删除
+ * 3. 总大小超过 maxTotalBytes 时从最旧的文件开始删除
+ *
+ * 只处理 LogFile 生成的 basename.%Y%m%d-%H%M%S.log(.gz)，同目录下的其他文件不受影响
+ * 正在写的文件不会被压缩或删除；同一个 basename 只能有一个进程在写
+ */
+class LogArchiver : noncopyable
+{
+public:
+    struct Options
+    {
+        Options()
+            : compress(true),
+              compressionLevel(6),
+              maxTotalBytes(0),
+              maxAge(0),
+              scanInterval(60)
+        {
+        }
+
+        bool compress;          // 使用 gzip 压缩
+        int compressionLevel;   // 1~9
+        int64_t maxTotalBytes;  // 所有日志文件(含压缩后)的总大小上限，0表示不限制
+        time_t maxAge;          // 文件最长保留时间(秒)，0表示不限制
+        int scanInterval;       // 定期扫描的间隔(秒)
+    };
+
+    LogArchiver(const std::string& basename, const Options& options = Options());
+    ~LogArchiver();
+
+    void start();
+    void stop();
+
+    // LogFile 滚动到新文件时调用，唤醒后台线程处理刚写完的文件
+    void setActiveFile(const std::string& filename);
+
+    // 压缩 src 为 dst，成功后不删除 src
+    static bool compressFile(const std::string& src, const std::string& dst, int level);
+
+private:
+    void threadFunc();
+    void archiveOnce(const std::string& activeFile);
+
+    const Options options_;
+    std::string directory_;     // basename 所在目录
+    std::string prefix_;        // 日志文件名前缀 "basename."
+    Thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool running_;
+    bool pending_;              // 有新滚动的文件等待处理
+    std::string activeFile_;
+};
+
+#endif // LOG_ARCHIVER_H
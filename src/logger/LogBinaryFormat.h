@@ -0,0 +1,48 @@
+#ifndef LOG_BINARY_FORMAT_H
+#define LOG_BINARY_FORMAT_H
+
+#include <stdint.h>
+
+/**
+ * 二进制日志格式，由 Logger 写入、LogDecoder 离线还原为文本
+ * 所有整数按本机字节序存放，解码需要在同一字节序的机器上进行
+ *
+ * 每条记录以 [uint32 length][uint8 type] 开头，length 包含记录头在内
+ *
+ * 调用点描述 kSiteRecord，每个 LOG_* 调用点第一次以二进制模式输出时写一次，
+ * 并由 Logger::binarySiteTable 在每个新文件开头重写，同一个 siteId 可能出现多次，内容相同：
+ *   [uint32 siteId][uint8 level][uint32 line][uint16 len][file][uint16 len][func]
+ *
+ * 日志 kLogRecord：
+ *   [uint32 siteId][int64 microSecondsSinceEpoch] 之后是若干个参数 [uint8 tag][原始字节]
+ *   kString 参数为 [uint32 len][bytes]
+ *   siteId 为0表示没有静态调用点，前三个参数依次是 file、line、level
+ */
+namespace LogBinary
+{
+
+enum RecordType : uint8_t
+{
+    kSiteRecord = 1,
+    kLogRecord = 2,
+};
+
+enum ArgTag : uint8_t
+{
+    kInt32 = 1,
+    kUInt32,
+    kInt64,
+    kUInt64,
+    kDouble,
+    kChar,
+    kString,
+};
+
+// [length][type]
+const int kRecordHeaderSize = 4 + 1;
+// [length][type][siteId][time]
+const int kLogRecordHeaderSize = kRecordHeaderSize + 4 + 8;
+
+} // namespace LogBinary
+
+#endif // LOG_BINARY_FORMAT_H
@@ -1,23 +1,55 @@
 #include "LogFile.h"
+#include "Logging.h"
 
 LogFile::LogFile(const std::string& basename,
         off_t rollSize,
         int flushInterval,
-        int checkEveryN)
+        int checkEveryN,
+        const FileUtil::Options& options)
     : basename_(basename),
       rollSize_(rollSize),
       flushInterval_(flushInterval),
       checkEveryN_(checkEveryN),
+      options_(options),
       count_(0),
       mutex_(new std::mutex),
       startOfPeriod_(0),
       lastRoll_(0),
-      lastFlush_(0)
+      lastFlush_(0),
+      syncRunning_(false)
 {
     rollFile();
+    if (options_.syncInterval > 0)
+    {
+        syncRunning_ = true;
+        syncThread_.reset(new Thread(std::bind(&LogFile::syncThreadFunc, this), "LogSync"));
+        syncThread_->start();
+    }
+}
+
+LogFile::~LogFile()
+{
+    if (syncThread_)
+    {
+        {
+            std::lock_guard<std::mutex> lock(syncMutex_);
+            syncRunning_ = false;
+        }
+        syncCond_.notify_one();
+        syncThread_->join();
+    }
 }
 
-LogFile::~LogFile() = default;
+void LogFile::setFileHeader(const FileHeaderCallback& cb)
+{
+    std::lock_guard<std::mutex> lock(*mutex_);
+    fileHeader_ = cb;
+    if (fileHeader_ && file_->writtenBytes() == 0)
+    {
+        std::string header = fileHeader_();
+        file_->append(header.data(), header.size());
+    }
+}
 
 void LogFile::append(const char* data, int len)
 {
@@ -39,7 +71,12 @@ void LogFile::appendInLock(const char* data, int len)
         if (count_ >= checkEveryN_)
         {
             count_ = 0;
-            time_t now = ::time(NULL);
+            // 使用日志前端缓存的时间，不再调用 ::time
+            time_t now = Logger::recentSecond();
+            if (now == 0)
+            {
+                now = ::time(NULL);
+            }
             time_t thisPeriod = now / kRollPerSeconds_ * kRollPerSeconds_;
             if (thisPeriod != startOfPeriod_)
             {
@@ -76,12 +113,60 @@ bool LogFile::rollFile()
         lastFlush_ = now;
         startOfPeriod_ = start;
         // 让file_指向一个名为filename的文件，相当于新建了一个文件
-        file_.reset(new FileUtil(filename));
+        FilePtr file(new FileUtil(filename, options_, rollSize_));
+        if (fileHeader_)
+        {
+            std::string header = fileHeader_();
+            file->append(header.data(), header.size());
+        }
+        {
+            std::lock_guard<std::mutex> lock(syncMutex_);
+            if (file_ && syncRunning_)
+            {
+                // 旧文件由后台线程同步并关闭
+                file_->flush();
+                retiredFiles_.push_back(std::move(file_));
+                syncCond_.notify_one();
+            }
+            // 没有后台线程时旧文件在这里析构，写完剩余数据并关闭
+            file_ = std::move(file);
+        }
+        filename_ = filename;
+        if (rollCallback_)
+        {
+            rollCallback_(filename_);
+        }
         return true;
     }
     return false;
 }
 
+void LogFile::syncThreadFunc()
+{
+    std::vector<FilePtr> files;
+    bool running = true;
+    while (running)
+    {
+        {
+            std::unique_lock<std::mutex> lock(syncMutex_);
+            syncCond_.wait_for(lock, std::chrono::seconds(options_.syncInterval), [this] {
+                return !retiredFiles_.empty() || !syncRunning_;
+            });
+            running = syncRunning_;
+            files.swap(retiredFiles_);
+            files.push_back(file_);
+        }
+
+        // 持有 shared_ptr，同步期间文件不会被关闭
+        for (const FilePtr& file : files)
+        {
+            file->sync();
+        }
+        // 旧文件在这里析构关闭
+        files.clear();
+    }
+}
+
 std::string LogFile::getLogFileName(const std::string& basename, time_t* now)
 {
     std::string filename;
@@ -99,4 +184,4 @@ std::string LogFile::getLogFileName(const std::string& basename, time_t* now)
     filename += ".log";
 
     return filename;
-}
\ No newline at end of file
+}
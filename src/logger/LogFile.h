@@ -2,9 +2,13 @@
 #define LOG_FILE_H
 
 #include "FileUtil.h"
+#include "Thread.h"
 
 #include <mutex>
 #include <memory>
+#include <vector>
+#include <condition_variable>
+#include <functional>
 
 class LogFile
 {
@@ -12,21 +16,37 @@ public:
     LogFile(const std::string& basename,
             off_t rollSize,
             int flushInterval = 3,
-            int checkEveryN = 1024);
+            int checkEveryN = 1024,
+            const FileUtil::Options& options = FileUtil::Options());
     ~LogFile();
 
     void append(const char* data, int len);
     void flush();
     bool rollFile(); // 滚动日志
 
+    // 滚动到新文件后回调，参数为新文件名，用于通知 LogArchiver
+    using RollCallback = std::function<void(const std::string& filename)>;
+    void setRollCallback(const RollCallback& cb) { rollCallback_ = cb; }
+    /**
+     * 每个新文件开头写入 cb 返回的内容，例如二进制日志的调用点描述表 Logger::binarySiteTable
+     * 当前文件还没有写入数据时立即写入
+     */
+    using FileHeaderCallback = std::function<std::string()>;
+    void setFileHeader(const FileHeaderCallback& cb);
+    const std::string& filename() const { return filename_; }
+
 private:
+    using FilePtr = std::shared_ptr<FileUtil>;
+
     static std::string getLogFileName(const std::string& basename, time_t* now);
     void appendInLock(const char* data, int len);
+    void syncThreadFunc();
 
     const std::string basename_;
     const off_t rollSize_;
     const int flushInterval_;
     const int checkEveryN_;
+    const FileUtil::Options options_;
 
     int count_;
 
@@ -34,9 +54,22 @@ private:
     time_t startOfPeriod_;
     time_t lastRoll_;
     time_t lastFlush_;
-    std::unique_ptr<FileUtil> file_;
+    FilePtr file_;
+    std::string filename_;
+    RollCallback rollCallback_;
+    FileHeaderCallback fileHeader_;
+
+    /**
+     * 后台同步线程定期 fdatasync 当前文件
+     * 滚动下来的旧文件交给它同步并关闭，写日志的线程不会因为刷盘而阻塞
+     */
+    std::unique_ptr<Thread> syncThread_;
+    std::mutex syncMutex_;                  // 保护 file_ 的替换、retiredFiles_ 和 syncRunning_
+    std::condition_variable syncCond_;
+    bool syncRunning_;
+    std::vector<FilePtr> retiredFiles_;
 
     const static int kRollPerSeconds_ = 60*60*24;
 };
 
-#endif // LOG_FILE_H
\ No newline at end of file
+#endif // LOG_FILE_H
@@ -0,0 +1,241 @@
+#include "LogKV.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+
+std::atomic<LogKV::Format> g_kvFormat(LogKV::kLogfmt);
+
+// 数字、true/false 等非字符串值的最大长度
+const size_t kMaxScalarSize = 48;
+
+const char kHexDigits[] = "0123456789abcdef";
+
+} // namespace
+
+void LogKV::setFormat(Format format)
+{
+    g_kvFormat.store(format, std::memory_order_relaxed);
+}
+
+LogKV::Format LogKV::format()
+{
+    return g_kvFormat.load(std::memory_order_relaxed);
+}
+
+/**
+ * 一次比较16个字节，绝大多数日志字段不含特殊字符，整段扫描完后一次 memcpy 写入
+ * 大于 0x7f 的字节(UTF-8)按无符号比较，不会被当成控制字符
+ * 不足16字节的尾部只要不跨页也整块读入，超出 len 的部分屏蔽掉
+ */
+size_t LogKV::findSpecial(const char* str, size_t len, char a, char b, unsigned char maxControl)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    const __m128i vmax = _mm_set1_epi8(static_cast<char>(maxControl));
+    auto specialMask = [&](const char* p) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        // min(c, max) == c 即 c <= max
+        __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(chunk, vmax), chunk);
+        __m128i special = _mm_or_si128(control,
+                                       _mm_or_si128(_mm_cmpeq_epi8(chunk, va), _mm_cmpeq_epi8(chunk, vb)));
+        return _mm_movemask_epi8(special);
+    };
+    for (; i + 16 <= len; i += 16)
+    {
+        int mask = specialMask(str + i);
+        if (mask != 0)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    if (i < len && (reinterpret_cast<uintptr_t>(str + i) & 4095) <= 4096 - 16)
+    {
+        int mask = specialMask(str + i) & ((1 << (len - i)) - 1);
+        return mask != 0 ? i + __builtin_ctz(mask) : len;
+    }
+#endif
+    for (; i < len; ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(str[i]);
+        if (c <= maxControl || str[i] == a || str[i] == b)
+        {
+            return i;
+        }
+    }
+    return len;
+}
+
+void LogKV::begin()
+{
+    if (format_ == kJson)
+    {
+        stream_.append("{", 1);
+    }
+}
+
+void LogKV::end()
+{
+    if (truncated_)
+    {
+        // 预留空间足够写入，不经过 hasRoom
+        stream_.append(format_ == kJson ? ",\"truncated\":true" : " truncated=true",
+                       format_ == kJson ? 17 : 15);
+    }
+    if (format_ == kJson)
+    {
+        stream_.append("}", 1);
+    }
+}
+
+void LogKV::addSource(const char* file, int fileLen, int line)
+{
+    // 文件名过长时截断，保证在预留空间内
+    fileLen = std::min(fileLen, 128);
+    if (format_ == kJson)
+    {
+        stream_.append(fields_ > 0 ? ",\"src\":\"" : "\"src\":\"", fields_ > 0 ? 8 : 7);
+        stream_.append(file, fileLen);
+        stream_ << ':' << line;
+        stream_.append("\"", 1);
+    }
+    else
+    {
+        stream_.append(fields_ > 0 ? " src=" : "src=", fields_ > 0 ? 5 : 4);
+        stream_.append(file, fileLen);
+        stream_ << ':' << line;
+    }
+    ++fields_;
+}
+
+// 写入分隔符和键，空间不足时返回 false，之后的字段全部丢弃
+bool LogKV::beginField(const char* key, size_t keyLen)
+{
+    if (truncated_ || !hasRoom(keyLen + kMaxScalarSize + 4))
+    {
+        truncated_ = true;
+        return false;
+    }
+    if (format_ == kJson)
+    {
+        stream_.append(fields_ > 0 ? ",\"" : "\"", fields_ > 0 ? 2 : 1);
+        appendEscaped(key, keyLen);
+        stream_.append("\":", 2);
+    }
+    else
+    {
+        if (fields_ > 0)
+        {
+            stream_.append(" ", 1);
+        }
+        stream_.append(key, static_cast<int>(keyLen));
+        stream_.append("=", 1);
+    }
+    ++fields_;
+    return true;
+}
+
+void LogKV::addUnescaped(const char* key, const char* value, size_t len, bool quoted)
+{
+    if (beginField(key, strlen(key)))
+    {
+        if (format_ == kJson || quoted)
+        {
+            stream_.append("\"", 1);
+            stream_.append(value, static_cast<int>(len));
+            stream_.append("\"", 1);
+        }
+        else
+        {
+            stream_.append(value, static_cast<int>(len));
+        }
+    }
+}
+
+void LogKV::appendString(const char* str, size_t len)
+{
+    if (format_ == kLogfmt && len > 0 && findSpecial(str, len, '"', '=', ' ') == len)
+    {
+        // 不需要引号，直接写入，放不下时截断
+        size_t room = static_cast<size_t>(stream_.buffer().avail()) - kReserved - 1;
+        if (len > room)
+        {
+            len = room;
+            truncated_ = true;
+        }
+        stream_.append(str, static_cast<int>(len));
+        return;
+    }
+    stream_.append("\"", 1);
+    appendEscaped(str, len);
+    stream_.append("\"", 1);
+}
+
+// 按 JSON 规则转义，调用前已经为引号留出了空间
+void LogKV::appendEscaped(const char* str, size_t len)
+{
+    const char* end = str + len;
+    while (str < end)
+    {
+        size_t run = findSpecial(str, end - str, '"', '\\', 0x1f);
+        if (run > 0)
+        {
+            size_t room = static_cast<size_t>(stream_.buffer().avail()) - kReserved - 2;
+            if (run > room)
+            {
+                stream_.append(str, static_cast<int>(room));
+                truncated_ = true;
+                return;
+            }
+            stream_.append(str, static_cast<int>(run));
+            str += run;
+            if (str == end)
+            {
+                return;
+            }
+        }
+
+        if (!hasRoom(8))
+        {
+            truncated_ = true;
+            return;
+        }
+        unsigned char c = static_cast<unsigned char>(*str++);
+        switch (c)
+        {
+            case '"': stream_.append("\\\"", 2); break;
+            case '\\': stream_.append("\\\\", 2); break;
+            case '\n': stream_.append("\\n", 2); break;
+            case '\r': stream_.append("\\r", 2); break;
+            case '\t': stream_.append("\\t", 2); break;
+            default:
+            {
+                char buf[6] = { '\\', 'u', '0', '0', kHexDigits[c >> 4], kHexDigits[c & 0xf] };
+                stream_.append(buf, 6);
+                break;
+            }
+        }
+    }
+}
+
+void LogKV::appendValue(double v)
+{
+    // JSON 不能表示 NaN 和无穷大
+    if (format_ == kJson && !std::isfinite(v))
+    {
+        appendRaw("null");
+        return;
+    }
+    stream_ << v;
+}
@@ -0,0 +1,122 @@
+#ifndef LOG_KV_H
+#define LOG_KV_H
+
+#include "LogStream.h"
+#include "noncopyable.h"
+
+#include <string.h>
+#include <string>
+#include <type_traits>
+
+/**
+ * 结构化日志编码器，把键值对直接编码进 LogStream 的 FixedBuffer，不分配内存
+ *
+ * JSON:   {"time":"2022/12/01 01:51:48.123456","level":"INFO","event":"accept","fd":12,"src":"Acceptor.cc:60"}
+ * logfmt: time="2022/12/01 01:51:48.123456" level=INFO event=accept fd=12 src=Acceptor.cc:60
+ *
+ * 字符串值按 JSON 规则转义，logfmt 只在值含有空白、'='、'"' 或控制字符时才加引号
+ * 缓冲区末尾为结尾字段预留了空间，放不下的字段被丢弃并加上 truncated 标记，输出总是完整的一行
+ */
+class LogKV : noncopyable
+{
+public:
+    enum Format
+    {
+        kLogfmt,
+        kJson,
+    };
+
+    // 全局的结构化日志格式，默认 logfmt
+    static void setFormat(Format format);
+    static Format format();
+
+    LogKV(LogStream& stream, Format format)
+        : stream_(stream),
+          format_(format),
+          fields_(0),
+          truncated_(false)
+    {
+    }
+
+    // JSON 写入 '{'
+    void begin();
+    // 写入 truncated 标记，JSON 写入 '}'，不含换行
+    void end();
+
+    template <typename T>
+    void add(const char* key, const T& value)
+    {
+        if (beginField(key, strlen(key)))
+        {
+            appendValue(value);
+        }
+    }
+
+    void addString(const char* key, const char* value, size_t len)
+    {
+        if (beginField(key, strlen(key)))
+        {
+            appendString(value, len);
+        }
+    }
+
+    /**
+     * 调用方保证 value 不含需要转义的字符，长度不超过48字节，直接写入
+     * quoted 表示 logfmt 下需要加引号(含有空格)，JSON 总是加引号
+     */
+    void addUnescaped(const char* key, const char* value, size_t len, bool quoted);
+
+    // "src":"file:line"，使用预留空间，总能写入
+    void addSource(const char* file, int fileLen, int line);
+
+    bool truncated() const { return truncated_; }
+
+    // 查找第一个需要特殊处理的字节，找不到返回 len
+    // 小于等于 maxControl 的字节以及 a、b 两个字符算作特殊字节
+    static size_t findSpecial(const char* str, size_t len, char a, char b, unsigned char maxControl);
+
+private:
+    // 为 end() 和 addSource() 预留的空间
+    static const int kReserved = 192;
+
+    bool hasRoom(size_t len)
+    {
+        return static_cast<size_t>(stream_.buffer().avail()) > len + kReserved;
+    }
+
+    bool beginField(const char* key, size_t keyLen);
+    void appendString(const char* str, size_t len);
+    void appendEscaped(const char* str, size_t len);
+
+    void appendValue(const char* str)
+    {
+        if (str)
+        {
+            appendString(str, strlen(str));
+        }
+        else
+        {
+            appendRaw(format_ == kJson ? "null" : "\"\"");
+        }
+    }
+    void appendValue(const std::string& str) { appendString(str.data(), str.size()); }
+    void appendValue(char c) { appendString(&c, 1); }
+    void appendValue(bool b) { appendRaw(b ? "true" : "false"); }
+    void appendValue(double v);
+    void appendValue(float v) { appendValue(static_cast<double>(v)); }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value>::type appendValue(T v)
+    {
+        stream_ << v;
+    }
+
+    void appendRaw(const char* str) { stream_.append(str, static_cast<int>(strlen(str))); }
+
+    LogStream& stream_;
+    const Format format_;
+    int fields_;
+    bool truncated_;
+};
+
+#endif // LOG_KV_H
@@ -0,0 +1,190 @@
+#ifndef LOG_STAGING_RING_H
+#define LOG_STAGING_RING_H
+
+#include "noncopyable.h"
+#include "HugePageAllocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string.h>
+#include <stdint.h>
+
+/**
+ * 单生产者单消费者的日志暂存环形缓冲区
+ *
+ * 每个写日志的前端线程独占一个，后端日志线程是唯一的消费者
+ * head_ 只由生产者写，tail_ 只由消费者写，正常写入和收集都不需要加锁
+ * head_/tail_ 单调递增，对容量取模得到实际位置，因此容量必须是2的幂
+ *
+ * 每条日志存为 [uint32 len][bytes]，生产者写完一整条后才发布 head_
+ *
+ * 为了支持丢弃最旧的日志，消费者收集前先在 claimMutex_ 下把 [tail_, head_) 认领下来(claim_)，
+ * 生产者只能在同一把锁下丢弃还没被认领的 [claim_, head_)，两者只在这两个慢路径上竞争
+ */
+class LogStagingRing : noncopyable
+{
+public:
+    explicit LogStagingRing(size_t capacity)
+        : capacity_(roundUpPowerOfTwo(capacity)),
+          data_(allocator_.allocate(capacity_)),
+          head_(0),
+          recordsWritten_(0),
+          tail_(0),
+          claim_(0),
+          recordsClaimed_(0),
+          abandoned_(false)
+    {
+    }
+
+    ~LogStagingRing()
+    {
+        allocator_.deallocate(data_, capacity_);
+    }
+
+    size_t capacity() const { return capacity_; }
+
+    // 一条日志占用的空间
+    static size_t recordSize(size_t len) { return len + kHeaderSize; }
+
+    // 生产者调用，空间不足返回false，不会写入部分数据
+    bool tryAppend(const char* data, size_t len, size_t* usedAfter)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        if (capacity_ - (head - tail) < recordSize(len))
+        {
+            return false;
+        }
+        uint32_t length = static_cast<uint32_t>(len);
+        copyIn(head, reinterpret_cast<const char*>(&length), kHeaderSize);
+        copyIn(head + kHeaderSize, data, len);
+        ++recordsWritten_;
+        head_.store(head + recordSize(len), std::memory_order_release);
+        *usedAfter = head + recordSize(len) - tail;
+        return true;
+    }
+
+    /**
+     * 生产者调用，丢弃后端还没有认领的所有日志，返回丢弃的条数，droppedBytes 不含记录头
+     * 被丢弃的是排队中最旧的日志，正在被后端写入的部分不受影响
+     */
+    size_t dropUnclaimed(size_t* droppedBytes)
+    {
+        std::lock_guard<std::mutex> lock(claimMutex_);
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t dropped = recordsWritten_ - recordsClaimed_;
+        *droppedBytes = head - claim_ - dropped * kHeaderSize;
+        recordsWritten_ = recordsClaimed_;
+        head_.store(claim_, std::memory_order_release);
+        return dropped;
+    }
+
+    /**
+     * 消费者调用，把当前已发布的日志逐条交给 output(const char*, size_t)
+     * 日志跨越缓冲区末尾时分两段交出，返回本次收集的条数
+     */
+    template <typename Output>
+    size_t drain(Output&& output)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t end;
+        size_t records = 0;
+        {
+            // claim_ 和 recordsClaimed_ 必须一起更新，否则 dropUnclaimed 在收集过程中会多算条数
+            // 这里只读记录头，逐条交出在锁外进行
+            std::lock_guard<std::mutex> lock(claimMutex_);
+            end = head_.load(std::memory_order_acquire);
+            if (end == tail)
+            {
+                return 0;
+            }
+            claim_ = end;
+            for (size_t pos = tail; pos != end; ++records)
+            {
+                uint32_t length;
+                copyOut(pos, reinterpret_cast<char*>(&length), kHeaderSize);
+                pos += recordSize(length);
+            }
+            recordsClaimed_ += records;
+        }
+
+        while (tail != end)
+        {
+            uint32_t length;
+            copyOut(tail, reinterpret_cast<char*>(&length), kHeaderSize);
+            size_t offset = (tail + kHeaderSize) & (capacity_ - 1);
+            size_t first = std::min<size_t>(length, capacity_ - offset);
+            output(data_ + offset, first);
+            if (length > first)
+            {
+                output(data_, length - first);
+            }
+            tail += recordSize(length);
+        }
+
+        tail_.store(end, std::memory_order_release);
+        return records;
+    }
+
+    // 排队中的字节数(含记录头)
+    size_t usedBytes() const
+    {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return usedBytes() == 0; }
+
+    // 生产者线程退出时标记，后端把剩余数据写完后回收
+    void abandon() { abandoned_.store(true, std::memory_order_release); }
+    bool abandoned() const { return abandoned_.load(std::memory_order_acquire); }
+
+private:
+    static const size_t kHeaderSize = sizeof(uint32_t);
+
+    static size_t roundUpPowerOfTwo(size_t n)
+    {
+        size_t size = 4096;
+        while (size < n)
+        {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    void copyIn(size_t pos, const char* data, size_t len)
+    {
+        size_t offset = pos & (capacity_ - 1);
+        size_t first = std::min(len, capacity_ - offset);
+        memcpy(data_ + offset, data, first);
+        memcpy(data_, data + first, len - first);
+    }
+
+    void copyOut(size_t pos, char* data, size_t len) const
+    {
+        size_t offset = pos & (capacity_ - 1);
+        size_t first = std::min(len, capacity_ - offset);
+        memcpy(data, data_ + offset, first);
+        memcpy(data + first, data_, len - first);
+    }
+
+    const size_t capacity_;
+    HugePageStlAllocator<char, MemoryStats::kAsyncLogging> allocator_;  // 创建时开启了 HugePageAllocator 则使用大页
+    char* data_;
+
+    // 生产者和消费者各自频繁写的变量放在不同的缓存行避免伪共享
+    char pad0_[64];
+    std::atomic<size_t> head_;
+    size_t recordsWritten_;         // 生产者写入的条数，丢弃时回退
+    char pad1_[64 - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+    std::atomic<size_t> tail_;
+    char pad2_[64 - sizeof(std::atomic<size_t>)];
+
+    std::mutex claimMutex_;
+    size_t claim_;                  // 消费者认领到的位置
+    size_t recordsClaimed_;         // 消费者已经收集的条数
+    std::atomic<bool> abandoned_;
+};
+
+#endif // LOG_STAGING_RING_H
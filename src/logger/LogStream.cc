@@ -1,33 +1,76 @@
 #include "LogStream.h"
+#include "LogBinaryFormat.h"
+
 #include <algorithm>
+#include <type_traits>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+// 00~99 两位一组的查表数字，一次除法得到两位
+static const char kDigitsLut[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
 
-static const char digits[] = {'9', '8', '7', '6', '5', '4', '3', '2', '1', '0',
-                               '1', '2', '3', '4', '5', '6', '7', '8', '9'};
+// 从 end 向前写入 value 的十进制表示，返回起始位置
+template <typename T>
+static char* convertReverse(char* end, T value)
+{
+    char* p = end;
+    while (value >= 100)
+    {
+        const char* d = kDigitsLut + (value % 100) * 2;
+        value /= 100;
+        *--p = d[1];
+        *--p = d[0];
+    }
+    if (value < 10)
+    {
+        *--p = static_cast<char>('0' + value);
+    }
+    else
+    {
+        const char* d = kDigitsLut + value * 2;
+        *--p = d[1];
+        *--p = d[0];
+    }
+    return p;
+}
 
 template <typename T>
 void LogStream::formatInteger(T num)
 {
+    if (binary_)
+    {
+        static_assert(sizeof(T) == 4 || sizeof(T) == 8, "unexpected integer size");
+        const uint8_t tag = sizeof(T) == 4
+            ? (std::is_signed<T>::value ? LogBinary::kInt32 : LogBinary::kUInt32)
+            : (std::is_signed<T>::value ? LogBinary::kInt64 : LogBinary::kUInt64);
+        appendBinary(tag, num);
+        return;
+    }
     if (buffer_.avail() >= kMaxNumericSize)
     {
-        char* start = buffer_.current();
-        char* cur = start;
-        const char* zero = digits + 9;
-        bool negative = (num < 0); // 是否为负数
-
-        // 末尾取值加入，最后反转
-        do {
-            int remainder = static_cast<int>(num % 10);
-            *(cur++) = zero[remainder];
-            num = num / 10;
-        } while (num != 0);
-
-        if (negative) {
-            *(cur++) = '-';
+        using UnsignedT = typename std::make_unsigned<T>::type;
+        // 先在栈上从后向前写，再整体拷贝，避免再做一次反转
+        char tmp[kMaxNumericSize];
+        char* end = tmp + sizeof(tmp);
+        char* start;
+        if (num < 0)
+        {
+            // 取反在无符号类型上进行，最小负数也不会溢出
+            start = convertReverse(end, static_cast<UnsignedT>(UnsignedT(0) - static_cast<UnsignedT>(num)));
+            *--start = '-';
         }
-        *cur = '\0';
-
-        std::reverse(start, cur);
-        buffer_.add(static_cast<int>(cur - start)); // cur_向后移动
+        else
+        {
+            start = convertReverse(end, static_cast<UnsignedT>(num));
+        }
+        buffer_.append(start, end - start);
     }
 }
 
@@ -85,19 +128,104 @@ LogStream& LogStream::operator<<(float v)
     return *this;
 }
 
-LogStream& LogStream::operator<<(double v) 
+static const double kPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8,
+    1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+};
+
+static const uint64_t kPow10Integer[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+    1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+    10000000000000ULL, 100000000000000ULL, 1000000000000000ULL,
+};
+
+/**
+ * 输出能精确还原 v 的最短表示
+ *
+ * 整数值直接走整数格式化
+ * 小数依次尝试保留 k 位小数：r = round(v * 10^k)，r 和 10^k 都能被 double 精确表示时
+ * r / 10^k 的浮点除法结果与 strtod 解析 "r e-k" 相同，相等即可还原，第一个成功的 k 就是最短的
+ * 其余情况(很大、很小或需要16~17位有效数字)依次尝试15、16、17位有效数字，17位总能还原
+ * 非规格化数精度不足15位，这种情况输出能还原但不一定最短
+ */
+LogStream& LogStream::operator<<(double v)
 {
+    if (binary_)
+    {
+        appendBinary(LogBinary::kDouble, v);
+        return *this;
+    }
     if (buffer_.avail() >= kMaxNumericSize)
     {
-        char buf[32];
-        int len = snprintf(buffer_.current(), kMaxNumericSize, "%.12g", v); 
+        if (v >= -kMaxExactInteger && v <= kMaxExactInteger && v == static_cast<double>(static_cast<long long>(v)))
+        {
+            // -0.0 也走这里，输出 0
+            formatInteger(static_cast<long long>(v));
+            return *this;
+        }
+
+        double absolute = std::fabs(v);
+        if (absolute >= 1e-4 && absolute < 1e15)
+        {
+            for (int k = 1; k < static_cast<int>(sizeof(kPow10) / sizeof(kPow10[0])); ++k)
+            {
+                double scaled = std::round(absolute * kPow10[k]);
+                if (scaled > kMaxExactInteger)
+                {
+                    break;
+                }
+                if (scaled / kPow10[k] == absolute)
+                {
+                    formatFixed(v < 0, static_cast<uint64_t>(scaled), k);
+                    return *this;
+                }
+            }
+        }
+
+        char* buf = buffer_.current();
+        int len = snprintf(buf, kMaxNumericSize, "%.15g", v);
+        if (std::isfinite(v) && strtod(buf, nullptr) != v)
+        {
+            len = snprintf(buf, kMaxNumericSize, "%.16g", v);
+            if (strtod(buf, nullptr) != v)
+            {
+                len = snprintf(buf, kMaxNumericSize, "%.17g", v);
+            }
+        }
         buffer_.add(len);
-        return *this;
     }
+    return *this;
+}
+
+// 输出 scaled / 10^decimals，小数部分补足 decimals 位
+void LogStream::formatFixed(bool negative, uint64_t scaled, int decimals)
+{
+    char tmp[kMaxNumericSize];
+    char* end = tmp + sizeof(tmp);
+    uint64_t integer = scaled / kPow10Integer[decimals];
+    uint64_t fraction = scaled % kPow10Integer[decimals];
+
+    char* start = convertReverse(end, fraction);
+    while (end - start < decimals)
+    {
+        *--start = '0';
+    }
+    *--start = '.';
+    start = convertReverse(start, integer);
+    if (negative)
+    {
+        *--start = '-';
+    }
+    buffer_.append(start, end - start);
 }
 
 LogStream& LogStream::operator<<(char c)
 {
+    if (binary_)
+    {
+        appendBinary(LogBinary::kChar, c);
+        return *this;
+    }
     buffer_.append(&c, 1);
     return *this;
 }
@@ -112,11 +240,11 @@ LogStream& LogStream::operator<<(const char* str)
 {
     if (str)
     {
-        buffer_.append(str, strlen(str));
+        appendString(str, strlen(str));
     }
     else 
     {
-        buffer_.append("(null)", 6);
+        appendString("(null)", 6);
     }
     return *this;
 }
@@ -128,7 +256,7 @@ LogStream& LogStream::operator<<(const unsigned char* str)
 
 LogStream& LogStream::operator<<(const std::string& str)
 {
-    buffer_.append(str.c_str(), str.size());
+    appendString(str.c_str(), str.size());
     return *this;
 }
 
@@ -140,6 +268,52 @@ LogStream& LogStream::operator<<(const Buffer& buf)
 
 LogStream& LogStream::operator<<(const GeneralTemplate& g)
 {
-    buffer_.append(g.data_, g.len_);
+    appendString(g.data_, g.len_);
     return *this;
-}
\ No newline at end of file
+}
+void LogStream::beginBinaryRecord(uint32_t siteId, int64_t microSecondsSinceEpoch)
+{
+    binary_ = true;
+    buffer_.reset();
+    char header[LogBinary::kLogRecordHeaderSize];
+    // 长度在 finishBinaryRecord 中回填
+    memset(header, 0, 4);
+    header[4] = static_cast<char>(LogBinary::kLogRecord);
+    memcpy(header + 5, &siteId, sizeof(siteId));
+    memcpy(header + 9, &microSecondsSinceEpoch, sizeof(microSecondsSinceEpoch));
+    buffer_.append(header, sizeof(header));
+}
+
+void LogStream::finishBinaryRecord()
+{
+    uint32_t length = static_cast<uint32_t>(buffer_.length());
+    memcpy(buffer_.current() - length, &length, sizeof(length));
+}
+
+// 标签和数据一次写入，缓冲区不够时整个参数丢弃，不会留下半个参数
+template <typename T>
+void LogStream::appendBinary(uint8_t tag, T value)
+{
+    char data[1 + sizeof(T)];
+    data[0] = static_cast<char>(tag);
+    memcpy(data + 1, &value, sizeof(T));
+    buffer_.append(data, sizeof(data));
+}
+
+// 字符串过长时截断到缓冲区剩余空间
+void LogStream::appendBinaryString(const char* str, size_t len)
+{
+    const size_t kHeaderSize = 1 + sizeof(uint32_t);
+    size_t avail = static_cast<size_t>(buffer_.avail());
+    if (avail <= kHeaderSize + 1)
+    {
+        return;
+    }
+    len = std::min(len, avail - kHeaderSize - 1);
+    char header[kHeaderSize];
+    header[0] = static_cast<char>(LogBinary::kString);
+    uint32_t length = static_cast<uint32_t>(len);
+    memcpy(header + 1, &length, sizeof(length));
+    buffer_.append(header, kHeaderSize);
+    buffer_.append(str, len);
+}
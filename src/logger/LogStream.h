@@ -5,6 +5,7 @@
 #include "noncopyable.h"
 
 #include <string>
+#include <stdint.h>
 
 /**
  *  比如SourceFile类和时间类就会用到
@@ -32,11 +33,25 @@ class LogStream : noncopyable
 {
 public:
     using Buffer = FixedBuffer<kSmallBuffer>;
+
+    LogStream()
+        : binary_(false)
+    {
+    }
     
     void append(const char* data, int len) { buffer_.append(data, len); }
     const Buffer& buffer() const { return buffer_; }
     void resetBuffer() { buffer_.reset(); }
 
+    /**
+     * 二进制模式，格式见 LogBinaryFormat.h
+     * 之后的 operator<< 只写入类型标签和参数的原始字节，文本化留给 LogDecoder 离线完成
+     */
+    void beginBinaryRecord(uint32_t siteId, int64_t microSecondsSinceEpoch);
+    // 回填记录长度
+    void finishBinaryRecord();
+    bool binary() const { return binary_; }
+
     /**
      * 我们的LogStream需要重载运算符
      */
@@ -64,12 +79,31 @@ public:
 
 private:
     static const int kMaxNumericSize = 48;
+    // 2^53，绝对值不超过它的整数都能被 double 精确表示
+    static constexpr double kMaxExactInteger = 9007199254740992.0;
 
     // 对于整型需要特殊处理
     template <typename T>
     void formatInteger(T);
+    void formatFixed(bool negative, uint64_t scaled, int decimals);
+
+    template <typename T>
+    void appendBinary(uint8_t tag, T value);
+    void appendBinaryString(const char* str, size_t len);
+    void appendString(const char* str, size_t len)
+    {
+        if (binary_)
+        {
+            appendBinaryString(str, len);
+        }
+        else
+        {
+            buffer_.append(str, len);
+        }
+    }
 
     Buffer buffer_;
+    bool binary_;
 };
 
 #endif // LOG_STREAM_H
\ No newline at end of file
@@ -1,13 +1,42 @@
 #include "Logging.h"
 #include "CurrentThread.h"
+#include "LogBinaryFormat.h"
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <stdint.h>
 
 namespace ThreadInfo
 {
     __thread char t_errnobuf[512];
     __thread char t_time[64];
     __thread time_t t_lastSecond;
+    __thread time_t t_lastPublishedSecond;
 };
 
+// 所有线程中最新的日志时间
+static std::atomic<time_t> g_recentSecond(0);
+
+// 二进制模式下结构化日志先编码到这里，再作为一个字符串参数写入记录
+static thread_local LogStream t_kvStream;
+
+// 所有调用点描述记录，用函数内静态变量避免初始化顺序问题
+static std::mutex& siteTableMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::string& siteTable()
+{
+    static std::string table;
+    return table;
+}
+
+// "2022/12/01 01:51:48." 的长度
+static const int kTimePrefixDateLength = 20;
+
 const char* getErrnoMsg(int savedErrno)
 {
     return strerror_r(savedErrno, ThreadInfo::t_errnobuf, sizeof(ThreadInfo::t_errnobuf));
@@ -43,18 +72,30 @@ static void defaultFlush()
 
 Logger::OutputFunc g_output = defaultOutput;
 Logger::FlushFunc g_flush = defaultFlush;
+bool g_binaryMode = false;
 
 Logger::Impl::Impl(Logger::LogLevel level, int savedErrno, const char* file, int line)
     : time_(Timestamp::now()),
       stream_(),
       level_(level),
       line_(line),
-      basename_(file)
+      basename_(file),
+      structured_(false)
 {
-    // 输出流 -> time
-    formatTime();
-    // 写入日志等级
-    stream_ << GeneralTemplate(getLevelName[level], 6);
+    updateRecentSecond();
+    if (g_binaryMode)
+    {
+        // 没有静态调用点，文件名、行号和等级作为前三个参数写入
+        stream_.beginBinaryRecord(0, time_.microSecondsSinceEpoch());
+        stream_ << GeneralTemplate(basename_.data_, basename_.size_) << line_ << static_cast<int>(level);
+    }
+    else
+    {
+        // 输出流 -> time
+        formatTime();
+        // 写入日志等级
+        stream_ << GeneralTemplate(getLevelName[level], 6);
+    }
     // TODO:error
     if (savedErrno != 0)
     {
@@ -62,35 +103,137 @@ Logger::Impl::Impl(Logger::LogLevel level, int savedErrno, const char* file, int
     }
 }
 
-// Timestamp::toString方法的思路，只不过这里需要输出到流
+/**
+ * 时间前缀 "2022/12/01 01:51:48.123456 " 按线程缓存
+ * 同一分钟内只改写秒和微秒，跨分钟时才调用 localtime_r 重建日期和时分
+ */
+static void fillTimeCache(int64_t microSecondsSinceEpoch)
+{
+    time_t seconds = static_cast<time_t>(microSecondsSinceEpoch / Timestamp::kMicroSecondsPerSecond);
+    int microseconds = static_cast<int>(microSecondsSinceEpoch % Timestamp::kMicroSecondsPerSecond);
+
+    if (seconds != ThreadInfo::t_lastSecond)
+    {
+        if (seconds / 60 != ThreadInfo::t_lastSecond / 60 || ThreadInfo::t_lastSecond == 0)
+        {
+            struct tm tm_time;
+            ::localtime_r(&seconds, &tm_time);
+            snprintf(ThreadInfo::t_time, sizeof(ThreadInfo::t_time), "%4d/%02d/%02d %02d:%02d:%02d.",
+                tm_time.tm_year + 1900,
+                tm_time.tm_mon + 1,
+                tm_time.tm_mday,
+                tm_time.tm_hour,
+                tm_time.tm_min,
+                tm_time.tm_sec);
+        }
+        else
+        {
+            // 时区偏移都是整分钟，同一分钟内秒数可以直接由时间戳得到
+            int sec = static_cast<int>(seconds % 60);
+            ThreadInfo::t_time[17] = static_cast<char>('0' + sec / 10);
+            ThreadInfo::t_time[18] = static_cast<char>('0' + sec % 10);
+        }
+        ThreadInfo::t_lastSecond = seconds;
+    }
+
+    // 日期时间共20字节(含'.')，后接6位微秒和一个空格
+    char* buf = ThreadInfo::t_time + kTimePrefixDateLength;
+    for (int i = 5; i >= 0; --i)
+    {
+        buf[i] = static_cast<char>('0' + microseconds % 10);
+        microseconds /= 10;
+    }
+    buf[6] = ' ';
+}
+
 void Logger::Impl::formatTime()
 {
-    Timestamp now = Timestamp::now();
-    time_t seconds = static_cast<time_t>(now.microSecondsSinceEpoch() / Timestamp::kMicroSecondsPerSecond);
-    int microseconds = static_cast<int>(now.microSecondsSinceEpoch() % Timestamp::kMicroSecondsPerSecond);
+    fillTimeCache(time_.microSecondsSinceEpoch());
+    stream_ << GeneralTemplate(ThreadInfo::t_time, kTimePrefixDateLength + 7);
+}
+
+Logger::Impl::Impl(LogSite& site, bool structured)
+    : time_(Timestamp::now()),
+      stream_(),
+      level_(site.level()),
+      line_(site.line()),
+      basename_(site.basename()),
+      structured_(structured)
+{
+    updateRecentSecond();
+    if (g_binaryMode)
+    {
+        stream_.beginBinaryRecord(site.id(), time_.microSecondsSinceEpoch());
+    }
+    else if (!structured_)
+    {
+        formatTime();
+        stream_ << GeneralTemplate(getLevelName[level_], 6);
+    }
+}
+
+LogStream& Logger::Impl::kvStream()
+{
+    if (stream_.binary())
+    {
+        t_kvStream.resetBuffer();
+        return t_kvStream;
+    }
+    return stream_;
+}
 
-    struct tm *tm_time = localtime(&seconds);
-    // 写入此线程存储的时间buf中
-    snprintf(ThreadInfo::t_time, sizeof(ThreadInfo::t_time), "%4d/%02d/%02d %02d:%02d:%02d",
-        tm_time->tm_year + 1900,
-        tm_time->tm_mon + 1,
-        tm_time->tm_mday,
-        tm_time->tm_hour,
-        tm_time->tm_min,
-        tm_time->tm_sec);
-    // 更新最后一次时间调用
-    ThreadInfo::t_lastSecond = seconds;
+void Logger::Impl::beginKV(LogKV& encoder, const char* event)
+{
+    encoder.begin();
+    if (!stream_.binary())
+    {
+        fillTimeCache(time_.microSecondsSinceEpoch());
+        encoder.addUnescaped("time", ThreadInfo::t_time, kTimePrefixDateLength + 6, true);
+        // 等级名去掉对齐用的空格
+        const char* level = getLevelName[level_];
+        encoder.addUnescaped("level", level, strcspn(level, " "), false);
+    }
+    encoder.add("event", event);
+}
 
-    // muduo使用Fmt格式化整数，这里我们直接写入buf
-    char buf[32] = {0};
-    snprintf(buf, sizeof(buf), "%06d ", microseconds);
+void Logger::Impl::finishKV(LogKV& encoder)
+{
+    if (stream_.binary())
+    {
+        encoder.end();
+        stream_ << GeneralTemplate(t_kvStream.buffer().data(), t_kvStream.buffer().length());
+        return;
+    }
+    encoder.addSource(basename_.data_, basename_.size_, line_);
+    encoder.end();
+}
 
-    // 输出时间，附有微妙(之前是(buf, 6),少了一个空格)
-    stream_ << GeneralTemplate(ThreadInfo::t_time, 17) << GeneralTemplate(buf, 7);
+void Logger::Impl::updateRecentSecond()
+{
+    time_t seconds = static_cast<time_t>(time_.microSecondsSinceEpoch() / Timestamp::kMicroSecondsPerSecond);
+    if (seconds != ThreadInfo::t_lastPublishedSecond)
+    {
+        ThreadInfo::t_lastPublishedSecond = seconds;
+        time_t recent = g_recentSecond.load(std::memory_order_relaxed);
+        while (recent < seconds &&
+               !g_recentSecond.compare_exchange_weak(recent, seconds, std::memory_order_relaxed))
+        {
+        }
+    }
 }
 
 void Logger::Impl::finish()
 {
+    if (stream_.binary())
+    {
+        stream_.finishBinaryRecord();
+        return;
+    }
+    if (structured_)
+    {
+        stream_ << '\n';
+        return;
+    }
     stream_ << " - " << GeneralTemplate(basename_.data_, basename_.size_) 
             << ':' << line_ << '\n';
 }
@@ -113,6 +256,20 @@ Logger::Logger(const char* file, int line, Logger::LogLevel level, const char* f
     impl_.stream_ << func << ' ';
 }
 
+Logger::Logger(LogSite& site)
+    : impl_(site, false)
+{
+    // 二进制模式下函数名保存在调用点描述中
+    if (site.func() && !impl_.stream_.binary())
+    {
+        impl_.stream_ << site.func() << ' ';
+    }
+}
+
+Logger::Logger(LogSite& site, StructuredTag)
+    : impl_(site, true)
+{
+}
 
 Logger::~Logger()
 {
@@ -143,3 +300,81 @@ void Logger::setFlush(FlushFunc flush)
 {
     g_flush = flush;
 }
+
+void Logger::setBinaryMode(bool on)
+{
+    g_binaryMode = on;
+}
+
+bool Logger::binaryMode()
+{
+    return g_binaryMode;
+}
+
+std::string Logger::binarySiteTable()
+{
+    std::lock_guard<std::mutex> lock(siteTableMutex());
+    return siteTable();
+}
+
+time_t Logger::recentSecond()
+{
+    return g_recentSecond.load(std::memory_order_relaxed);
+}
+
+// 分配id并输出调用点描述记录，多个线程同时注册时只有一个成功并输出
+uint32_t LogSite::registerSite()
+{
+    static std::atomic<uint32_t> nextId(1);
+    uint32_t id = nextId++;
+    uint32_t expected = 0;
+    if (!id_.compare_exchange_strong(expected, id, std::memory_order_acq_rel))
+    {
+        return expected;
+    }
+
+    const char* func = func_ ? func_ : "";
+    uint16_t fileLen = static_cast<uint16_t>(std::min<size_t>(basename_.size_, UINT16_MAX));
+    uint16_t funcLen = static_cast<uint16_t>(std::min<size_t>(strlen(func), UINT16_MAX));
+    uint32_t line = static_cast<uint32_t>(line_);
+    uint8_t level = static_cast<uint8_t>(level_);
+
+    std::string record;
+    record.resize(LogBinary::kRecordHeaderSize);
+    record[4] = static_cast<char>(LogBinary::kSiteRecord);
+    record.append(reinterpret_cast<const char*>(&id), sizeof(id));
+    record.append(reinterpret_cast<const char*>(&level), sizeof(level));
+    record.append(reinterpret_cast<const char*>(&line), sizeof(line));
+    record.append(reinterpret_cast<const char*>(&fileLen), sizeof(fileLen));
+    record.append(basename_.data_, fileLen);
+    record.append(reinterpret_cast<const char*>(&funcLen), sizeof(funcLen));
+    record.append(func, funcLen);
+    uint32_t length = static_cast<uint32_t>(record.size());
+    memcpy(&record[0], &length, sizeof(length));
+
+    // 先加入描述表再输出，之后滚动出的文件开头都会带上这条描述
+    {
+        std::lock_guard<std::mutex> lock(siteTableMutex());
+        siteTable().append(record);
+    }
+    g_output(record.data(), static_cast<int>(record.size()));
+    return id;
+}
+
+LogLimiter::LogLimiter(const char* file, int line, Logger::LogLevel level, const char* func)
+    : site_(file, line, level, func),
+      suppressed_(0),
+      lastReport_(::time(NULL))
+{
+}
+
+// 多个线程同时报告时只有拿到非零计数的那个输出
+void LogLimiter::reportSuppressed()
+{
+    lastReport_.store(::time(NULL), std::memory_order_relaxed);
+    uint64_t suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+    if (suppressed != 0)
+    {
+        Logger(site_).stream() << "suppressed " << suppressed << " messages";
+    }
+}
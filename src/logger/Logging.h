@@ -3,12 +3,16 @@
 
 #include "Timestamp.h"
 #include "LogStream.h"
+#include "LogKV.h"
 
 #include <stdio.h>
 #include <sys/time.h>
+#include <time.h>
 #include <errno.h>
 #include <string.h>
 #include <functional>
+#include <atomic>
+#include <stdint.h>
 
 // SourceFile的作用是提取文件名
 class SourceFile
@@ -33,6 +37,8 @@ public:
     int size_;
 };
 
+class LogSite;
+
 class Logger
 {
 public:
@@ -51,7 +57,25 @@ public:
     Logger(const char* file, int line);
     Logger(const char* file, int line, LogLevel level);
     Logger(const char* file, int line, LogLevel level, const char* func);
-    ~Logger();
+    // LOG_* 宏使用，每个调用点一个静态的 LogSite
+    explicit Logger(LogSite& site) __attribute__((cold));
+    // LOG_*_KV 使用，不写文本前缀，整行由 kv() 编码
+    struct StructuredTag {};
+    Logger(LogSite& site, StructuredTag) __attribute__((cold));
+    ~Logger() __attribute__((cold));
+
+    /**
+     * 结构化日志，键值对依次写入，格式由 LogKV::setFormat 决定
+     * 二进制模式下 kv 部分编码为一个字符串参数，时间、等级和调用点由 LogDecoder 还原
+     */
+    template <typename... Args>
+    void kv(const char* event, const Args&... args)
+    {
+        LogKV encoder(impl_.kvStream(), LogKV::format());
+        impl_.beginKV(encoder, event);
+        addKV(encoder, args...);
+        impl_.finishKV(encoder);
+    }
 
     // 流是会改变的
     LogStream& stream() { return impl_.stream_; }
@@ -66,14 +90,40 @@ public:
     static void setOutput(OutputFunc);
     static void setFlush(FlushFunc);
 
+    /**
+     * 二进制模式下只记录调用点id、时间戳和参数的原始字节，用 LogDecoder 还原为文本
+     * 调用点描述只在第一次使用时输出一次，需要在设置好 output 之后、写日志之前开启
+     */
+    static void setBinaryMode(bool on);
+    static bool binaryMode();
+    // 已注册的所有调用点描述记录，写在每个日志文件开头(LogFile::setFileHeader)，滚动后的文件可以单独解码
+    static std::string binarySiteTable();
+
+    // 最近一条日志的时间(秒)，各线程只在秒数变化时更新，可以代替 ::time 做粗粒度判断
+    static time_t recentSecond();
+
 private:
+    static void addKV(LogKV&) {}
+
+    template <typename V, typename... Args>
+    static void addKV(LogKV& encoder, const char* key, const V& value, const Args&... args)
+    {
+        encoder.add(key, value);
+        addKV(encoder, args...);
+    }
+
     // 内部类
     class Impl
     {
     public:
         using LogLevel = Logger::LogLevel;
         Impl(LogLevel level, int savedErrno, const char* file, int line);
+        Impl(LogSite& site, bool structured);
         void formatTime();
+        LogStream& kvStream();
+        void beginKV(LogKV& encoder, const char* event);
+        void finishKV(LogKV& encoder);
+        void updateRecentSecond();
         void finish();
 
         Timestamp time_;
@@ -81,6 +131,7 @@ private:
         LogLevel level_;
         int line_;
         SourceFile basename_;
+        bool structured_;
     };
 
     // Logger's member variable 
@@ -94,19 +145,272 @@ inline Logger::LogLevel logLevel()
     return g_logLevel;
 }
 
+/**
+ * LOG_* 调用点的静态描述，文件名只在第一次执行时解析一次
+ * 二进制模式下第一次使用时分配id并输出描述记录，之后的日志只引用id
+ */
+class LogSite
+{
+public:
+    LogSite(const char* file, int line, Logger::LogLevel level, const char* func)
+        : basename_(file),
+          line_(line),
+          level_(level),
+          func_(func),
+          id_(0)
+    {
+    }
+
+    LogSite(const LogSite&) = delete;
+    LogSite& operator=(const LogSite&) = delete;
+
+    uint32_t id()
+    {
+        uint32_t id = id_.load(std::memory_order_acquire);
+        return id != 0 ? id : registerSite();
+    }
+
+    const SourceFile& basename() const { return basename_; }
+    int line() const { return line_; }
+    Logger::LogLevel level() const { return level_; }
+    const char* func() const { return func_; }
+
+private:
+    uint32_t registerSite();
+
+    const SourceFile basename_;
+    const int line_;
+    const Logger::LogLevel level_;
+    const char* const func_;    // 只有 LOG_DEBUG 记录函数名
+    std::atomic<uint32_t> id_;
+};
+
+// 每次展开生成一个不同的 lambda，其中的静态变量就是该调用点的 LogSite
+#define LOG_SITE(level, func) \
+  ([](const char* f) -> LogSite& { static LogSite site(__FILE__, __LINE__, level, f); return site; }(func))
+
 // 获取errno信息
 const char* getErrnoMsg(int savedErrno);
 
+/**
+ * 编译期最低日志等级，低于它的 LOG_* 调用点在编译时整个删除，连参数求值的代码都不会生成
+ * 0 TRACE, 1 DEBUG, 2 INFO, 3 WARN, 4 ERROR，例如 -DLOG_MIN_LEVEL=2 删除所有 LOG_DEBUG
+ * LOG_FATAL 不受影响
+ */
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
+// 写日志是少见的慢路径，提示编译器把它放到冷代码区，热路径上只剩一次比较和跳转
+#define LOG_UNLIKELY(x) __builtin_expect(!!(x), 0)
+
+// 编译期判断在前，为 false 时整个 if 语句被删除
+#define LOG_ENABLED(level) \
+  (Logger::level >= LOG_MIN_LEVEL && LOG_UNLIKELY(logLevel() <= Logger::level))
+
 /**
  * 当日志等级小于对应等级才会输出
  * 比如设置等级为FATAL，则logLevel等级大于DEBUG和INFO，DEBUG和INFO等级的日志就不会输出
+ * 流式参数在 if 语句体中，日志不输出时不会求值
+ */
+#define LOG_DEBUG if (LOG_ENABLED(DEBUG)) \
+  Logger(LOG_SITE(Logger::DEBUG, __func__)).stream()
+#define LOG_INFO if (LOG_ENABLED(INFO)) \
+  Logger(LOG_SITE(Logger::INFO, nullptr)).stream()
+#define LOG_WARN if (LOG_ENABLED(WARN)) \
+  Logger(LOG_SITE(Logger::WARN, nullptr)).stream()
+#define LOG_ERROR if (LOG_ENABLED(ERROR)) \
+  Logger(LOG_SITE(Logger::ERROR, nullptr)).stream()
+#define LOG_FATAL Logger(LOG_SITE(Logger::FATAL, nullptr)).stream()
+
+/**
+ * 结构化日志，第一个参数是事件名，之后是键值对：
+ *   LOG_INFO_KV("accept", "fd", fd, "peer", addr.toIpPort());
+ * 值可以是整数、浮点数、bool、char、const char* 和 std::string
+ */
+#define LOG_KV(level, ...) if (LOG_ENABLED(level)) \
+  Logger(LOG_SITE(Logger::level, nullptr), Logger::StructuredTag()).kv(__VA_ARGS__)
+#define LOG_DEBUG_KV(...) LOG_KV(DEBUG, __VA_ARGS__)
+#define LOG_INFO_KV(...) LOG_KV(INFO, __VA_ARGS__)
+#define LOG_WARN_KV(...) LOG_KV(WARN, __VA_ARGS__)
+#define LOG_ERROR_KV(...) LOG_KV(ERROR, __VA_ARGS__)
+
+/**
+ * 限流日志调用点的公共部分
+ * 记录被抑制的条数，下一条日志输出前先补一行 "suppressed N messages"；
+ * 一直没有日志通过时，每隔 kReportInterval 秒也会输出一次
+ */
+class LogLimiter
+{
+public:
+    LogLimiter(const char* file, int line, Logger::LogLevel level, const char* func);
+
+    LogLimiter(const LogLimiter&) = delete;
+    LogLimiter& operator=(const LogLimiter&) = delete;
+
+    static const time_t kReportInterval = 10;
+
+protected:
+    // 本条日志可以输出
+    LogSite* pass()
+    {
+        if (suppressed_.load(std::memory_order_relaxed) != 0)
+        {
+            reportSuppressed();
+        }
+        return &site_;
+    }
+
+    // 本条日志被抑制
+    LogSite* suppress()
+    {
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+        if (::time(NULL) - lastReport_.load(std::memory_order_relaxed) >= kReportInterval)
+        {
+            reportSuppressed();
+        }
+        return nullptr;
+    }
+
+private:
+    void reportSuppressed();
+
+    LogSite site_;
+    std::atomic<uint64_t> suppressed_;
+    std::atomic<time_t> lastReport_;
+};
+
+// 每 n 条输出一条，第一条总是输出
+class LogEveryN : public LogLimiter
+{
+public:
+    LogEveryN(const char* file, int line, Logger::LogLevel level, const char* func, double n, double)
+        : LogLimiter(file, line, level, func),
+          n_(n < 1 ? 1 : static_cast<uint64_t>(n)),
+          count_(0)
+    {
+    }
+
+    LogSite* check()
+    {
+        return count_.fetch_add(1, std::memory_order_relaxed) % n_ == 0 ? pass() : suppress();
+    }
+
+private:
+    const uint64_t n_;
+    std::atomic<uint64_t> count_;
+};
+
+// 只输出前 n 条
+class LogFirstN : public LogLimiter
+{
+public:
+    LogFirstN(const char* file, int line, Logger::LogLevel level, const char* func, double n, double)
+        : LogLimiter(file, line, level, func),
+          n_(n < 0 ? 0 : static_cast<uint64_t>(n)),
+          count_(0)
+    {
+    }
+
+    LogSite* check()
+    {
+        return count_.fetch_add(1, std::memory_order_relaxed) < n_ ? pass() : suppress();
+    }
+
+private:
+    const uint64_t n_;
+    std::atomic<uint64_t> count_;
+};
+
+// 每 seconds 秒最多输出一条
+class LogEveryT : public LogLimiter
+{
+public:
+    LogEveryT(const char* file, int line, Logger::LogLevel level, const char* func, double seconds, double)
+        : LogLimiter(file, line, level, func),
+          interval_(static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond)),
+          next_(0)
+    {
+    }
+
+    LogSite* check()
+    {
+        int64_t now = Timestamp::now().microSecondsSinceEpoch();
+        int64_t next = next_.load(std::memory_order_relaxed);
+        if (now >= next && next_.compare_exchange_strong(next, now + interval_, std::memory_order_relaxed))
+        {
+            return pass();
+        }
+        return suppress();
+    }
+
+private:
+    const int64_t interval_;
+    std::atomic<int64_t> next_;   // 下一条允许输出的时间
+};
+
+/**
+ * 令牌桶：平均每秒 rate 条，最多连续突发 burst 条
+ * 用 GCRA 算法实现，状态只有一个原子变量 tat_(理论到达时间)
+ * tat_ 超前当前时间不超过 (burst-1) 个间隔时允许输出，并把 tat_ 推后一个间隔
+ */
+class LogTokenBucket : public LogLimiter
+{
+public:
+    LogTokenBucket(const char* file, int line, Logger::LogLevel level, const char* func,
+                   double rate, double burst)
+        : LogLimiter(file, line, level, func),
+          interval_(static_cast<int64_t>(Timestamp::kMicroSecondsPerSecond / (rate > 0 ? rate : 1))),
+          tolerance_(static_cast<int64_t>((burst > 1 ? burst - 1 : 0) * interval_)),
+          tat_(0)
+    {
+    }
+
+    LogSite* check()
+    {
+        int64_t now = Timestamp::now().microSecondsSinceEpoch();
+        int64_t tat = tat_.load(std::memory_order_relaxed);
+        while (true)
+        {
+            int64_t start = tat > now ? tat : now;
+            if (start - now > tolerance_)
+            {
+                return suppress();
+            }
+            if (tat_.compare_exchange_weak(tat, start + interval_, std::memory_order_relaxed))
+            {
+                return pass();
+            }
+        }
+    }
+
+private:
+    const int64_t interval_;
+    const int64_t tolerance_;
+    std::atomic<int64_t> tat_;
+};
+
+// 与 LOG_SITE 相同，每个调用点一个静态的限流器，参数只在第一次执行时生效
+#define LOG_LIMITED_SITE(Limiter, level, a, b) \
+  ([](const char* f, double x, double y) -> Limiter& { \
+      static Limiter limiter(__FILE__, __LINE__, level, f, x, y); return limiter; \
+  }(level == Logger::DEBUG ? __func__ : nullptr, a, b))
+
+#define LOG_LIMITED(Limiter, level, a, b) \
+  if (LogSite* logSite_ = (LOG_ENABLED(level) ? \
+          LOG_LIMITED_SITE(Limiter, Logger::level, a, b).check() : nullptr)) \
+    Logger(*logSite_).stream()
+
+/**
+ * 限流日志，level 为 DEBUG/INFO/WARN/ERROR，用法与 LOG_* 相同：
+ *   LOG_EVERY_N(ERROR, 100) << "...";              每100条输出一条
+ *   LOG_FIRST_N(WARN, 10) << "...";                只输出前10条
+ *   LOG_EVERY_T(ERROR, 1.0) << "...";              每秒最多一条
+ *   LOG_RATE_LIMITED(ERROR, 10, 50) << "...";      平均每秒10条，最多突发50条
  */
-#define LOG_DEBUG if (logLevel() <= Logger::DEBUG) \
-  Logger(__FILE__, __LINE__, Logger::DEBUG, __func__).stream()
-#define LOG_INFO if (logLevel() <= Logger::INFO) \
-  Logger(__FILE__, __LINE__).stream()
-#define LOG_WARN Logger(__FILE__, __LINE__, Logger::WARN).stream()
-#define LOG_ERROR Logger(__FILE__, __LINE__, Logger::ERROR).stream()
-#define LOG_FATAL Logger(__FILE__, __LINE__, Logger::FATAL).stream()
+#define LOG_EVERY_N(level, n) LOG_LIMITED(LogEveryN, level, n, 0)
+#define LOG_FIRST_N(level, n) LOG_LIMITED(LogFirstN, level, n, 0)
+#define LOG_EVERY_T(level, seconds) LOG_LIMITED(LogEveryT, level, seconds, 0)
+#define LOG_RATE_LIMITED(level, rate, burst) LOG_LIMITED(LogTokenBucket, level, rate, burst)
 
 #endif // LOGGING_H
\ No newline at end of file
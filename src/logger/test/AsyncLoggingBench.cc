@@ -0,0 +1,192 @@
+#include "AsyncLogging.h"
+#include "Timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <thread>
+#include <vector>
+
+/**
+ * 多线程写日志吞吐量对比
+ * MutexAsyncLogging 是改为每线程暂存区之前的实现：所有前端线程共用一把锁和一对4MB缓冲区
+ *
+ * ./AsyncLoggingBench [日志文件前缀] [每个线程写入行数]
+ */
+class MutexAsyncLogging : noncopyable
+{
+public:
+    MutexAsyncLogging(const std::string& basename, off_t rollSize)
+        : running_(false),
+          basename_(basename),
+          rollSize_(rollSize),
+          thread_(std::bind(&MutexAsyncLogging::threadFunc, this), "Logging"),
+          currentBuffer_(new Buffer),
+          nextBuffer_(new Buffer)
+    {
+        buffers_.reserve(16);
+    }
+
+    void append(const char* logline, int len)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (currentBuffer_->avail() > len)
+        {
+            currentBuffer_->append(logline, len);
+        }
+        else
+        {
+            buffers_.push_back(std::move(currentBuffer_));
+            if (nextBuffer_)
+            {
+                currentBuffer_ = std::move(nextBuffer_);
+            }
+            else
+            {
+                currentBuffer_.reset(new Buffer);
+            }
+            currentBuffer_->append(logline, len);
+            cond_.notify_one();
+        }
+    }
+
+    void start()
+    {
+        running_ = true;
+        thread_.start();
+    }
+
+    void stop()
+    {
+        running_ = false;
+        cond_.notify_one();
+        thread_.join();
+    }
+
+private:
+    using Buffer = FixedBuffer<kLargeBuffer>;
+    using BufferVector = std::vector<std::unique_ptr<Buffer>>;
+    using BufferPtr = BufferVector::value_type;
+
+    void threadFunc()
+    {
+        LogFile output(basename_, rollSize_, false);
+        BufferPtr newBuffer1(new Buffer);
+        BufferPtr newBuffer2(new Buffer);
+        BufferVector buffersToWrite;
+        buffersToWrite.reserve(16);
+        while (running_)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (buffers_.empty())
+                {
+                    cond_.wait_for(lock, std::chrono::seconds(3));
+                }
+                buffers_.push_back(std::move(currentBuffer_));
+                currentBuffer_ = std::move(newBuffer1);
+                buffersToWrite.swap(buffers_);
+                if (!nextBuffer_)
+                {
+                    nextBuffer_ = std::move(newBuffer2);
+                }
+            }
+            for (const auto& buffer : buffersToWrite)
+            {
+                output.append(buffer->data(), buffer->length());
+            }
+            if (buffersToWrite.size() > 2)
+            {
+                buffersToWrite.resize(2);
+            }
+            if (!newBuffer1)
+            {
+                newBuffer1 = std::move(buffersToWrite.back());
+                buffersToWrite.pop_back();
+                newBuffer1->reset();
+            }
+            if (!newBuffer2)
+            {
+                newBuffer2 = std::move(buffersToWrite.back());
+                buffersToWrite.pop_back();
+                newBuffer2->reset();
+            }
+            buffersToWrite.clear();
+            output.flush();
+        }
+        // 与原实现不同，退出前写完剩余日志，保证两者写入的数据量相同
+        buffers_.push_back(std::move(currentBuffer_));
+        for (const auto& buffer : buffers_)
+        {
+            output.append(buffer->data(), buffer->length());
+        }
+        output.flush();
+    }
+
+    std::atomic<bool> running_;
+    const std::string basename_;
+    const off_t rollSize_;
+    Thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    BufferPtr currentBuffer_;
+    BufferPtr nextBuffer_;
+    BufferVector buffers_;
+};
+
+const off_t kRollSize = 1024 * 1024 * 1024;
+
+// 一行典型的访问日志，约120字节
+const char kLine[] =
+    "2022/12/01 01:51:48 123456 INFO  127.0.0.1:50432 GET /index.html 200 1024 bytes 85us - HttpServer.cc:120\n";
+
+template <typename Logging>
+void bench(const char* name, const std::string& basename, int threads, int linesPerThread)
+{
+    Logging log(basename, kRollSize);
+    log.start();
+
+    Timestamp start = Timestamp::now();
+    std::vector<std::thread> producers;
+    for (int t = 0; t < threads; ++t)
+    {
+        producers.emplace_back([&log, linesPerThread]() {
+            for (int i = 0; i < linesPerThread; ++i)
+            {
+                log.append(kLine, sizeof(kLine) - 1);
+            }
+        });
+    }
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+    Timestamp frontEnd = Timestamp::now();
+    log.stop();
+    Timestamp end = Timestamp::now();
+
+    double lines = static_cast<double>(threads) * linesPerThread;
+    double frontUs = static_cast<double>(frontEnd.microSecondsSinceEpoch() - start.microSecondsSinceEpoch());
+    double totalUs = static_cast<double>(end.microSecondsSinceEpoch() - start.microSecondsSinceEpoch());
+    printf("%-18s threads=%-3d append=%8.2f Mlines/s  %7.1f ns/line  with-flush=%8.2f Mlines/s\n",
+           name, threads, lines / frontUs, frontUs * 1000 / lines, lines / totalUs);
+}
+
+int main(int argc, char* argv[])
+{
+    std::string basename = argc > 1 ? argv[1] : "/tmp/AsyncLoggingBench";
+    int linesPerThread = argc > 2 ? atoi(argv[2]) : 200000;
+
+    printf("pid = %d, %d lines per thread, %zu bytes per line\n",
+           getpid(), linesPerThread, sizeof(kLine) - 1);
+    const int kThreads[] = { 1, 2, 4, 8, 16 };
+    for (int threads : kThreads)
+    {
+        bench<MutexAsyncLogging>("mutex (old)", basename + ".mutex", threads, linesPerThread);
+        bench<AsyncLogging>("per-thread staging", basename + ".staging", threads, linesPerThread);
+        // 日志文件以秒为单位命名，避免下一轮追加到同一个文件
+        sleep(1);
+    }
+    return 0;
+}
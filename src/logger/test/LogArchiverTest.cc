@@ -0,0 +1,192 @@
+#include "LogArchiver.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <zlib.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * LogArchiver 在临时目录中的压缩、按时间清理和按总大小清理
+ * 只处理 LogFile 生成的文件名，同目录下的其他文件不受影响
+ */
+int g_failures = 0;
+
+void check(bool ok, const char* what)
+{
+    printf("%-56s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+    {
+        ++g_failures;
+    }
+}
+
+std::string g_dir;
+
+std::string pathOf(const std::string& name)
+{
+    return g_dir + "/" + name;
+}
+
+bool exists(const std::string& name)
+{
+    struct stat st;
+    return ::stat(pathOf(name).c_str(), &st) == 0;
+}
+
+void writeFile(const std::string& name, size_t size, time_t age = 0)
+{
+    std::string content(size, 'x');
+    FILE* fp = ::fopen(pathOf(name).c_str(), "wb");
+    ::fwrite(content.data(), 1, content.size(), fp);
+    ::fclose(fp);
+    if (age > 0)
+    {
+        struct timeval times[2];
+        times[0].tv_sec = times[1].tv_sec = ::time(NULL) - age;
+        times[0].tv_usec = times[1].tv_usec = 0;
+        ::utimes(pathOf(name).c_str(), times);
+    }
+}
+
+size_t gzipSize(const std::string& name)
+{
+    gzFile in = ::gzopen(pathOf(name).c_str(), "rb");
+    if (in == nullptr)
+    {
+        return 0;
+    }
+    size_t total = 0;
+    char buf[4096];
+    int n;
+    while ((n = ::gzread(in, buf, sizeof(buf))) > 0)
+    {
+        total += n;
+    }
+    ::gzclose(in);
+    return total;
+}
+
+void removeAll(const std::vector<std::string>& names)
+{
+    for (const std::string& name : names)
+    {
+        ::unlink(pathOf(name).c_str());
+        ::unlink(pathOf(name + ".gz").c_str());
+    }
+}
+
+// 启动后台线程处理一遍，done 成立后停止，stop 会等当前这一遍处理完
+void runOnce(const LogArchiver::Options& options, const std::string& activeName, const std::function<bool()>& done)
+{
+    LogArchiver archiver(g_dir + "/app", options);
+    archiver.start();
+    archiver.setActiveFile(pathOf(activeName));
+    for (int i = 0; i < 500 && !done(); ++i)
+    {
+        ::usleep(10 * 1000);
+    }
+    archiver.stop();
+}
+
+// 不是 LogFile 生成的文件，只是以 "app." 开头
+const char* const kForeign[] = {
+    "app.backup.log",
+    "app.old.20260101-000000.log",
+    "app.20260101-000000.debug.log",
+    "app.2026.log.gz",
+};
+
+void testCompress()
+{
+    writeFile("app.20260101-000000.log", 4096);
+    writeFile("app.20260101-000100.log", 100);
+    for (const char* name : kForeign)
+    {
+        writeFile(name, 100);
+    }
+
+    LogArchiver::Options options;
+    runOnce(options, "app.20260101-000100.log", [] { return exists("app.20260101-000000.log.gz"); });
+
+    check(!exists("app.20260101-000000.log") && gzipSize("app.20260101-000000.log.gz") == 4096,
+          "rolled file compressed and removed");
+    check(exists("app.20260101-000100.log") && !exists("app.20260101-000100.log.gz"),
+          "active file left alone");
+    bool foreignKept = true;
+    for (const char* name : kForeign)
+    {
+        foreignKept = foreignKept && exists(name) && !exists(std::string(name) + ".gz");
+    }
+    check(foreignKept, "foreign files with the same prefix untouched");
+
+    removeAll({ "app.20260101-000000.log", "app.20260101-000100.log" });
+    removeAll(std::vector<std::string>(kForeign, kForeign + 4));
+}
+
+void testMaxAge()
+{
+    const time_t kDay = 24 * 3600;
+    writeFile("app.20260101-000000.log.gz", 100, 2 * kDay);
+    writeFile("app.20260102-000000.log", 100);
+    writeFile("app.20260101-000100.log", 100, 2 * kDay);
+    writeFile("app.backup.log", 100, 2 * kDay);
+
+    LogArchiver::Options options;
+    options.compress = false;
+    options.maxAge = kDay;
+    runOnce(options, "app.20260101-000100.log", [] { return !exists("app.20260101-000000.log.gz"); });
+
+    check(!exists("app.20260101-000000.log.gz"), "file older than maxAge deleted");
+    check(exists("app.20260102-000000.log"), "recent file kept");
+    check(exists("app.20260101-000100.log"), "old active file kept");
+    check(exists("app.backup.log"), "old foreign file kept");
+
+    removeAll({ "app.20260102-000000.log", "app.20260101-000100.log", "app.backup.log" });
+}
+
+void testMaxTotalBytes()
+{
+    writeFile("app.20260101-000000.log", 1000);
+    writeFile("app.20260101-000100.log", 1000);
+    writeFile("app.20260101-000200.log", 1000);
+    writeFile("app.20260101-000300.log", 1000);
+    writeFile("app.backup.log", 5000);
+
+    // 4000 字节，从最旧的开始删到不超过 2500
+    LogArchiver::Options options;
+    options.compress = false;
+    options.maxTotalBytes = 2500;
+    runOnce(options, "app.20260101-000300.log", [] { return !exists("app.20260101-000100.log"); });
+
+    check(!exists("app.20260101-000000.log") && !exists("app.20260101-000100.log"),
+          "oldest files deleted over maxTotalBytes");
+    check(exists("app.20260101-000200.log") && exists("app.20260101-000300.log"),
+          "newest and active files kept");
+    check(exists("app.backup.log"), "foreign file not counted or deleted");
+
+    removeAll({ "app.20260101-000200.log", "app.20260101-000300.log", "app.backup.log" });
+}
+
+int main()
+{
+    char dir[] = "/tmp/LogArchiverTestXXXXXX";
+    if (::mkdtemp(dir) == nullptr)
+    {
+        return 1;
+    }
+    g_dir = dir;
+
+    testCompress();
+    testMaxAge();
+    testMaxTotalBytes();
+
+    ::rmdir(dir);
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,74 @@
+#include "LogFile.h"
+#include "Timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
+/**
+ * 后端线程写日志文件的吞吐量和单次写入的最大停顿
+ * 模拟突发日志：以 AsyncLogging 一次收集的大小(1MB)为单位连续写入
+ *
+ * ./LogFileBench [日志文件前缀] [写入MB数]
+ */
+const size_t kChunkSize = 1024 * 1024;
+const off_t kRollSize = 512 * 1024 * 1024;
+
+void bench(const char* name, const std::string& basename, int totalMB, const FileUtil::Options& options)
+{
+    std::vector<char> chunk(kChunkSize);
+    for (size_t i = 0; i < chunk.size(); ++i)
+    {
+        chunk[i] = (i % 100 == 99) ? '\n' : static_cast<char>('a' + i % 26);
+    }
+
+    std::vector<double> latencies;
+    latencies.reserve(totalMB);
+    Timestamp start = Timestamp::now();
+    {
+        LogFile output(basename, kRollSize, 3, 1024, options);
+        for (int i = 0; i < totalMB; ++i)
+        {
+            Timestamp before = Timestamp::now();
+            output.append(chunk.data(), static_cast<int>(chunk.size()));
+            Timestamp after = Timestamp::now();
+            latencies.push_back(static_cast<double>(after.microSecondsSinceEpoch() - before.microSecondsSinceEpoch()));
+        }
+        output.flush();
+    }
+    Timestamp end = Timestamp::now();
+
+    std::sort(latencies.begin(), latencies.end());
+    double seconds = static_cast<double>(end.microSecondsSinceEpoch() - start.microSecondsSinceEpoch()) / 1e6;
+    printf("%-26s %8.1f MB/s  append p50=%6.0fus p99=%7.0fus max=%7.0fus\n",
+           name, totalMB / seconds,
+           latencies[latencies.size() / 2],
+           latencies[latencies.size() * 99 / 100],
+           latencies.back());
+}
+
+int main(int argc, char* argv[])
+{
+    std::string basename = argc > 1 ? argv[1] : "/tmp/LogFileBench";
+    int totalMB = argc > 2 ? atoi(argv[2]) : 1024;
+
+    // 接近原来 stdio 的写法：64KB 缓冲区，不预分配，不提前回写，不做后台同步
+    FileUtil::Options stdioLike;
+    stdioLike.preallocate = false;
+    stdioLike.bufferSize = 64 * 1024;
+    stdioLike.syncBytes = 0;
+    stdioLike.syncInterval = 0;
+    bench("64KB buffer (old)", basename + ".old", totalMB, stdioLike);
+    sleep(1);
+
+    FileUtil::Options defaults;
+    bench("prealloc+1MB+sync", basename + ".new", totalMB, defaults);
+    sleep(1);
+
+    FileUtil::Options direct;
+    direct.directIO = true;
+    bench("prealloc+1MB+O_DIRECT", basename + ".direct", totalMB, direct);
+    return 0;
+}
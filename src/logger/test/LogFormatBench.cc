@@ -0,0 +1,82 @@
+#include "Logging.h"
+#include "Timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * 单线程格式化一行日志的开销，输出丢弃，只统计前端格式化
+ * 分别测试文本模式和二进制模式，结构化日志再测一遍 JSON 格式
+ *
+ * ./LogFormatBench [行数]
+ */
+static size_t g_totalBytes = 0;
+
+void nullOutput(const char* msg, int len)
+{
+    g_totalBytes += len;
+}
+
+template <typename Func>
+void bench(const char* name, int n, Func&& func)
+{
+    g_totalBytes = 0;
+    Timestamp start = Timestamp::now();
+    for (int i = 0; i < n; ++i)
+    {
+        func(i);
+    }
+    Timestamp end = Timestamp::now();
+    double ns = static_cast<double>(end.microSecondsSinceEpoch() - start.microSecondsSinceEpoch()) * 1000;
+    printf("%-10s %8.1f ns/line  %6.1f bytes/line\n",
+           name, ns / n, static_cast<double>(g_totalBytes) / n);
+}
+
+void runKV(int n)
+{
+    bench("kv", n, [](int i) {
+        LOG_INFO_KV("request", "peer", "127.0.0.1", "port", 50000 + i % 10000,
+                    "path", "/index.html", "status", 200, "latency", i * 1.5);
+    });
+    bench("kv-escape", n, [](int i) {
+        LOG_INFO_KV("query", "sql", "SELECT * FROM t WHERE name = \"a b\"\n", "rows", i);
+    });
+}
+
+void runAll(int n)
+{
+    bench("string", n, [](int) {
+        LOG_INFO << "Hello, world";
+    });
+    bench("int", n, [](int i) {
+        LOG_INFO << "conn " << i << " fd=" << i % 1024 << " bytes=" << 1234567890123LL + i;
+    });
+    bench("double", n, [](int i) {
+        LOG_INFO << "latency " << i * 0.001 << " ratio " << 1.0 / (i + 1);
+    });
+    bench("mixed", n, [](int i) {
+        LOG_INFO << "127.0.0.1:" << 50000 + i % 10000 << " GET /index.html " << 200
+                 << ' ' << i * 3 << " bytes " << i * 1.5 << "us";
+    });
+    runKV(n);
+}
+
+int main(int argc, char* argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : 1000000;
+    Logger::setOutput(nullOutput);
+
+    printf("text\n");
+    runAll(n);
+
+    LogKV::setFormat(LogKV::kJson);
+    printf("json\n");
+    runKV(n);
+    LogKV::setFormat(LogKV::kLogfmt);
+
+    // 二进制模式只记录调用点id和参数原始字节
+    Logger::setBinaryMode(true);
+    printf("binary\n");
+    runAll(n);
+    return 0;
+}
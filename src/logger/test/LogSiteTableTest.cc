@@ -0,0 +1,154 @@
+#include "LogFile.h"
+#include "Logging.h"
+#include "LogBinaryFormat.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <set>
+#include <string>
+
+/**
+ * 二进制日志滚动后，新文件开头带有全部调用点描述，不需要之前的文件也能解码
+ */
+int g_failures = 0;
+
+void check(bool ok, const char* what)
+{
+    printf("%-56s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+    {
+        ++g_failures;
+    }
+}
+
+LogFile* g_logFile = nullptr;
+
+void output(const char* data, int len)
+{
+    if (g_logFile != nullptr)
+    {
+        g_logFile->append(data, len);
+    }
+}
+
+std::string readFile(const std::string& filename)
+{
+    std::string content;
+    FILE* fp = ::fopen(filename.c_str(), "rb");
+    if (fp == nullptr)
+    {
+        return content;
+    }
+    char buf[4096];
+    size_t n;
+    while ((n = ::fread(buf, 1, sizeof(buf), fp)) > 0)
+    {
+        content.append(buf, n);
+    }
+    ::fclose(fp);
+    return content;
+}
+
+struct Records
+{
+    std::set<uint32_t> sites;       // 描述过的调用点
+    size_t logs;
+    size_t unknown;                 // 引用了文件中没有描述的调用点的日志
+    bool sitesFirst;                // 描述表在第一条日志之前
+};
+
+Records scan(const std::string& content)
+{
+    Records records = Records();
+    records.sitesFirst = true;
+    size_t pos = 0;
+    while (pos + LogBinary::kRecordHeaderSize <= content.size())
+    {
+        uint32_t length;
+        memcpy(&length, content.data() + pos, sizeof(length));
+        // 预分配的文件尾部是0
+        if (length < LogBinary::kRecordHeaderSize || pos + length > content.size())
+        {
+            break;
+        }
+        uint8_t type = static_cast<uint8_t>(content[pos + 4]);
+        uint32_t id;
+        memcpy(&id, content.data() + pos + LogBinary::kRecordHeaderSize, sizeof(id));
+        if (type == LogBinary::kSiteRecord)
+        {
+            records.sitesFirst = records.sitesFirst && records.logs == 0;
+            records.sites.insert(id);
+        }
+        else if (type == LogBinary::kLogRecord)
+        {
+            ++records.logs;
+            if (records.sites.count(id) == 0)
+            {
+                ++records.unknown;
+            }
+        }
+        pos += length;
+    }
+    return records;
+}
+
+void logFrom(int site, int i)
+{
+    if (site == 0)
+    {
+        LOG_INFO << "first site " << i;
+    }
+    else
+    {
+        LOG_WARN << "second site " << i;
+    }
+}
+
+int main()
+{
+    char dir[] = "/tmp/LogSiteTableTestXXXXXX";
+    if (::mkdtemp(dir) == nullptr)
+    {
+        return 1;
+    }
+    std::string basename = std::string(dir) + "/site";
+
+    FileUtil::Options options;
+    options.preallocate = false;
+    options.syncInterval = 0;
+    {
+        LogFile file(basename, 64 * 1024 * 1024, 3, 1024, options);
+        file.setFileHeader([] { return Logger::binarySiteTable(); });
+        g_logFile = &file;
+        Logger::setOutput(output);
+        Logger::setBinaryMode(true);
+
+        logFrom(0, 1);
+        logFrom(1, 1);
+        std::string first = file.filename();
+
+        // 文件名精确到秒，同一秒内不会滚动
+        ::sleep(1);
+        check(file.rollFile(), "rolled to a new file");
+        std::string second = file.filename();
+        logFrom(0, 2);
+        logFrom(1, 2);
+        file.flush();
+
+        Records firstRecords = scan(readFile(first));
+        Records secondRecords = scan(readFile(second));
+        check(firstRecords.logs == 2 && firstRecords.unknown == 0, "first file decodable");
+        check(secondRecords.logs == 2 && secondRecords.sites.size() >= 2, "rolled file has its own site table");
+        check(secondRecords.sitesFirst, "site table written before the first log record");
+        check(secondRecords.unknown == 0, "rolled file decodable without the first file");
+
+        Logger::setBinaryMode(false);
+        g_logFile = nullptr;
+        ::unlink(first.c_str());
+        ::unlink(second.c_str());
+    }
+    ::rmdir(dir);
+    return g_failures == 0 ? 0 : 1;
+}
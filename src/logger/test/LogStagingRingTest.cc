@@ -0,0 +1,103 @@
+#include "LogStagingRing.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/**
+ * LogStagingRing 的收集和丢弃
+ * 在 drain 的输出回调中调用 dropUnclaimed，模拟后端写入时前端队列写满丢弃最旧日志
+ */
+int g_failures = 0;
+
+void check(bool ok, const char* what)
+{
+    printf("%-56s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+    {
+        ++g_failures;
+    }
+}
+
+void append(LogStagingRing& ring, const std::string& message)
+{
+    size_t used;
+    ring.tryAppend(message.data(), message.size(), &used);
+}
+
+void testDrain()
+{
+    LogStagingRing ring(4096);
+    std::vector<std::string> messages;
+    for (int i = 0; i < 3; ++i)
+    {
+        append(ring, "message " + std::to_string(i));
+    }
+    size_t records = ring.drain([&messages](const char* data, size_t len) {
+        messages.push_back(std::string(data, len));
+    });
+    check(records == 3 && messages.size() == 3 && messages[2] == "message 2", "drain returns every record");
+    check(ring.empty(), "ring empty after drain");
+
+    size_t bytes = 0;
+    check(ring.dropUnclaimed(&bytes) == 0 && bytes == 0, "nothing to drop after drain");
+}
+
+void testDropDuringDrain()
+{
+    LogStagingRing ring(4096);
+    for (int i = 0; i < 10; ++i)
+    {
+        append(ring, "claimed");
+    }
+
+    size_t dropped = 0;
+    size_t droppedBytes = 0;
+    bool droppedOnce = false;
+    std::string output;
+    size_t records = ring.drain([&](const char* data, size_t len) {
+        output.append(data, len);
+        if (!droppedOnce)
+        {
+            // 认领之后、收集完成之前，前端又写入两条并丢弃
+            droppedOnce = true;
+            append(ring, "late1");
+            append(ring, "late2");
+            dropped = ring.dropUnclaimed(&droppedBytes);
+        }
+    });
+    check(records == 10 && output.size() == 10 * 7, "claimed records are all written");
+    check(dropped == 2, "drop inside drain counts only unclaimed records");
+    check(droppedBytes == 10, "drop inside drain counts only unclaimed bytes");
+    check(ring.empty(), "ring empty after drain and drop");
+
+    append(ring, "next");
+    size_t bytes = 0;
+    check(ring.dropUnclaimed(&bytes) == 1 && bytes == 4, "later drop counts correctly");
+}
+
+void testWrapAround()
+{
+    LogStagingRing ring(4096);
+    std::string message(1000, 'x');
+    size_t total = 0;
+    bool intact = true;
+    for (int round = 0; round < 20; ++round)
+    {
+        append(ring, message);
+        append(ring, message);
+        std::string record;
+        ring.drain([&record](const char* data, size_t len) { record.append(data, len); });
+        intact = intact && record == message + message;
+        total += record.size();
+    }
+    check(intact && total == 20 * 2 * message.size(), "records across the end of the buffer");
+}
+
+int main()
+{
+    testDrain();
+    testDropDuringDrain();
+    testWrapAround();
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,270 @@
+#include "AsyncLogging.h"
+#include "Logging.h"
+
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * 日志基准测试，结果每行一个 JSON 对象写到标准输出，便于脚本对比不同版本
+ *
+ * sync:  默认输出，格式化后 fwrite 到 stdout，测试期间 stdout 被重定向到 /dev/null
+ * async: AsyncLogging，1 到 maxThreads 个前端线程
+ * 每种情况分别测试不同的内容长度和等级(INFO 输出，DEBUG 被过滤)，
+ * 统计每次调用的延迟分位数和总吞吐量，async 另外给出包含后端写完文件在内的吞吐量
+ * 最后测量异步日志从第一次写入到出现在磁盘文件中的时间
+ *
+ * ./LoggingBench [每个线程写入行数] [最大线程数] [日志文件前缀] > result.jsonl
+ */
+static FILE* g_result = nullptr;
+static AsyncLogging* g_asyncLog = nullptr;
+
+const off_t kRollSize = 1024 * 1024 * 1024;
+const int kPayloadSizes[] = { 16, 128, 1024 };
+
+int64_t nowNanos()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+void asyncOutput(const char* msg, int len)
+{
+    g_asyncLog->append(msg, len);
+}
+
+// 日志不输出到终端，结果写到原来的 stdout
+void redirectStdout()
+{
+    fflush(stdout);
+    g_result = fdopen(dup(STDOUT_FILENO), "w");
+    int fd = ::open("/dev/null", O_WRONLY);
+    dup2(fd, STDOUT_FILENO);
+    ::close(fd);
+}
+
+// 对每个以 basename 开头的日志文件调用 func(path)
+template <typename Func>
+void forEachLogFile(const std::string& basename, Func&& func)
+{
+    size_t slash = basename.rfind('/');
+    std::string dir = (slash == std::string::npos) ? "./" : basename.substr(0, slash + 1);
+    std::string prefix = (slash == std::string::npos) ? basename : basename.substr(slash + 1);
+    DIR* d = opendir(dir.c_str());
+    if (!d)
+    {
+        return;
+    }
+    while (struct dirent* entry = readdir(d))
+    {
+        if (strncmp(entry->d_name, prefix.c_str(), prefix.size()) == 0)
+        {
+            func(dir + entry->d_name);
+        }
+    }
+    closedir(d);
+}
+
+void removeLogFiles(const std::string& basename)
+{
+    forEachLogFile(basename, [](const std::string& path) { ::unlink(path.c_str()); });
+}
+
+off_t logFileBytes(const std::string& basename)
+{
+    off_t total = 0;
+    forEachLogFile(basename, [&total](const std::string& path) {
+        struct stat st;
+        if (::stat(path.c_str(), &st) == 0)
+        {
+            total += st.st_size;
+        }
+    });
+    return total;
+}
+
+void produce(int lines, const char* payload, bool debug, std::vector<int64_t>* latencies)
+{
+    latencies->reserve(lines);
+    for (int i = 0; i < lines; ++i)
+    {
+        int64_t start = nowNanos();
+        if (debug)
+        {
+            LOG_DEBUG << "seq " << i << ' ' << payload;
+        }
+        else
+        {
+            LOG_INFO << "seq " << i << ' ' << payload;
+        }
+        latencies->push_back(nowNanos() - start);
+    }
+}
+
+// 合并各线程的延迟样本，输出一行结果
+void report(const char* path, int threads, int payloadBytes, const char* level,
+            std::vector<std::vector<int64_t>>& latencies, int64_t frontNanos, int64_t totalNanos)
+{
+    std::vector<int64_t> all;
+    for (auto& samples : latencies)
+    {
+        all.insert(all.end(), samples.begin(), samples.end());
+    }
+    std::sort(all.begin(), all.end());
+    double sum = 0;
+    for (int64_t sample : all)
+    {
+        sum += static_cast<double>(sample);
+    }
+    auto percentile = [&all](double p) {
+        return all[std::min(all.size() - 1, static_cast<size_t>(p * static_cast<double>(all.size())))];
+    };
+
+    double calls = static_cast<double>(all.size());
+    fprintf(g_result,
+            "{\"bench\":\"%s\",\"threads\":%d,\"payload_bytes\":%d,\"level\":\"%s\",\"calls\":%zu,"
+            "\"calls_per_sec\":%.0f,\"calls_per_sec_with_drain\":%.0f,"
+            "\"mean_ns\":%.1f,\"p50_ns\":%" PRId64 ",\"p90_ns\":%" PRId64 ",\"p99_ns\":%" PRId64
+            ",\"p999_ns\":%" PRId64 ",\"max_ns\":%" PRId64 "}\n",
+            path, threads, payloadBytes, level, all.size(),
+            calls * 1e9 / static_cast<double>(frontNanos),
+            calls * 1e9 / static_cast<double>(totalNanos),
+            sum / calls,
+            percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999), all.back());
+    fflush(g_result);
+}
+
+// 两次相邻的 clock_gettime 之间的间隔，每个延迟样本都包含这部分开销
+void benchTimerOverhead()
+{
+    const int kRounds = 1000000;
+    int64_t total = 0;
+    for (int i = 0; i < kRounds; ++i)
+    {
+        int64_t start = nowNanos();
+        total += nowNanos() - start;
+    }
+    fprintf(g_result, "{\"bench\":\"timer_overhead\",\"mean_ns\":%.1f}\n",
+            static_cast<double>(total) / kRounds);
+    fflush(g_result);
+}
+
+void benchSync(int lines, const char* payload, int payloadBytes, bool debug)
+{
+    std::vector<std::vector<int64_t>> latencies(1);
+    int64_t start = nowNanos();
+    produce(lines, payload, debug, &latencies[0]);
+    fflush(stdout);
+    int64_t end = nowNanos();
+    report("sync", 1, payloadBytes, debug ? "DEBUG" : "INFO", latencies, end - start, end - start);
+}
+
+void benchAsync(const std::string& basename, int threads, int lines,
+                const char* payload, int payloadBytes, bool debug)
+{
+    AsyncLogging log(basename, kRollSize);
+    g_asyncLog = &log;
+    log.start();
+
+    std::vector<std::vector<int64_t>> latencies(threads);
+    std::vector<std::thread> producers;
+    int64_t start = nowNanos();
+    for (int t = 0; t < threads; ++t)
+    {
+        producers.emplace_back(produce, lines, payload, debug, &latencies[t]);
+    }
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+    int64_t frontEnd = nowNanos();
+    log.stop();
+    int64_t end = nowNanos();
+    g_asyncLog = nullptr;
+
+    report("async", threads, payloadBytes, debug ? "DEBUG" : "INFO", latencies, frontEnd - start, end - start);
+    removeLogFiles(basename);
+}
+
+/**
+ * 写入一条日志后轮询文件大小，直到数据真正写入文件
+ * 没有写满暂存区一半时要等后端按 flushInterval 定时收集
+ */
+void benchFirstWrite(const std::string& basename)
+{
+    const int kFlushInterval = 3;
+    AsyncLogging log(basename, kRollSize, kFlushInterval);
+    g_asyncLog = &log;
+    log.start();
+    // 等后端打开文件，避免把创建文件的时间算进去
+    usleep(100 * 1000);
+
+    int64_t start = nowNanos();
+    LOG_INFO << "first line";
+    int64_t deadline = start + (kFlushInterval + 2) * 1000000000LL;
+    int64_t written = -1;
+    while (nowNanos() < deadline)
+    {
+        if (logFileBytes(basename) > 0)
+        {
+            written = nowNanos() - start;
+            break;
+        }
+        usleep(100);
+    }
+    log.stop();
+    g_asyncLog = nullptr;
+
+    fprintf(g_result, "{\"bench\":\"first_write\",\"flush_interval_s\":%d,\"latency_us\":%" PRId64 "}\n",
+            kFlushInterval, written < 0 ? -1 : written / 1000);
+    fflush(g_result);
+    removeLogFiles(basename);
+}
+
+int main(int argc, char* argv[])
+{
+    int lines = argc > 1 ? atoi(argv[1]) : 50000;
+    int maxThreads = argc > 2 ? atoi(argv[2]) : 8;
+    std::string basename = argc > 3 ? argv[3] : "/tmp/LoggingBench";
+
+    redirectStdout();
+    benchTimerOverhead();
+
+    std::vector<std::string> payloads;
+    for (int size : kPayloadSizes)
+    {
+        payloads.push_back(std::string(size, 'x'));
+    }
+
+    for (size_t i = 0; i < payloads.size(); ++i)
+    {
+        benchSync(lines, payloads[i].c_str(), kPayloadSizes[i], false);
+        benchSync(lines, payloads[i].c_str(), kPayloadSizes[i], true);
+    }
+
+    Logger::setOutput(asyncOutput);
+    int run = 0;
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        for (size_t i = 0; i < payloads.size(); ++i)
+        {
+            // 每轮使用不同的文件名，避免同一秒内滚动出的文件重名
+            std::string name = basename + "." + std::to_string(run++);
+            benchAsync(name, threads, lines, payloads[i].c_str(), kPayloadSizes[i], false);
+            benchAsync(name, threads, lines, payloads[i].c_str(), kPayloadSizes[i], true);
+        }
+    }
+
+    benchFirstWrite(basename + ".first");
+    return 0;
+}
@@ -0,0 +1,303 @@
+#include "LogBinaryFormat.h"
+#include "LogStream.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/**
+ * 把 Logger::setBinaryMode(true) 写出的二进制日志还原为文本，输出到标准输出
+ * 输出格式与文本模式相同
+ *
+ * 使用 AsyncLogging(或者 LogFile::setFileHeader)时每个文件开头都有此前注册的全部调用点描述，
+ * 每个文件可以单独解码；没有文件头时描述只在进程中第一次使用时写一次，
+ * 同一进程的多个日志文件需要一起解码：
+ *   ./LogDecoder app.20221201-015148.log app.20221201-115148.log > app.txt
+ */
+namespace
+{
+
+// 调用点描述中文件名和函数名最长各 64KB，日志记录不超过 LogStream 的缓冲区
+const uint32_t kMaxRecordSize = 1024 * 1024;
+
+const char* kLevelNames[] =
+{
+    "TRACE ",
+    "DEBUG ",
+    "INFO  ",
+    "WARN  ",
+    "ERROR ",
+    "FATAL ",
+};
+
+struct Site
+{
+    int level;
+    uint32_t line;
+    std::string file;
+    std::string func;
+};
+
+using SiteMap = std::unordered_map<uint32_t, Site>;
+
+template <typename T>
+T readValue(const char*& p)
+{
+    T value;
+    memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return value;
+}
+
+/**
+ * 依次读出文件中的每条记录，交给 handler(type, body, bodyLen)
+ * 文件末尾不完整的记录(进程崩溃时常见)会被忽略
+ */
+template <typename Handler>
+bool forEachRecord(const char* filename, Handler&& handler)
+{
+    FILE* fp = ::fopen(filename, "rb");
+    if (fp == nullptr)
+    {
+        fprintf(stderr, "LogDecoder: cannot open %s\n", filename);
+        return false;
+    }
+
+    std::vector<char> record;
+    char header[LogBinary::kRecordHeaderSize];
+    while (::fread(header, 1, sizeof(header), fp) == sizeof(header))
+    {
+        uint32_t length;
+        memcpy(&length, header, sizeof(length));
+        uint8_t type = static_cast<uint8_t>(header[4]);
+        if (length < sizeof(header) || length > kMaxRecordSize ||
+            (type != LogBinary::kSiteRecord && type != LogBinary::kLogRecord))
+        {
+            fprintf(stderr, "LogDecoder: %s: corrupted record at offset %ld\n",
+                    filename, ::ftell(fp) - static_cast<long>(sizeof(header)));
+            break;
+        }
+        record.resize(length - sizeof(header));
+        if (!record.empty() && ::fread(record.data(), 1, record.size(), fp) != record.size())
+        {
+            fprintf(stderr, "LogDecoder: %s: truncated record at end of file\n", filename);
+            break;
+        }
+        handler(type, record.data(), record.size());
+    }
+    ::fclose(fp);
+    return true;
+}
+
+void readSite(SiteMap* sites, const char* p, size_t len)
+{
+    const char* end = p + len;
+    if (len < 4 + 1 + 4 + 2)
+    {
+        return;
+    }
+    Site site;
+    uint32_t id = readValue<uint32_t>(p);
+    site.level = readValue<uint8_t>(p);
+    site.line = readValue<uint32_t>(p);
+    uint16_t fileLen = readValue<uint16_t>(p);
+    if (p + fileLen + 2 > end)
+    {
+        return;
+    }
+    site.file.assign(p, fileLen);
+    p += fileLen;
+    uint16_t funcLen = readValue<uint16_t>(p);
+    if (p + funcLen > end)
+    {
+        return;
+    }
+    site.func.assign(p, funcLen);
+    (*sites)[id] = site;
+}
+
+// 与 Logger::Impl::formatTime 相同的时间前缀
+void formatTime(LogStream& stream, int64_t microSecondsSinceEpoch)
+{
+    time_t seconds = static_cast<time_t>(microSecondsSinceEpoch / 1000000);
+    int microseconds = static_cast<int>(microSecondsSinceEpoch % 1000000);
+    struct tm tm_time;
+    ::localtime_r(&seconds, &tm_time);
+    char buf[64];
+    int len = snprintf(buf, sizeof(buf), "%4d/%02d/%02d %02d:%02d:%02d.%06d ",
+        tm_time.tm_year + 1900,
+        tm_time.tm_mon + 1,
+        tm_time.tm_mday,
+        tm_time.tm_hour,
+        tm_time.tm_min,
+        tm_time.tm_sec,
+        microseconds);
+    stream.append(buf, len);
+}
+
+/**
+ * 把参数逐个按文本模式的规则输出
+ * 返回 false 表示参数数据损坏
+ */
+bool formatArgs(LogStream& stream, const char*& p, const char* end, int maxArgs)
+{
+    for (int i = 0; i != maxArgs && p < end; ++i)
+    {
+        uint8_t tag = readValue<uint8_t>(p);
+        size_t size = 0;
+        switch (tag)
+        {
+            case LogBinary::kInt32:  size = 4; break;
+            case LogBinary::kUInt32: size = 4; break;
+            case LogBinary::kInt64:  size = 8; break;
+            case LogBinary::kUInt64: size = 8; break;
+            case LogBinary::kDouble: size = 8; break;
+            case LogBinary::kChar:   size = 1; break;
+            case LogBinary::kString: size = 4; break;
+            default: return false;
+        }
+        if (p + size > end)
+        {
+            return false;
+        }
+        switch (tag)
+        {
+            case LogBinary::kInt32:  stream << readValue<int32_t>(p); break;
+            case LogBinary::kUInt32: stream << readValue<uint32_t>(p); break;
+            case LogBinary::kInt64:  stream << static_cast<long long>(readValue<int64_t>(p)); break;
+            case LogBinary::kUInt64: stream << static_cast<unsigned long long>(readValue<uint64_t>(p)); break;
+            case LogBinary::kDouble: stream << readValue<double>(p); break;
+            case LogBinary::kChar:   stream << readValue<char>(p); break;
+            case LogBinary::kString:
+            {
+                uint32_t len = readValue<uint32_t>(p);
+                if (p + len > end)
+                {
+                    return false;
+                }
+                stream.append(p, static_cast<int>(len));
+                p += len;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+void writeRecord(const SiteMap& sites, const char* p, size_t len, size_t* unknownSites)
+{
+    const char* end = p + len;
+    if (len < LogBinary::kLogRecordHeaderSize - LogBinary::kRecordHeaderSize)
+    {
+        return;
+    }
+    uint32_t siteId = readValue<uint32_t>(p);
+    int64_t microSecondsSinceEpoch = readValue<int64_t>(p);
+
+    LogStream stream;
+    formatTime(stream, microSecondsSinceEpoch);
+
+    std::string file;
+    long long line = 0;
+    if (siteId == 0)
+    {
+        // 没有静态调用点：前三个参数是 file、line、level
+        const char* q = p;
+        if (q + 5 <= end && static_cast<uint8_t>(*q) == LogBinary::kString)
+        {
+            ++q;
+            uint32_t fileLen = readValue<uint32_t>(q);
+            size_t n = std::min<size_t>(fileLen, end - q);
+            file.assign(q, n);
+            q += n;
+        }
+        if (q + 5 <= end && static_cast<uint8_t>(*q) == LogBinary::kInt32)
+        {
+            ++q;
+            line = readValue<int32_t>(q);
+        }
+        int level = 0;
+        if (q + 5 <= end && static_cast<uint8_t>(*q) == LogBinary::kInt32)
+        {
+            ++q;
+            level = readValue<int32_t>(q);
+        }
+        stream << (level >= 0 && level < 6 ? kLevelNames[level] : "?     ");
+        p = q;
+    }
+    else
+    {
+        auto it = sites.find(siteId);
+        if (it == sites.end())
+        {
+            ++*unknownSites;
+            stream << "?     ";
+        }
+        else
+        {
+            const Site& site = it->second;
+            stream << (site.level < 6 ? kLevelNames[site.level] : "?     ");
+            if (!site.func.empty())
+            {
+                stream << site.func << ' ';
+            }
+            file = site.file;
+            line = site.line;
+        }
+    }
+
+    if (!formatArgs(stream, p, end, -1))
+    {
+        stream << " <corrupted>";
+    }
+    stream << " - " << file << ':' << line << '\n';
+    ::fwrite(stream.buffer().data(), 1, stream.buffer().length(), stdout);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s binary-log-file...\n", argv[0]);
+        return 1;
+    }
+
+    // 第一遍收集所有调用点描述
+    SiteMap sites;
+    for (int i = 1; i < argc; ++i)
+    {
+        forEachRecord(argv[i], [&sites](uint8_t type, const char* p, size_t len) {
+            if (type == LogBinary::kSiteRecord)
+            {
+                readSite(&sites, p, len);
+            }
+        });
+    }
+
+    // 第二遍按文件中的顺序输出日志
+    size_t records = 0;
+    size_t unknownSites = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        forEachRecord(argv[i], [&](uint8_t type, const char* p, size_t len) {
+            if (type == LogBinary::kLogRecord)
+            {
+                writeRecord(sites, p, len, &unknownSites);
+                ++records;
+            }
+        });
+    }
+
+    if (unknownSites != 0)
+    {
+        fprintf(stderr, "LogDecoder: %zu of %zu records reference unknown call sites\n",
+                unknownSites, records);
+    }
+    return 0;
+}
@@ -0,0 +1,244 @@
+#include "HugePageAllocator.h"
+#include "SizeClassAllocator.h"
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unordered_map>
+
+namespace
+{
+
+const int kMinChunkShift = 12;
+const int kMaxChunkShift = 21;
+const int kNumChunkClasses = kMaxChunkShift - kMinChunkShift + 1;
+
+static_assert((1u << kMinChunkShift) == HugePageAllocator::kMinChunkSize, "min chunk size");
+static_assert((1u << kMaxChunkShift) == HugePageAllocator::kHugePageSize, "max chunk size");
+
+std::atomic_bool g_enabled(false);
+std::atomic<size_t> g_backingBytes[3];
+std::atomic<size_t> g_chunkBytesInUse(0);
+
+// 空闲块的前8字节存放下一个空闲块的地址
+struct FreeChunk
+{
+    FreeChunk* next;
+};
+
+// 每个映射区域使用的方式，解除映射时从统计中扣除
+std::mutex g_regionMutex;
+std::unordered_map<void*, HugePageAllocator::Backing>* g_regions =
+    new std::unordered_map<void*, HugePageAllocator::Backing>;
+
+std::mutex g_chunkMutex;
+FreeChunk* g_freeChunks[kNumChunkClasses];
+
+int chunkClass(size_t size)
+{
+    return 63 - __builtin_clzl(size) - kMinChunkShift;
+}
+
+size_t roundUp(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+size_t roundUpPowerOfTwo(size_t size)
+{
+    return size <= 1 ? 1 : static_cast<size_t>(1) << (64 - __builtin_clzl(size - 1));
+}
+
+// 普通匿名映射，多申请一个大页再裁掉首尾，保证按 kHugePageSize 对齐，透明大页才能整页合并
+void* mapAligned(size_t size)
+{
+    size_t mapped = size + HugePageAllocator::kHugePageSize;
+    void* p = ::mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+    {
+        return nullptr;
+    }
+    uintptr_t begin = reinterpret_cast<uintptr_t>(p);
+    uintptr_t aligned = roundUp(begin, HugePageAllocator::kHugePageSize);
+    if (aligned > begin)
+    {
+        ::munmap(p, aligned - begin);
+    }
+    size_t tail = begin + mapped - (aligned + size);
+    if (tail > 0)
+    {
+        ::munmap(reinterpret_cast<void*>(aligned + size), tail);
+    }
+    return reinterpret_cast<void*>(aligned);
+}
+
+// 读取 /proc/self/smaps_rollup 中某一项，单位 kB
+size_t readRollup(const char* buf, const char* key)
+{
+    const char* line = strstr(buf, key);
+    if (line == nullptr)
+    {
+        return 0;
+    }
+    unsigned long kb = 0;
+    sscanf(line + strlen(key), "%lu", &kb);
+    return kb * 1024;
+}
+
+} // namespace
+
+void HugePageAllocator::setEnabled(bool on)
+{
+    g_enabled = on;
+}
+
+bool HugePageAllocator::enabled()
+{
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+void* HugePageAllocator::mapRegion(size_t size, Backing* backing)
+{
+    size = roundUp(size, kHugePageSize);
+    Backing used = kHugeTlb;
+    void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p == MAP_FAILED)
+    {
+        p = mapAligned(size);
+        if (p == nullptr)
+        {
+            return nullptr;
+        }
+        used = ::madvise(p, size, MADV_HUGEPAGE) == 0 ? kTransparent : kNormal;
+    }
+    g_backingBytes[used] += size;
+    {
+        std::lock_guard<std::mutex> lock(g_regionMutex);
+        (*g_regions)[p] = used;
+    }
+    if (backing)
+    {
+        *backing = used;
+    }
+    return p;
+}
+
+void HugePageAllocator::unmapRegion(void* p, size_t size)
+{
+    size = roundUp(size, kHugePageSize);
+    {
+        std::lock_guard<std::mutex> lock(g_regionMutex);
+        auto it = g_regions->find(p);
+        if (it != g_regions->end())
+        {
+            g_backingBytes[it->second] -= size;
+            g_regions->erase(it);
+        }
+    }
+    ::munmap(p, size);
+}
+
+void* HugePageAllocator::allocateChunk(size_t size)
+{
+    int sizeClass = chunkClass(size);
+    std::lock_guard<std::mutex> lock(g_chunkMutex);
+    FreeChunk* chunk = g_freeChunks[sizeClass];
+    if (chunk == nullptr)
+    {
+        // 新区域整个切成这个大小的块
+        char* region = static_cast<char*>(mapRegion(kHugePageSize));
+        if (region == nullptr)
+        {
+            return nullptr;
+        }
+        for (size_t offset = kHugePageSize; offset > 0; offset -= size)
+        {
+            FreeChunk* free = reinterpret_cast<FreeChunk*>(region + offset - size);
+            free->next = chunk;
+            chunk = free;
+        }
+    }
+    g_freeChunks[sizeClass] = chunk->next;
+    g_chunkBytesInUse += size;
+    return chunk;
+}
+
+void HugePageAllocator::freeChunk(void* p, size_t size)
+{
+    FreeChunk* chunk = static_cast<FreeChunk*>(p);
+    int sizeClass = chunkClass(size);
+    std::lock_guard<std::mutex> lock(g_chunkMutex);
+    chunk->next = g_freeChunks[sizeClass];
+    g_freeChunks[sizeClass] = chunk;
+    g_chunkBytesInUse -= size;
+}
+
+void* HugePageAllocator::allocate(size_t size)
+{
+    if (size <= SizeClassAllocator::kMaxSmallSize)
+    {
+        return SizeClassAllocator::allocate(size);
+    }
+    if (size <= kHugePageSize)
+    {
+        return allocateChunk(roundUpPowerOfTwo(size));
+    }
+    return mapRegion(size);
+}
+
+void HugePageAllocator::deallocate(void* p, size_t size)
+{
+    if (size <= SizeClassAllocator::kMaxSmallSize)
+    {
+        SizeClassAllocator::deallocate(p);
+    }
+    else if (size <= kHugePageSize)
+    {
+        freeChunk(p, roundUpPowerOfTwo(size));
+    }
+    else
+    {
+        unmapRegion(p, size);
+    }
+}
+
+HugePageAllocator::Stats HugePageAllocator::stats()
+{
+    Stats stats;
+    stats.hugeTlbBytes = g_backingBytes[kHugeTlb];
+    stats.transparentBytes = g_backingBytes[kTransparent];
+    stats.normalBytes = g_backingBytes[kNormal];
+    stats.chunkBytesInUse = g_chunkBytesInUse;
+    stats.anonHugePagesBytes = 0;
+    stats.hugetlbResidentBytes = 0;
+
+    FILE* fp = ::fopen("/proc/self/smaps_rollup", "re");
+    if (fp)
+    {
+        char buf[4096];
+        size_t n = ::fread(buf, 1, sizeof(buf) - 1, fp);
+        buf[n] = '\0';
+        ::fclose(fp);
+        stats.anonHugePagesBytes = readRollup(buf, "AnonHugePages:");
+        stats.hugetlbResidentBytes = readRollup(buf, "Private_Hugetlb:") + readRollup(buf, "Shared_Hugetlb:");
+    }
+    return stats;
+}
+
+const char* HugePageAllocator::backingName(Backing backing)
+{
+    switch (backing)
+    {
+    case kHugeTlb:
+        return "hugetlb";
+    case kTransparent:
+        return "transparent";
+    default:
+        return "normal";
+    }
+}
@@ -0,0 +1,154 @@
+#ifndef HUGE_PAGE_ALLOCATOR_H
+#define HUGE_PAGE_ALLOCATOR_H
+
+#include "noncopyable.h"
+#include "MemoryStats.h"
+
+#include <new>
+#include <stddef.h>
+#include <type_traits>
+
+/**
+ * 大页内存，默认关闭，setEnabled(true) 之后新建的 MemoryPool、Buffer、日志暂存区才会使用
+ *
+ * 以 2MB 的区域为单位向系统申请：
+ *   先尝试 mmap(MAP_HUGETLB)，需要系统预留大页(vm.nr_hugepages)
+ *   失败则申请 2MB 对齐的普通匿名映射并 madvise(MADV_HUGEPAGE)，由内核的透明大页合并
+ *   madvise 也失败(透明大页为 never)时就是普通页
+ * 每个区域用的是哪一种记录在 stats() 中，透明大页实际是否生效看 anonHugePagesBytes
+ *
+ * allocateChunk 把区域切成 4KB~2MB 的2的幂大小的块，块按自身大小对齐，
+ * MemoryPool 的页、SizeClassAllocator 的 span 都从这里取
+ * 块释放后留在对应大小的空闲链表中复用，区域不归还给系统
+ */
+class HugePageAllocator : noncopyable
+{
+public:
+    enum Backing
+    {
+        kNormal,        // 普通 4KB 页
+        kTransparent,   // 已 madvise(MADV_HUGEPAGE)，由内核决定是否合并为大页
+        kHugeTlb,       // MAP_HUGETLB 预留大页
+    };
+
+    struct Stats
+    {
+        size_t hugeTlbBytes;        // MAP_HUGETLB 映射的字节数
+        size_t transparentBytes;    // madvise(MADV_HUGEPAGE) 的字节数
+        size_t normalBytes;         // 两者都失败的字节数
+        size_t chunkBytesInUse;     // 已经分配出去的块
+        size_t anonHugePagesBytes;  // /proc/self/smaps_rollup 中本进程实际由透明大页支撑的字节数
+        size_t hugetlbResidentBytes;// 同上，预留大页的字节数
+    };
+
+    static const size_t kHugePageSize = 2 * 1024 * 1024;
+    static const size_t kMinChunkSize = 4096;
+
+    static void setEnabled(bool on);
+    static bool enabled();
+
+    /**
+     * 直接映射 size 字节(向上取整到 kHugePageSize)，按 kHugePageSize 对齐
+     * @param[out] backing 可以为空，返回实际使用的方式
+     */
+    static void* mapRegion(size_t size, Backing* backing = nullptr);
+    static void unmapRegion(void* p, size_t size);
+
+    /**
+     * 从大页区域中分配 size 字节，size 必须是 kMinChunkSize 到 kHugePageSize 之间的2的幂
+     * 释放时传入相同的 size
+     */
+    static void* allocateChunk(size_t size);
+    static void freeChunk(void* p, size_t size);
+
+    /**
+     * 任意大小，释放时传入相同的 size：
+     *   不超过 SizeClassAllocator::kMaxSmallSize 的交给 SizeClassAllocator，它的 span 来自大页区域
+     *   不超过 kHugePageSize 的取整到2的幂后 allocateChunk
+     *   更大的单独 mapRegion
+     */
+    static void* allocate(size_t size);
+    static void deallocate(void* p, size_t size);
+
+    static Stats stats();
+    static const char* backingName(Backing backing);
+};
+
+/**
+ * 标准库容器使用的分配器，构造时 HugePageAllocator 开启则从大页分配，否则使用 operator new
+ * 之后再开关大页模式不影响已经构造的分配器，释放总是走分配时的路径
+ * 分配的字节数计入 MemoryStats 的 Subsystem 一项
+ */
+template <typename T, int Subsystem = MemoryStats::kOther>
+class HugePageStlAllocator
+{
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = HugePageStlAllocator<U, Subsystem>;
+    };
+
+    HugePageStlAllocator() noexcept
+        : huge_(HugePageAllocator::enabled())
+    {
+    }
+
+    template <typename U>
+    HugePageStlAllocator(const HugePageStlAllocator<U, Subsystem>& other) noexcept
+        : huge_(other.huge())
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        MemoryStats::record(static_cast<MemoryStats::Subsystem>(Subsystem), n * sizeof(T));
+        if (!huge_)
+        {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        void* p = HugePageAllocator::allocate(n * sizeof(T));
+        if (p == nullptr)
+        {
+            MemoryStats::record(static_cast<MemoryStats::Subsystem>(Subsystem), -static_cast<int64_t>(n * sizeof(T)));
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_t n) noexcept
+    {
+        MemoryStats::record(static_cast<MemoryStats::Subsystem>(Subsystem), -static_cast<int64_t>(n * sizeof(T)));
+        if (huge_)
+        {
+            HugePageAllocator::deallocate(p, n * sizeof(T));
+        }
+        else
+        {
+            ::operator delete(p);
+        }
+    }
+
+    bool huge() const noexcept { return huge_; }
+
+private:
+    bool huge_;
+};
+
+template <typename T, typename U, int Subsystem>
+bool operator==(const HugePageStlAllocator<T, Subsystem>& lhs, const HugePageStlAllocator<U, Subsystem>& rhs) noexcept
+{
+    return lhs.huge() == rhs.huge();
+}
+
+template <typename T, typename U, int Subsystem>
+bool operator!=(const HugePageStlAllocator<T, Subsystem>& lhs, const HugePageStlAllocator<U, Subsystem>& rhs) noexcept
+{
+    return lhs.huge() != rhs.huge();
+}
+
+#endif // HUGE_PAGE_ALLOCATOR_H
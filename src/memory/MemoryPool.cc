@@ -1,10 +1,18 @@
 #include "MemoryPool.h"
+#include "SizeClassAllocator.h"
+#include "HugePageAllocator.h"
+#include "MemoryStats.h"
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
-void MemoryPool::createPool()
+void MemoryPool::createPool(Mode mode)
 {
+    mode_ = mode;
+    hugePages_ = HugePageAllocator::enabled();
+    reservedBytes_ = 0;
+    peakReservedBytes_ = 0;
     // if (size < PAGE_SIZE || size % PAGE_SIZE != 0)
     // {
     //     size = PAGE_SIZE;
@@ -14,20 +22,24 @@ void MemoryPool::createPool()
      * int posix_memalign (void **memptr, size_t alignment, size_t size);
      * posix_memalign分配的内存块更大，malloc可能分配不了太大的内存块
      * 内部要让这个p指针指向新的内存，所以需要使用二级指针。如果只是返回一个指针，可以使
+     * 按 PAGE_SIZE 对齐，释放时由地址直接算出所在的块
      */
-    int ret = posix_memalign((void **)&pool_, MP_ALIGNMENT, PAGE_SIZE);
-    if (ret) 
+    pool_ = (Pool*)allocBlock();
+    if (pool_ == nullptr) 
     {
-        printf("posix_memalign failed\n");
+        printf("createPool: allocate block failed\n");
         return;
     }
 
     // 分配 PAGE_SIZE 内存：Pool + SmallNode + 剩余可用内存
     pool_->largeList_ = nullptr;
+    pool_->freeLarge_ = nullptr;
     pool_->head_ = (SmallNode *)((unsigned char*)pool_ + sizeof(Pool));
     pool_->head_->last_ = (unsigned char*)pool_ + sizeof(Pool) + sizeof(SmallNode);
     pool_->head_->end_ = (unsigned char*)pool_ + PAGE_SIZE;
+    pool_->head_->quote_ = 0;
     pool_->head_->failed_ = 0;
+    pool_->head_->next_ = nullptr;
     pool_->current_ = pool_->head_;
 
     return;
@@ -38,77 +50,99 @@ void MemoryPool::destroyPool()
     LargeNode* large = pool_->largeList_;
     while (large != nullptr)
     {
-        if (large->address_ != nullptr)
-        {
-            free(large->address_);
-            large->address_ = nullptr;
-        }
+        free(large->address_);
+        account(-(long)(kLargeHeaderSize + large->size_));
         large = large->next_;
     }
 
     SmallNode* cur = pool_->head_->next_;
-    SmallNode* next = nullptr;
     while (cur != nullptr)
     {
-        next = cur->next_;
-        free(cur);
-        cur = cur->next_;
+        SmallNode* next = cur->next_;
+        freeBlock(cur);
+        cur = next;
     }
-    // TODO:有错误
-    free(pool_);
+    freeBlock(pool_);
+    pool_ = nullptr;
 }
 
-// 分配大块内存
+/**
+ * 分配大块内存
+ * 大块按 PAGE_SIZE 对齐，前 kLargeHeaderSize 字节存放 LargeNode 指针，返回地址在页内偏移为 kLargeHeaderSize
+ * 小块内存的地址在页内偏移至少为 sizeof(SmallNode)，释放时据此区分大小块，不需要遍历链表
+ * largeList_ 为双向链表，释放时 O(1) 摘除，节点放入 freeLarge_ 供下次复用
+ */
 void* MemoryPool::mallocLargeNode(unsigned long size)
 {
-    unsigned char* addr;
-    int ret = posix_memalign((void**)&addr, MP_ALIGNMENT, size);
+    unsigned char* block;
+    int ret = posix_memalign((void**)&block, PAGE_SIZE, kLargeHeaderSize + size);
     if (ret)
     {
         return nullptr;
     }
+    account(kLargeHeaderSize + size);
 
-    int count = 0;
-    LargeNode* largeNode = pool_->largeList_;
-    while (largeNode != nullptr)
+    LargeNode* largeNode = pool_->freeLarge_;
+    if (largeNode != nullptr)
     {
-        if (largeNode->address_ == nullptr)
-        {
-            largeNode->size_ = size;
-            largeNode->address_ = addr;
-            return addr;
-        }
-        if (count++ > 3)
+        pool_->freeLarge_ = largeNode->next_;
+    }
+    else
+    {
+        // 没有可以复用的节点，从小块内存中分配一个新的
+        largeNode = (LargeNode*)this->malloc(sizeof(LargeNode));
+        if (largeNode == nullptr)
         {
-            // 为了避免过多的遍历，限制次数
-            break;
+            free(block); // 申请节点内存失败，需要释放之前申请的大内存
+            account(-(long)(kLargeHeaderSize + size));
+            return nullptr;
         }
-        largeNode = largeNode->next_;
     }
 
-    // 没有找到空闲的large结构体，分配一个新的large
-    // 比如第一次分配large的时候
-    largeNode = (LargeNode*)this->malloc(sizeof(LargeNode));
-    if (largeNode == nullptr)
+    largeNode->size_ = size;     // 设置新块大小
+    largeNode->address_ = block; // 设置新块地址
+    // 下面用头插法方式将新块加入到 largeList 的头部
+    largeNode->prev_ = nullptr;
+    largeNode->next_ = pool_->largeList_;
+    if (pool_->largeList_ != nullptr)
     {
-        free(addr); // 申请节点内存失败，需要释放之前申请的大内存
-        return nullptr;
+        pool_->largeList_->prev_ = largeNode;
     }
-
-    largeNode->size_ = size;    // 设置新块大小
-    largeNode->address_ = addr; // 设置新块地址
-    // 下面用头插法方式将新块加入到 largeList 的头部
-    largeNode->next_ = pool_->largeList_; 
     pool_->largeList_ = largeNode;
-    return addr;
+
+    *(LargeNode**)block = largeNode;
+    return block + kLargeHeaderSize;
+}
+
+void MemoryPool::freeLargeNode(LargeNode* large)
+{
+    free(large->address_);
+    account(-(long)(kLargeHeaderSize + large->size_));
+    large->address_ = nullptr;
+    large->size_ = 0;
+
+    if (large->prev_ != nullptr)
+    {
+        large->prev_->next_ = large->next_;
+    }
+    else
+    {
+        pool_->largeList_ = large->next_;
+    }
+    if (large->next_ != nullptr)
+    {
+        large->next_->prev_ = large->prev_;
+    }
+
+    large->next_ = pool_->freeLarge_;
+    pool_->freeLarge_ = large;
 }
 
 // 分配小块内存
 void* MemoryPool::mallocSmallNode(unsigned long size)
 {
-    unsigned char* block;
-    int ret = posix_memalign((void**)&block, MP_ALIGNMENT, PAGE_SIZE);
-    if (ret)
+    unsigned char* block = (unsigned char*)allocBlock();
+    if (block == nullptr)
     {
         return nullptr;
     }
@@ -117,11 +151,12 @@ void* MemoryPool::mallocSmallNode(unsigned long size)
     SmallNode* smallNode = (SmallNode*)block;
     smallNode->end_ = block + PAGE_SIZE;
     smallNode->next_ = nullptr;
+    smallNode->failed_ = 0;
 
     // 分配新块的起始位置
     unsigned char* addr = (unsigned char*)mp_align_ptr(block + sizeof(SmallNode), MP_ALIGNMENT);
     smallNode->last_ = addr + size;
-    smallNode->quote_++;
+    smallNode->quote_ = 1;
 
     // 重新设置current
     SmallNode* current = pool_->current_;
@@ -150,6 +185,16 @@ void* MemoryPool::malloc(unsigned long size)
         return nullptr;
     }
 
+    if (mode_ == kGeneral)
+    {
+        void* p = SizeClassAllocator::allocate(size);
+        if (p != nullptr)
+        {
+            MemoryStats::record(MemoryStats::kMemoryPool, SizeClassAllocator::usableSize(p));
+        }
+        return p;
+    }
+
     // 申请大块内存
     if (size > PAGE_SIZE - sizeof(SmallNode))
     {
@@ -192,44 +237,46 @@ void* MemoryPool::calloc(unsigned long size)
 
 void MemoryPool::freeMemory(void* p)
 {
-    LargeNode* large = pool_->largeList_;
-    while (large != nullptr)
+    if (mode_ == kGeneral)
     {
-        if (large->address_ == p)
+        if (p != nullptr)
         {
-            free(large->address_);
-            large->size_ = 0;
-            large->address_ = nullptr;
-            return;
+            MemoryStats::record(MemoryStats::kMemoryPool, -(int64_t)SizeClassAllocator::usableSize(p));
         }
-        large = large->next_;
+        SizeClassAllocator::deallocate(p);
+        return;
     }
 
-    SmallNode* small = pool_->head_;
-    while (small != nullptr)
+    if (p == nullptr)
     {
-        if ((unsigned char*)small <= (unsigned char*)p &&
-            (unsigned char *) p <= (unsigned char *)small->end_)
+        return;
+    }
+
+    // 页内偏移为 kLargeHeaderSize 的是大块，块头存放着它的节点
+    unsigned char* page = (unsigned char*)((size_t)p & ~(size_t)(PAGE_SIZE - 1));
+    if ((unsigned char*)p - page == kLargeHeaderSize)
+    {
+        freeLargeNode(*(LargeNode**)page);
+        return;
+    }
+
+    // 小块按 PAGE_SIZE 对齐，第一块的 SmallNode 位于 Pool 之后
+    SmallNode* small = (page == (unsigned char*)pool_) ? pool_->head_ : (SmallNode*)page;
+    small->quote_--;
+    // 引用计数为0才释放
+    if (small->quote_ == 0)
+    {
+        if (small == pool_->head_)
         {
-            small->quote_--;
-            // 引用计数为0才释放
-            if (small->quote_ == 0)
-            {
-                if (small == pool_->head_)
-                {
-                    pool_->head_->last_ = (unsigned char *)pool_ + sizeof(Pool) + sizeof(SmallNode);
-                }
-                else
-                {
-                    // last指针回到node节点尾处
-                    small->last_ = (unsigned char *)small + sizeof(SmallNode);
-                }
-                small->failed_ = 0;
-                pool_->current_ = pool_->head_;
-            }
-            return;
+            pool_->head_->last_ = (unsigned char *)pool_ + sizeof(Pool) + sizeof(SmallNode);
         }
-        small = small->next_;
+        else
+        {
+            // last指针回到node节点尾处
+            small->last_ = (unsigned char *)small + sizeof(SmallNode);
+        }
+        small->failed_ = 0;
+        pool_->current_ = pool_->head_;
     }
 }
 
@@ -240,14 +287,14 @@ void MemoryPool::resetPool()
 
     while (large != nullptr)
     {
-        if (large->address_)
-        {
-            free(large->address_);
-        }
+        free(large->address_);
+        account(-(long)(kLargeHeaderSize + large->size_));
         large = large->next_;
     }
 
+    // 节点本身位于小块内存中，随小块一起重置
     pool_->largeList_ = nullptr;
+    pool_->freeLarge_ = nullptr;
     pool_->current_ = pool_->head_;
     while (small != nullptr)
     {
@@ -258,3 +305,112 @@ void MemoryPool::resetPool()
     }
 }
 
+int MemoryPool::smallBlocks(bool inUse) const
+{
+    int count = 0;
+    for (SmallNode* small = pool_->head_; small != nullptr; small = small->next_)
+    {
+        if (!inUse || small->quote_ > 0)
+        {
+            ++count;
+        }
+    }
+    return count;
+}
+
+void MemoryPool::trimPool(int keepBlocks)
+{
+    SmallNode* last = pool_->head_;
+    for (int i = 1; i < keepBlocks && last->next_ != nullptr; ++i)
+    {
+        last = last->next_;
+    }
+
+    SmallNode* cur = last->next_;
+    last->next_ = nullptr;
+    while (cur != nullptr)
+    {
+        SmallNode* next = cur->next_;
+        freeBlock(cur);
+        cur = next;
+    }
+    pool_->current_ = pool_->head_;
+}
+
+void* MemoryPool::allocBlock()
+{
+    void* block = nullptr;
+    if (hugePages_)
+    {
+        block = HugePageAllocator::allocateChunk(PAGE_SIZE);
+    }
+    else if (posix_memalign(&block, PAGE_SIZE, PAGE_SIZE) != 0)
+    {
+        block = nullptr;
+    }
+    if (block != nullptr)
+    {
+        account(PAGE_SIZE);
+    }
+    return block;
+}
+
+void MemoryPool::freeBlock(void* block)
+{
+    account(-PAGE_SIZE);
+    if (hugePages_)
+    {
+        HugePageAllocator::freeChunk(block, PAGE_SIZE);
+    }
+    else
+    {
+        free(block);
+    }
+}
+
+
+void MemoryPool::account(long bytes)
+{
+    reservedBytes_ += bytes;
+    if (reservedBytes_ > peakReservedBytes_)
+    {
+        peakReservedBytes_ = reservedBytes_;
+    }
+    MemoryStats::record(MemoryStats::kMemoryPool, bytes);
+}
+
+MemoryPool::Stats MemoryPool::stats() const
+{
+    Stats stats = {};
+    stats.reservedBytes = reservedBytes_;
+    stats.peakReservedBytes = peakReservedBytes_;
+    if (mode_ == kGeneral || pool_ == nullptr)
+    {
+        return stats;
+    }
+
+    for (SmallNode* small = pool_->head_; small != nullptr; small = small->next_)
+    {
+        // 第一块的可用内存从 Pool 和 SmallNode 之后开始
+        unsigned char* begin = (small == pool_->head_)
+            ? (unsigned char*)pool_ + sizeof(Pool) + sizeof(SmallNode)
+            : (unsigned char*)small + sizeof(SmallNode);
+        stats.usedBytes += small->last_ - begin;
+        stats.smallBlocks++;
+        if (small->quote_ > 0)
+        {
+            stats.smallBlocksInUse++;
+        }
+        stats.failedTotal += small->failed_;
+        if (small->failed_ >= 5)
+        {
+            stats.failedBlocks++;
+        }
+    }
+    for (LargeNode* large = pool_->largeList_; large != nullptr; large = large->next_)
+    {
+        stats.usedBytes += large->size_;
+        stats.largeBlocks++;
+    }
+    return stats;
+}
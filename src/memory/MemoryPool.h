@@ -17,14 +17,16 @@ struct SmallNode
 
 struct LargeNode
 {
-    void* address_;          // 该块的起始地址
-    unsigned int size_;      // 该块大小
-    struct LargeNode* next_; // 指向下一个大块
+    void* address_;          // 该块的起始地址(含块头)
+    unsigned long size_;     // 该块大小
+    struct LargeNode* prev_; // 指向上一个大块
+    struct LargeNode* next_; // 指向下一个大块，空闲节点链表也使用它
 };
 
 struct Pool
 {
     LargeNode* largeList_;   // 管理大块内存链表
+    LargeNode* freeLarge_;   // 已释放、可以复用的大块节点
     SmallNode* head_;        // 头节点
     SmallNode* current_;     // 指向当前分配的块，这样可以避免遍历前面已经不能分配的块  
 };
@@ -32,6 +34,39 @@ struct Pool
 class MemoryPool
 {
 public:
+    /**
+     * kArena   从大块内存中顺序切分，适合生命周期相同的一批对象，resetPool 一次性回收
+     * kGeneral 通用模式，按大小类别分配，带线程缓存，可以多线程使用，freeMemory 立即回收小块内存
+     *          见 SizeClassAllocator，resetPool 对该模式无效，对象需要逐个 freeMemory
+     */
+    enum Mode
+    {
+        kArena,
+        kGeneral,
+    };
+
+    /**
+     * kArena 模式下单个内存池的统计，stats() 遍历小块和大块链表得到
+     * kGeneral 模式的对象由多个线程共享分配，不按池统计，见 MemoryStats::kMemoryPool
+     */
+    struct Stats
+    {
+        unsigned long reservedBytes;     // 向系统申请的字节数，小块按 PAGE_SIZE 计，大块含块头
+        unsigned long usedBytes;         // 小块中已经切出去的字节数加上大块的大小
+        unsigned long peakReservedBytes; // reservedBytes 的最高值，destroyPool 之前一直保留
+        int smallBlocks;                 // 小块数，包括 Pool 所在的第一块
+        int smallBlocksInUse;            // 还有内存没有释放的小块数
+        int largeBlocks;                 // 当前存活的大块数
+        unsigned long failedTotal;       // 所有小块 failed_ 之和，越大说明分配越容易跳过已满的块
+        int failedBlocks;                // failed_ 达到阈值、分配时会被跳过的小块数
+
+        // 已申请但没有切出去的比例，包括小块尾部放不下的部分和对齐的空洞
+        double fragmentation() const
+        {
+            return reservedBytes == 0 ? 0.0 : 1.0 - static_cast<double>(usedBytes) / reservedBytes;
+        }
+    };
+
     /**
      * @brief 默认构造，真正初始化工作交给 createPool
      */
@@ -44,8 +79,10 @@ public:
 
     /**
      * @brief 初始化内存池，为 pool_ 分配 PAGE_SIZE 内存
+     *        HugePageAllocator 开启时，之后的小块内存都从大页区域中分配，大块内存不受影响
+     * @param[in] mode 分配模式
      */
-    void createPool();
+    void createPool(Mode mode = kArena);
 
     /**
      * @brief 销毁内存池，遍历大块内存和小块内存且释放它们
@@ -75,7 +112,25 @@ public:
      */    
     void resetPool();
 
+    /**
+     * @brief 小块内存的块数，包括 Pool 所在的第一块
+     * @param[in] inUse 为 true 时只统计还有内存没有释放的块
+     */
+    int smallBlocks(bool inUse = false) const;
+
+    /**
+     * @brief 只保留前 keepBlocks 个小块，其余还给系统，在 resetPool 之后调用
+     * @param[in] keepBlocks 保留的块数，至少保留第一块
+     */
+    void trimPool(int keepBlocks);
+
+    /**
+     * @brief 本内存池的统计，只能在使用内存池的线程调用
+     */
+    Stats stats() const;
+
     Pool* getPool() { return pool_; }
+    Mode mode() const { return mode_; }
 
 private:
     /**
@@ -84,13 +139,33 @@ private:
      */
     void* mallocLargeNode(unsigned long size);
 
+    /**
+     * @brief 释放大块内存并回收节点，被 freeMemory 调用
+     * @param[in] large 大块节点
+     */
+    void freeLargeNode(LargeNode* large);
+
     /**
      * @brief 分配小块节点，被 malloc 调用
      * @param[in] size 分配内存大小
      */
     void* mallocSmallNode(unsigned long size);
-    
+
+    // 申请和释放一个 PAGE_SIZE 的小块，大页模式下来自 HugePageAllocator
+    void* allocBlock();
+    void freeBlock(void* block);
+
+    // 记录向系统申请(bytes > 0)或归还的字节数，同时计入 MemoryStats
+    void account(long bytes);
+
+    // 大块内存的块头大小，保持 MP_ALIGNMENT 对齐
+    static const int kLargeHeaderSize = MP_ALIGNMENT;
+
     Pool* pool_ = nullptr;    
+    Mode mode_ = kArena;
+    bool hugePages_ = false;    // createPool 时 HugePageAllocator 是否开启
+    unsigned long reservedBytes_ = 0;
+    unsigned long peakReservedBytes_ = 0;
 };
 
 #endif // _MEMORY_POOL_H
\ No newline at end of file
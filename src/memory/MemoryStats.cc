@@ -0,0 +1,244 @@
+#include "MemoryStats.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+__thread MemoryStats::ThreadCounters* MemoryStats::t_counters __attribute__((tls_model("initial-exec"))) = nullptr;
+__thread bool MemoryStats::t_exited __attribute__((tls_model("initial-exec"))) = false;
+__thread MemoryStats::SharedCounters* MemoryStats::t_shared __attribute__((tls_model("initial-exec"))) = nullptr;
+
+namespace
+{
+
+/**
+ * 所有线程的计数器块，进程退出时线程可能还在释放内存，故意不析构
+ * retired 汇总已经退出的线程的计数
+ */
+struct Registry
+{
+    std::mutex mutex;
+    std::vector<MemoryStats::ThreadCounters*> active;
+    MemoryStats::ThreadCounters* freeList = nullptr;
+    MemoryStats::Snapshot retired = {};
+    std::atomic<int64_t> peakBytes[MemoryStats::kNumSubsystems] = {};
+};
+
+Registry* registry()
+{
+    static Registry* instance = new Registry;
+    return instance;
+}
+
+void clear(MemoryStats::ThreadCounters* counters)
+{
+    for (int i = 0; i < MemoryStats::kNumSubsystems; ++i)
+    {
+        counters->bytes[i] = 0;
+        counters->allocations[i] = 0;
+        counters->totalAllocations[i] = 0;
+        counters->peakBytes[i] = 0;
+    }
+    counters->nextFree = nullptr;
+}
+
+void accumulate(MemoryStats::Snapshot* snapshot, const MemoryStats::ThreadCounters* counters)
+{
+    for (int i = 0; i < MemoryStats::kNumSubsystems; ++i)
+    {
+        MemoryStats::Counters& sum = snapshot->subsystems[i];
+        sum.bytes += counters->bytes[i].load(std::memory_order_relaxed);
+        sum.allocations += counters->allocations[i].load(std::memory_order_relaxed);
+        sum.totalAllocations += counters->totalAllocations[i].load(std::memory_order_relaxed);
+        sum.peakBytes = std::max(sum.peakBytes, counters->peakBytes[i].load(std::memory_order_relaxed));
+    }
+}
+
+// 计数并入 retired，从 active 中移除，调用时持有 reg->mutex
+void retire(Registry* reg, MemoryStats::ThreadCounters* counters)
+{
+    for (int i = 0; i < MemoryStats::kNumSubsystems; ++i)
+    {
+        MemoryStats::Counters& retired = reg->retired.subsystems[i];
+        retired.bytes += counters->bytes[i];
+        retired.allocations += counters->allocations[i];
+        retired.totalAllocations += counters->totalAllocations[i];
+        retired.peakBytes = std::max(retired.peakBytes, counters->peakBytes[i].load());
+    }
+    reg->active.erase(std::find(reg->active.begin(), reg->active.end(), counters));
+}
+
+// 线程退出过程中(计数器块已归还之后)的记录使用的公共计数器块
+MemoryStats::ThreadCounters* g_exitedCounters = nullptr;
+
+} // namespace
+
+// 线程退出时把计数并入 retired，计数器块放回空闲链表
+struct MemoryStats::ThreadCountersHolder
+{
+    ThreadCounters* counters = nullptr;
+
+    ~ThreadCountersHolder()
+    {
+        if (counters == nullptr)
+        {
+            return;
+        }
+        Registry* reg = registry();
+        std::lock_guard<std::mutex> lock(reg->mutex);
+        retire(reg, counters);
+        clear(counters);
+        counters->nextFree = reg->freeList;
+        reg->freeList = counters;
+        t_counters = nullptr;
+        t_exited = true;
+    }
+};
+
+thread_local MemoryStats::ThreadCountersHolder MemoryStats::t_holder;
+
+MemoryStats::ThreadCounters* MemoryStats::threadCounters()
+{
+    if (t_counters)
+    {
+        return t_counters;
+    }
+    Registry* reg = registry();
+    std::lock_guard<std::mutex> lock(reg->mutex);
+    if (t_exited)
+    {
+        // 线程正在退出，计数器块已经归还，只能记到一个公共块上，由多个线程写入时计数不保证精确
+        if (g_exitedCounters == nullptr)
+        {
+            g_exitedCounters = new ThreadCounters;
+            clear(g_exitedCounters);
+            reg->active.push_back(g_exitedCounters);
+        }
+        return g_exitedCounters;
+    }
+
+    ThreadCounters* counters = reg->freeList;
+    if (counters)
+    {
+        reg->freeList = counters->nextFree;
+    }
+    else
+    {
+        counters = new ThreadCounters;
+    }
+    clear(counters);
+    reg->active.push_back(counters);
+    t_holder.counters = counters;
+    t_counters = counters;
+    return counters;
+}
+
+MemoryStats::Snapshot MemoryStats::snapshot()
+{
+    Registry* reg = registry();
+    Snapshot result;
+    {
+        std::lock_guard<std::mutex> lock(reg->mutex);
+        result = reg->retired;
+        for (const ThreadCounters* counters : reg->active)
+        {
+            accumulate(&result, counters);
+        }
+    }
+    for (int i = 0; i < kNumSubsystems; ++i)
+    {
+        Counters& sum = result.subsystems[i];
+        int64_t peak = reg->peakBytes[i].load(std::memory_order_relaxed);
+        while (sum.bytes > peak && !reg->peakBytes[i].compare_exchange_weak(peak, sum.bytes))
+        {
+        }
+        sum.peakBytes = std::max(sum.peakBytes, std::max(peak, sum.bytes));
+    }
+    return result;
+}
+
+MemoryStats::Snapshot MemoryStats::snapshot(const ThreadCounters* counters)
+{
+    Snapshot result = {};
+    accumulate(&result, counters);
+    return result;
+}
+
+MemoryStats::SharedCounters::SharedCounters()
+    : counters_(new ThreadCounters)
+{
+    clear(counters_);
+    Registry* reg = registry();
+    std::lock_guard<std::mutex> lock(reg->mutex);
+    reg->active.push_back(counters_);
+}
+
+MemoryStats::SharedCounters::~SharedCounters()
+{
+    Registry* reg = registry();
+    {
+        std::lock_guard<std::mutex> lock(reg->mutex);
+        retire(reg, counters_);
+    }
+    delete counters_;
+}
+
+void MemoryStats::recordShared(SharedCounters* shared, Subsystem subsystem, int64_t bytes)
+{
+    // 多个线程同时写，不能用 add 的读改写
+    ThreadCounters* counters = shared->counters_;
+    int64_t current = counters->bytes[subsystem].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    if (bytes > 0)
+    {
+        counters->allocations[subsystem].fetch_add(1, std::memory_order_relaxed);
+        counters->totalAllocations[subsystem].fetch_add(1, std::memory_order_relaxed);
+        int64_t peak = counters->peakBytes[subsystem].load(std::memory_order_relaxed);
+        while (current > peak && !counters->peakBytes[subsystem].compare_exchange_weak(peak, current, std::memory_order_relaxed))
+        {
+        }
+    }
+    else
+    {
+        counters->allocations[subsystem].fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void MemoryStats::Snapshot::add(const Snapshot& other)
+{
+    for (int i = 0; i < kNumSubsystems; ++i)
+    {
+        Counters& sum = subsystems[i];
+        const Counters& counters = other.subsystems[i];
+        sum.bytes += counters.bytes;
+        sum.allocations += counters.allocations;
+        sum.totalAllocations += counters.totalAllocations;
+        sum.peakBytes = std::max(sum.peakBytes, counters.peakBytes);
+    }
+}
+
+int64_t MemoryStats::Snapshot::totalBytes() const
+{
+    int64_t total = 0;
+    for (const Counters& counters : subsystems)
+    {
+        total += counters.bytes;
+    }
+    return total;
+}
+
+const char* MemoryStats::subsystemName(Subsystem subsystem)
+{
+    switch (subsystem)
+    {
+    case kMemoryPool:
+        return "memory_pool";
+    case kBuffer:
+        return "buffer";
+    case kAsyncLogging:
+        return "async_logging";
+    case kConnection:
+        return "connection";
+    default:
+        return "other";
+    }
+}
@@ -0,0 +1,165 @@
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <stdint.h>
+
+/**
+ * 按子系统统计内存占用，可以一直开着
+ *
+ * 每个线程有自己的一组计数器，只由本线程写，写入是一次普通的 relaxed 读改写，没有锁和原子加
+ * 读取时把所有线程的计数器加起来，线程退出时把计数并入公共的一组后释放，计数器块可以被新线程复用
+ *
+ * 内存可能在一个线程申请、在另一个线程释放，单个线程的字节数可能为负，只有总和是准确的
+ * 属于某个对象而不是某个线程的内存(例如 TcpConnection 在 mainLoop 创建、可能在任意线程释放)
+ * 用 SharedCounters 统计，ScopedCounters 范围内本线程的记录都计入它，见 EventLoop::memoryStats()
+ */
+class MemoryStats : noncopyable
+{
+public:
+    enum Subsystem
+    {
+        kMemoryPool,    // MemoryPool 的小块、大块以及 kGeneral 模式的对象
+        kBuffer,        // 连接的输入输出 Buffer
+        kAsyncLogging,  // 异步日志的暂存区和批量写缓冲区
+        kConnection,    // TcpConnection 的内存块(含 TcpConnectionSlabPool 缓存)
+        kOther,
+        kNumSubsystems,
+    };
+
+    struct Counters
+    {
+        int64_t bytes;              // 当前占用的字节数
+        int64_t allocations;        // 当前存活的分配次数
+        int64_t totalAllocations;   // 累计分配次数
+        int64_t peakBytes;          // 字节数的最高值
+    };
+
+    struct Snapshot
+    {
+        Counters subsystems[kNumSubsystems];
+        int64_t totalBytes() const;
+        // 加上另一组计数，peakBytes 取两者中较大的
+        void add(const Snapshot& other);
+    };
+
+    /**
+     * 每个线程一个计数器块，本线程第一次调用 record 时分配
+     */
+    struct ThreadCounters
+    {
+        std::atomic<int64_t> bytes[kNumSubsystems];
+        std::atomic<int64_t> allocations[kNumSubsystems];
+        std::atomic<int64_t> totalAllocations[kNumSubsystems];
+        std::atomic<int64_t> peakBytes[kNumSubsystems];
+        ThreadCounters* nextFree;
+    };
+
+    class SharedCounters;
+
+    /**
+     * 记录一次分配(bytes > 0)或释放(bytes < 0)
+     */
+    static void record(Subsystem subsystem, int64_t bytes)
+    {
+        if (t_shared)
+        {
+            recordShared(t_shared, subsystem, bytes);
+            return;
+        }
+        ThreadCounters* counters = t_counters ? t_counters : threadCounters();
+        int64_t current = add(&counters->bytes[subsystem], bytes);
+        if (bytes > 0)
+        {
+            add(&counters->allocations[subsystem], 1);
+            add(&counters->totalAllocations[subsystem], 1);
+            if (current > counters->peakBytes[subsystem].load(std::memory_order_relaxed))
+            {
+                counters->peakBytes[subsystem].store(current, std::memory_order_relaxed);
+            }
+        }
+        else
+        {
+            add(&counters->allocations[subsystem], -1);
+        }
+    }
+
+    /**
+     * 所有线程的总和
+     * 每个线程只有自己的最高值，总的 peakBytes 取每次读取时见到的最大总和，以及任一线程的最高值中较大者
+     */
+    static Snapshot snapshot();
+
+    /**
+     * 某个线程的计数，用于按 EventLoop 统计，counters 来自该线程调用 threadCounters()
+     */
+    static Snapshot snapshot(const ThreadCounters* counters);
+
+    // 本线程的计数器块，没有则分配
+    static ThreadCounters* threadCounters();
+
+    static const char* subsystemName(Subsystem subsystem);
+
+    /**
+     * 不属于某个线程的一组计数器，可以在任意线程记录，计入 snapshot() 的总和
+     * 记录使用原子加，比线程计数器慢，只用于创建、销毁这类不频繁的操作
+     * 析构时计数并入公共的一组
+     */
+    class SharedCounters : noncopyable
+    {
+    public:
+        SharedCounters();
+        ~SharedCounters();
+
+        void record(Subsystem subsystem, int64_t bytes) { recordShared(this, subsystem, bytes); }
+        Snapshot snapshot() const { return MemoryStats::snapshot(counters_); }
+
+    private:
+        friend class MemoryStats;
+        ThreadCounters* counters_;
+    };
+
+    /**
+     * 范围内本线程的 record 都计入 counters，离开时恢复，可以嵌套
+     */
+    class ScopedCounters : noncopyable
+    {
+    public:
+        explicit ScopedCounters(SharedCounters* counters)
+            : saved_(t_shared)
+        {
+            t_shared = counters;
+        }
+
+        ~ScopedCounters()
+        {
+            t_shared = saved_;
+        }
+
+    private:
+        SharedCounters* saved_;
+    };
+
+private:
+    static void recordShared(SharedCounters* shared, Subsystem subsystem, int64_t bytes);
+
+    // 只有本线程写，不需要 lock 前缀的原子加
+    static int64_t add(std::atomic<int64_t>* counter, int64_t delta)
+    {
+        int64_t value = counter->load(std::memory_order_relaxed) + delta;
+        counter->store(value, std::memory_order_relaxed);
+        return value;
+    }
+
+    // 线程退出时归还计数器块
+    struct ThreadCountersHolder;
+    static thread_local ThreadCountersHolder t_holder;
+
+    static __thread ThreadCounters* t_counters;
+    static __thread bool t_exited;
+    static __thread SharedCounters* t_shared;
+};
+
+#endif // MEMORY_STATS_H
@@ -0,0 +1,149 @@
+#ifndef POOL_ALLOCATOR_H
+#define POOL_ALLOCATOR_H
+
+#include "MemoryPool.h"
+
+#include <functional>
+#include <new>
+#include <stddef.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * 符合标准库 Allocator 要求的适配器，容器的内存从 MemoryPool 中分配
+ *
+ * 只保存一个 MemoryPool 指针，rebind 之后仍然指向同一个池，指向同一个池的分配器相等
+ * 容器析构时照常调用 deallocate，kArena 模式下也可以不等容器析构，直接 resetPool 整体回收，
+ * 此时容器必须先于 resetPool 停止使用
+ * MemoryPool 按 MP_ALIGNMENT 对齐，不支持对齐要求更高的类型
+ *
+ * 默认构造的分配器不指向任何池，直接使用全局 operator new/delete
+ * 拷贝构造容器时副本总是使用默认分配器，拷贝赋值时保留目标自己的分配器，
+ * 这样拷贝出来的对象可以比池活得更久，例如把池中的请求拷贝给其他线程
+ */
+template <typename T>
+class PoolAllocator
+{
+public:
+    using value_type = T;
+    using pointer = T*;
+    using const_pointer = const T*;
+    using reference = T&;
+    using const_reference = const T&;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+
+    // 容器移动、交换时分配器跟着走，保证元素总是由分配它的池释放
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = PoolAllocator<U>;
+    };
+
+    PoolAllocator() noexcept
+        : pool_(nullptr)
+    {
+    }
+
+    explicit PoolAllocator(MemoryPool* pool) noexcept
+        : pool_(pool)
+    {
+    }
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& other) noexcept
+        : pool_(other.pool())
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        static_assert(alignof(T) <= MP_ALIGNMENT, "PoolAllocator does not support over-aligned types");
+        if (n > static_cast<size_t>(-1) / sizeof(T))
+        {
+            throw std::bad_alloc();
+        }
+        void* p = pool_ ? pool_->malloc(n * sizeof(T)) : ::operator new(n * sizeof(T));
+        if (p == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_t) noexcept
+    {
+        if (pool_)
+        {
+            pool_->freeMemory(p);
+        }
+        else
+        {
+            ::operator delete(p);
+        }
+    }
+
+    PoolAllocator select_on_container_copy_construction() const noexcept
+    {
+        return PoolAllocator();
+    }
+
+    MemoryPool* pool() const noexcept { return pool_; }
+
+private:
+    MemoryPool* pool_;
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T>& lhs, const PoolAllocator<U>& rhs) noexcept
+{
+    return lhs.pool() == rhs.pool();
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T>& lhs, const PoolAllocator<U>& rhs) noexcept
+{
+    return lhs.pool() != rhs.pool();
+}
+
+using PoolString = std::basic_string<char, std::char_traits<char>, PoolAllocator<char>>;
+
+template <typename T>
+using PoolVector = std::vector<T, PoolAllocator<T>>;
+
+// C++11 的 std::hash 只特化了默认分配器的 std::string，PoolString 需要自己的哈希
+template <typename Key>
+struct PoolHash : std::hash<Key>
+{
+};
+
+template <>
+struct PoolHash<PoolString>
+{
+    // FNV-1a
+    size_t operator()(const PoolString& str) const noexcept
+    {
+        size_t hash = 14695981039346656037ULL;
+        for (char c : str)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+};
+
+template <typename Key, typename Value, typename Hash = PoolHash<Key>>
+using PoolUnorderedMap = std::unordered_map<Key, Value, Hash, std::equal_to<Key>,
+                                            PoolAllocator<std::pair<const Key, Value>>>;
+
+// 请求头、响应头这类字符串到字符串的映射
+using PoolStringMap = PoolUnorderedMap<PoolString, PoolString>;
+
+#endif // POOL_ALLOCATOR_H
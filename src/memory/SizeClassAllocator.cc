@@ -0,0 +1,275 @@
+#include "SizeClassAllocator.h"
+#include "HugePageAllocator.h"
+
+#include <algorithm>
+#include <mutex>
+#include <stdlib.h>
+
+namespace
+{
+
+const uint32_t kLargeClass = 0xffffffff;
+
+// 每个 span 开头的描述，占用64字节，之后的对象仍然16字节对齐
+struct SpanHeader
+{
+    uint32_t sizeClass;
+    uint32_t objectSize;
+    size_t size;            // 大块的申请大小
+};
+
+const size_t kSpanHeaderSize = 64;
+static_assert(sizeof(SpanHeader) <= kSpanHeaderSize, "span header too large");
+
+inline SpanHeader* spanOf(void* p)
+{
+    return reinterpret_cast<SpanHeader*>(reinterpret_cast<uintptr_t>(p) & ~(SizeClassAllocator::kSpanSize - 1));
+}
+
+// 空闲对象的前8字节存放下一个空闲对象的地址
+inline void*& nextOf(void* p)
+{
+    return *static_cast<void**>(p);
+}
+
+// 线程缓存和中心链表之间一次转移的个数，对象越小一批越多
+int batchSize(int sizeClass)
+{
+    size_t perSpan = (SizeClassAllocator::kSpanSize - kSpanHeaderSize) / SizeClassAllocator::classToSize(sizeClass);
+    return static_cast<int>(std::max<size_t>(4, std::min<size_t>(64, perSpan / 8)));
+}
+
+/**
+ * 一个大小类别的中心空闲链表，所有线程共享
+ */
+struct CentralFreeList
+{
+    std::mutex mutex;
+    void* head = nullptr;
+    size_t length = 0;
+
+    // 取出最多 n 个对象，返回实际个数，链表为空时先切分一个新的 span
+    int removeRange(int sizeClass, int n, void** start)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (length == 0 && !populate(sizeClass))
+        {
+            return 0;
+        }
+        int count = static_cast<int>(std::min<size_t>(n, length));
+        void* first = head;
+        void* last = first;
+        for (int i = 1; i < count; ++i)
+        {
+            last = nextOf(last);
+        }
+        head = nextOf(last);
+        nextOf(last) = nullptr;
+        length -= count;
+        *start = first;
+        return count;
+    }
+
+    // 归还一段已经串好的链表 [first, last]
+    void insertRange(void* first, void* last, int n)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        nextOf(last) = head;
+        head = first;
+        length += n;
+    }
+
+    bool populate(int sizeClass)
+    {
+        // span 不归还，大页模式下直接从大页区域中切分
+        void* memory = nullptr;
+        if (HugePageAllocator::enabled())
+        {
+            memory = HugePageAllocator::allocateChunk(SizeClassAllocator::kSpanSize);
+        }
+        else if (posix_memalign(&memory, SizeClassAllocator::kSpanSize, SizeClassAllocator::kSpanSize) != 0)
+        {
+            memory = nullptr;
+        }
+        if (memory == nullptr)
+        {
+            return false;
+        }
+        SpanHeader* span = static_cast<SpanHeader*>(memory);
+        size_t objectSize = SizeClassAllocator::classToSize(sizeClass);
+        span->sizeClass = static_cast<uint32_t>(sizeClass);
+        span->objectSize = static_cast<uint32_t>(objectSize);
+        span->size = SizeClassAllocator::kSpanSize;
+
+        char* begin = static_cast<char*>(memory) + kSpanHeaderSize;
+        size_t count = (SizeClassAllocator::kSpanSize - kSpanHeaderSize) / objectSize;
+        for (size_t i = 0; i < count; ++i)
+        {
+            void* object = begin + i * objectSize;
+            nextOf(object) = head;
+            head = object;
+        }
+        length += count;
+        return true;
+    }
+};
+
+// 进程退出时线程缓存可能还在归还对象，中心链表故意不析构
+CentralFreeList* centralLists()
+{
+    static CentralFreeList* lists = new CentralFreeList[SizeClassAllocator::kNumClasses];
+    return lists;
+}
+
+/**
+ * 线程缓存，每个大小类别一个单链表
+ * 长度超过两批时还回去一批，线程退出时全部还给中心链表
+ */
+class ThreadCache
+{
+public:
+    ThreadCache()
+    {
+        for (int i = 0; i < SizeClassAllocator::kNumClasses; ++i)
+        {
+            lists_[i].batch = batchSize(i);
+        }
+    }
+
+    ~ThreadCache();
+
+    void* allocate(int sizeClass)
+    {
+        FreeList& list = lists_[sizeClass];
+        if (list.head == nullptr)
+        {
+            void* start = nullptr;
+            int n = centralLists()[sizeClass].removeRange(sizeClass, list.batch, &start);
+            if (n == 0)
+            {
+                return nullptr;
+            }
+            list.head = start;
+            list.length = n;
+        }
+        void* object = list.head;
+        list.head = nextOf(object);
+        --list.length;
+        return object;
+    }
+
+    void deallocate(void* p, int sizeClass)
+    {
+        FreeList& list = lists_[sizeClass];
+        nextOf(p) = list.head;
+        list.head = p;
+        if (++list.length > 2 * list.batch)
+        {
+            release(sizeClass, list.batch);
+        }
+    }
+
+private:
+    struct FreeList
+    {
+        void* head = nullptr;
+        int length = 0;
+        int batch = 0;
+    };
+
+    void releaseAll()
+    {
+        for (int i = 0; i < SizeClassAllocator::kNumClasses; ++i)
+        {
+            if (lists_[i].length > 0)
+            {
+                release(i, lists_[i].length);
+            }
+        }
+    }
+
+    // 把链表头部的 n 个对象还给中心链表
+    void release(int sizeClass, int n)
+    {
+        FreeList& list = lists_[sizeClass];
+        void* first = list.head;
+        void* last = first;
+        for (int i = 1; i < n; ++i)
+        {
+            last = nextOf(last);
+        }
+        list.head = nextOf(last);
+        list.length -= n;
+        centralLists()[sizeClass].insertRange(first, last, n);
+    }
+
+    FreeList lists_[SizeClassAllocator::kNumClasses];
+};
+
+// 本库在程序启动时加载，使用 initial-exec 模型，访问线程变量不必调用 __tls_get_addr
+thread_local ThreadCache t_cache __attribute__((tls_model("initial-exec")));
+// 线程缓存析构之后(线程退出、静态对象析构)的释放直接还给中心链表
+__thread bool t_cacheDestroyed __attribute__((tls_model("initial-exec"))) = false;
+
+ThreadCache::~ThreadCache()
+{
+    t_cacheDestroyed = true;
+    releaseAll();
+}
+
+void* allocateLarge(size_t size)
+{
+    void* memory = nullptr;
+    if (posix_memalign(&memory, SizeClassAllocator::kSpanSize, kSpanHeaderSize + size) != 0)
+    {
+        return nullptr;
+    }
+    SpanHeader* span = static_cast<SpanHeader*>(memory);
+    span->sizeClass = kLargeClass;
+    span->objectSize = 0;
+    span->size = size;
+    return static_cast<char*>(memory) + kSpanHeaderSize;
+}
+
+} // namespace
+
+void* SizeClassAllocator::allocate(size_t size)
+{
+    if (size > kMaxSmallSize)
+    {
+        return allocateLarge(size);
+    }
+    int sizeClass = sizeToClass(size);
+    if (t_cacheDestroyed)
+    {
+        void* object = nullptr;
+        return centralLists()[sizeClass].removeRange(sizeClass, 1, &object) == 1 ? object : nullptr;
+    }
+    return t_cache.allocate(sizeClass);
+}
+
+void SizeClassAllocator::deallocate(void* p)
+{
+    if (p == nullptr)
+    {
+        return;
+    }
+    SpanHeader* span = spanOf(p);
+    if (span->sizeClass == kLargeClass)
+    {
+        ::free(span);
+        return;
+    }
+    if (t_cacheDestroyed)
+    {
+        centralLists()[span->sizeClass].insertRange(p, p, 1);
+        return;
+    }
+    t_cache.deallocate(p, static_cast<int>(span->sizeClass));
+}
+
+size_t SizeClassAllocator::usableSize(void* p)
+{
+    SpanHeader* span = spanOf(p);
+    return span->sizeClass == kLargeClass ? span->size : span->objectSize;
+}
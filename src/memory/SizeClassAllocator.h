@@ -0,0 +1,56 @@
+#ifndef SIZE_CLASS_ALLOCATOR_H
+#define SIZE_CLASS_ALLOCATOR_H
+
+#include "noncopyable.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * 通用的多线程分配器，MemoryPool 的 kGeneral 模式使用
+ *
+ * 不超过 kMaxSmallSize 的请求按大小类别分配：
+ *   每个线程有自己的缓存，分配和释放通常只是一次链表操作，不加锁
+ *   线程缓存为空时从该类别的中心链表批量取一批，缓存过长时批量还回去，中心链表由互斥锁保护
+ *   中心链表也为空时申请一个 kSpanSize 对齐的 span，切成同样大小的对象
+ * 更大的请求单独申请，同样按 kSpanSize 对齐，头部记录大小
+ *
+ * 任何返回的指针按 kSpanSize 向下取整就是所在 span 的头部，释放时 O(1) 得到大小类别
+ * 小对象释放后在本分配器内复用，span 不归还给操作系统
+ */
+class SizeClassAllocator : noncopyable
+{
+public:
+    static const size_t kSpanSize = 64 * 1024;
+    static const size_t kMaxSmallSize = 4096;
+    static const int kNumClasses = 28;
+
+    static void* allocate(size_t size);
+    static void deallocate(void* p);
+
+    // p 实际可用的字节数，不小于申请的大小
+    static size_t usableSize(void* p);
+
+    // 16 字节对齐到 128，之后每个2的幂区间分4档，最大 4096
+    static int sizeToClass(size_t size)
+    {
+        if (size <= 128)
+        {
+            return size == 0 ? 0 : static_cast<int>((size - 1) >> 4);
+        }
+        int bits = 63 - __builtin_clzl(size - 1);
+        return 8 + (bits - 7) * 4 + static_cast<int>((size - 1) >> (bits - 2)) - 4;
+    }
+
+    static size_t classToSize(int sizeClass)
+    {
+        if (sizeClass < 8)
+        {
+            return static_cast<size_t>(sizeClass + 1) * 16;
+        }
+        int bits = 7 + (sizeClass - 8) / 4;
+        return (static_cast<size_t>(1) << bits) + static_cast<size_t>((sizeClass - 8) % 4 + 1) * (static_cast<size_t>(1) << (bits - 2));
+    }
+};
+
+#endif // SIZE_CLASS_ALLOCATOR_H
@@ -0,0 +1,172 @@
+#include "Buffer.h"
+#include "HugePageAllocator.h"
+#include "MemoryPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <vector>
+
+/**
+ * 大页对 TLB 的影响：在一大片内存上按随机顺序逐页访问，每次访问的地址依赖上一次读到的值，
+ * 访问延迟中 TLB 未命中(页表遍历)的开销占主要部分
+ *
+ * region: 一整块映射，普通页 对比 HugePageAllocator::mapRegion
+ * pool:   大量 MemoryPool 的 4KB 小块，posix_memalign 对比 大页区域切分
+ * 每项之后打印 HugePageAllocator 的统计，显示实际使用的是哪种大页以及内核实际合并了多少
+ *
+ * ./HugePageBench [内存大小MB] [访问次数]
+ */
+const size_t kPageSize = 4096;
+
+inline uint64_t nextRandom(uint64_t* seed)
+{
+    *seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *seed >> 33;
+}
+
+/**
+ * 每页第一个 8 字节存放下一页的下标，组成一个随机的环
+ * pages[i] 是第 i 页的地址
+ */
+void buildChain(const std::vector<char*>& pages)
+{
+    size_t n = pages.size();
+    std::vector<uint32_t> order(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        order[i] = static_cast<uint32_t>(i);
+    }
+    uint64_t seed = 1;
+    for (size_t i = n - 1; i > 0; --i)
+    {
+        std::swap(order[i], order[nextRandom(&seed) % (i + 1)]);
+    }
+    for (size_t i = 0; i < n; ++i)
+    {
+        *reinterpret_cast<uint64_t*>(pages[order[i]]) = order[(i + 1) % n];
+    }
+}
+
+double chase(const std::vector<char*>& pages, long accesses)
+{
+    uint64_t index = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < accesses; ++i)
+    {
+        index = *reinterpret_cast<uint64_t*>(pages[index]);
+    }
+    auto end = std::chrono::steady_clock::now();
+    // 防止循环被优化掉
+    if (index == static_cast<uint64_t>(-1))
+    {
+        printf("unreachable\n");
+    }
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()) / accesses;
+}
+
+void printStats()
+{
+    HugePageAllocator::Stats stats = HugePageAllocator::stats();
+    printf("    backing: hugetlb %zuMB  transparent %zuMB  normal %zuMB  | resident: AnonHugePages %zuMB  Hugetlb %zuMB\n",
+           stats.hugeTlbBytes >> 20, stats.transparentBytes >> 20, stats.normalBytes >> 20,
+           stats.anonHugePagesBytes >> 20, stats.hugetlbResidentBytes >> 20);
+}
+
+void benchRegion(size_t bytes, long accesses, bool huge)
+{
+    char* region = nullptr;
+    HugePageAllocator::Backing backing = HugePageAllocator::kNormal;
+    if (huge)
+    {
+        region = static_cast<char*>(HugePageAllocator::mapRegion(bytes, &backing));
+    }
+    else
+    {
+        void* p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        region = p == MAP_FAILED ? nullptr : static_cast<char*>(p);
+    }
+    if (region == nullptr)
+    {
+        printf("region %s: map failed\n", huge ? "huge" : "normal");
+        return;
+    }
+    memset(region, 0, bytes);
+
+    std::vector<char*> pages(bytes / kPageSize);
+    for (size_t i = 0; i < pages.size(); ++i)
+    {
+        pages[i] = region + i * kPageSize;
+    }
+    buildChain(pages);
+    printf("region %-14s %6zuMB %8.1f ns/access\n",
+           HugePageAllocator::backingName(backing), bytes >> 20, chase(pages, accesses));
+    printStats();
+
+    if (huge)
+    {
+        HugePageAllocator::unmapRegion(region, bytes);
+    }
+    else
+    {
+        ::munmap(region, bytes);
+    }
+}
+
+void benchPool(size_t bytes, long accesses, bool huge)
+{
+    HugePageAllocator::setEnabled(huge);
+    // 每个池占满若干个小块，访问所有小块
+    const int kPools = 64;
+    std::vector<MemoryPool> pools(kPools);
+    std::vector<char*> pages;
+    size_t blocks = bytes / kPageSize;
+    for (auto& pool : pools)
+    {
+        pool.createPool();
+    }
+    for (size_t i = 0; i < blocks; ++i)
+    {
+        // 每次申请接近一整块，保证每次都是一个新的小块
+        char* p = static_cast<char*>(pools[i % kPools].malloc(PAGE_SIZE - 64));
+        memset(p, 0, 64);
+        pages.push_back(p);
+    }
+    buildChain(pages);
+    printf("pool   %-14s %6zuMB %8.1f ns/access\n", huge ? "huge" : "posix_memalign", bytes >> 20, chase(pages, accesses));
+    printStats();
+
+    for (auto& pool : pools)
+    {
+        pool.destroyPool();
+    }
+    HugePageAllocator::setEnabled(false);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t megabytes = argc > 1 ? static_cast<size_t>(atol(argv[1])) : 512;
+    long accesses = argc > 2 ? atol(argv[2]) : 10000000;
+    size_t bytes = megabytes << 20;
+
+    benchRegion(bytes, accesses, false);
+    benchRegion(bytes, accesses, true);
+    benchPool(bytes, accesses, false);
+    benchPool(bytes, accesses, true);
+
+    // Buffer 在大页模式下构造，内存来自 SizeClassAllocator 的大页 span 或者大页区域中的块
+    HugePageAllocator::setEnabled(true);
+    {
+        Buffer buffer;
+        std::string data(64 * 1024, 'x');
+        buffer.append(data);
+        printf("buffer 64KB appended in huge page mode\n");
+        printStats();
+    }
+    HugePageAllocator::setEnabled(false);
+    return 0;
+}
@@ -0,0 +1,181 @@
+#include "MemoryPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+/**
+ * 多线程分配/释放对比：glibc malloc 与 MemoryPool 的 kGeneral 模式
+ *
+ * churn: 每个线程保持 kLiveObjects 个存活对象，随机挑一个释放后重新申请
+ * burst: 每个线程一次申请 kLiveObjects 个对象再全部释放，反复进行
+ * 大小为 16~512 字节为主，少量到 4096 字节
+ *
+ * large: kArena 模式下同时存活 1k/10k/100k 个大块，按随机顺序释放，
+ *        释放耗时应与存活数量无关
+ *
+ * ./MemoryPoolBench [每个线程的操作次数]
+ */
+const int kLiveObjects = 4096;
+
+struct MallocAllocator
+{
+    void* allocate(size_t size) { return ::malloc(size); }
+    void deallocate(void* p) { ::free(p); }
+};
+
+struct PoolAllocator
+{
+    explicit PoolAllocator(MemoryPool* pool) : pool(pool) {}
+    void* allocate(size_t size) { return pool->malloc(size); }
+    void deallocate(void* p) { pool->freeMemory(p); }
+    MemoryPool* pool;
+};
+
+// 线性同余，避免 rand() 的锁
+inline uint32_t nextRandom(uint32_t* seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 8;
+}
+
+inline size_t randomSize(uint32_t* seed)
+{
+    uint32_t r = nextRandom(seed);
+    return (r % 16 == 0) ? 16 + r % 4080 : 16 + r % 496;
+}
+
+template <typename Allocator>
+void churn(Allocator allocator, int ops, uint32_t seed)
+{
+    std::vector<void*> live(kLiveObjects);
+    for (auto& p : live)
+    {
+        p = allocator.allocate(randomSize(&seed));
+    }
+    for (int i = 0; i < ops; ++i)
+    {
+        void*& slot = live[nextRandom(&seed) % kLiveObjects];
+        allocator.deallocate(slot);
+        size_t size = randomSize(&seed);
+        slot = allocator.allocate(size);
+        // 写一个字节，保证内存真的被使用
+        *static_cast<char*>(slot) = static_cast<char>(i);
+    }
+    for (void* p : live)
+    {
+        allocator.deallocate(p);
+    }
+}
+
+template <typename Allocator>
+void burst(Allocator allocator, int ops, uint32_t seed)
+{
+    std::vector<void*> live(kLiveObjects);
+    for (int done = 0; done < ops; done += kLiveObjects)
+    {
+        for (auto& p : live)
+        {
+            p = allocator.allocate(randomSize(&seed));
+            *static_cast<char*>(p) = 0;
+        }
+        for (void* p : live)
+        {
+            allocator.deallocate(p);
+        }
+    }
+}
+
+template <typename Func>
+void bench(const char* name, int threads, int ops, Func&& func)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back(func, ops, static_cast<uint32_t>(t + 1));
+    }
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double us = static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+    double totalOps = static_cast<double>(threads) * ops;
+    printf("%-14s threads=%-2d %8.2f Mops/s  %6.1f ns/op\n", name, threads, totalOps / us, us * 1000 / totalOps);
+}
+
+double elapsedNs(std::chrono::steady_clock::time_point start)
+{
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+}
+
+// 大块内存 4KB~6KB，全部申请后随机顺序释放
+template <typename Allocator>
+void benchLarge(const char* name, Allocator allocator, int live)
+{
+    uint32_t seed = 1;
+    std::vector<void*> blocks(live);
+    auto start = std::chrono::steady_clock::now();
+    for (auto& p : blocks)
+    {
+        p = allocator.allocate(PAGE_SIZE + nextRandom(&seed) % 2048);
+        *static_cast<char*>(p) = 0;
+    }
+    double allocNs = elapsedNs(start);
+
+    for (int i = live - 1; i > 0; --i)
+    {
+        std::swap(blocks[i], blocks[nextRandom(&seed) % (i + 1)]);
+    }
+    start = std::chrono::steady_clock::now();
+    for (void* p : blocks)
+    {
+        allocator.deallocate(p);
+    }
+    double freeNs = elapsedNs(start);
+    printf("%-14s live=%-7d alloc %6.1f ns/op  free %6.1f ns/op\n", name, live, allocNs / live, freeNs / live);
+}
+
+int main(int argc, char* argv[])
+{
+    int ops = argc > 1 ? atoi(argv[1]) : 2000000;
+
+    MemoryPool pool;
+    pool.createPool(MemoryPool::kGeneral);
+
+    const int kThreads[] = { 1, 2, 4, 8 };
+    for (int threads : kThreads)
+    {
+        bench("churn malloc", threads, ops, [](int n, uint32_t seed) {
+            churn(MallocAllocator(), n, seed);
+        });
+        bench("churn pool", threads, ops, [&pool](int n, uint32_t seed) {
+            churn(PoolAllocator(&pool), n, seed);
+        });
+        bench("burst malloc", threads, ops, [](int n, uint32_t seed) {
+            burst(MallocAllocator(), n, seed);
+        });
+        bench("burst pool", threads, ops, [&pool](int n, uint32_t seed) {
+            burst(PoolAllocator(&pool), n, seed);
+        });
+    }
+
+    pool.destroyPool();
+
+    const int kLiveLarge[] = { 1000, 10000, 100000 };
+    for (int live : kLiveLarge)
+    {
+        MemoryPool arena;
+        arena.createPool();
+        benchLarge("large malloc", MallocAllocator(), live);
+        benchLarge("large arena", PoolAllocator(&arena), live);
+        arena.destroyPool();
+    }
+    return 0;
+}
@@ -38,7 +38,7 @@ void showInfo(MemoryPool *Mpool, char *str) {
     for (large = pool->largeList_; large; large = large->next_, i++) {
         if (large->address_ != nullptr) 
         {
-            printf("第%d块large block  size=%d\n", i, large->size_);
+            printf("第%d块large block  size=%lu\n", i, large->size_);
         }
     }
     printf("\r\n\r\n------end pool status------\r\n\r\n");
@@ -0,0 +1,219 @@
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "MemoryPool.h"
+#include "MemoryStats.h"
+#include "TcpConnectionSlabPool.h"
+
+#include <chrono>
+#include <memory>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+/**
+ * MemoryStats 和 MemoryPool::stats() 的用法示例、正确性和开销测试
+ *
+ * ./MemoryStatsTest [记录次数]
+ */
+int g_failures = 0;
+
+void check(bool ok, const char* what)
+{
+    printf("%-56s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+    {
+        ++g_failures;
+    }
+}
+
+int64_t bytesOf(const MemoryStats::Snapshot& snapshot, MemoryStats::Subsystem subsystem)
+{
+    return snapshot.subsystems[subsystem].bytes;
+}
+
+int64_t allocationsOf(const MemoryStats::Snapshot& snapshot, MemoryStats::Subsystem subsystem)
+{
+    return snapshot.subsystems[subsystem].allocations;
+}
+
+void printSnapshot(const char* title, const MemoryStats::Snapshot& snapshot)
+{
+    printf("%s (total %lld bytes)\n", title, static_cast<long long>(snapshot.totalBytes()));
+    for (int i = 0; i < MemoryStats::kNumSubsystems; ++i)
+    {
+        const MemoryStats::Counters& counters = snapshot.subsystems[i];
+        printf("  %-14s bytes %10lld  live %6lld  total %8lld  peak %10lld\n",
+               MemoryStats::subsystemName(static_cast<MemoryStats::Subsystem>(i)),
+               static_cast<long long>(counters.bytes),
+               static_cast<long long>(counters.allocations),
+               static_cast<long long>(counters.totalAllocations),
+               static_cast<long long>(counters.peakBytes));
+    }
+}
+
+void printPoolStats(const char* title, const MemoryPool::Stats& stats)
+{
+    printf("%s: reserved %lu used %lu peak %lu fragmentation %.2f small %d (in use %d) large %d failed %lu (skipped %d)\n",
+           title, stats.reservedBytes, stats.usedBytes, stats.peakReservedBytes, stats.fragmentation(),
+           stats.smallBlocks, stats.smallBlocksInUse, stats.largeBlocks, stats.failedTotal, stats.failedBlocks);
+}
+
+void testPool()
+{
+    MemoryPool pool;
+    pool.createPool();
+    for (int i = 0; i < 100; ++i)
+    {
+        pool.malloc(100 + i * 10);
+    }
+    void* large = pool.malloc(16 * 1024);
+    printPoolStats("pool", pool.stats());
+    pool.freeMemory(large);
+    printPoolStats("pool after free large", pool.stats());
+    pool.resetPool();
+    pool.trimPool(1);
+    printPoolStats("pool after reset and trim", pool.stats());
+    pool.destroyPool();
+}
+
+void testRecord()
+{
+    MemoryStats::Snapshot before = MemoryStats::snapshot(MemoryStats::threadCounters());
+    MemoryStats::record(MemoryStats::kOther, 100);
+    MemoryStats::record(MemoryStats::kOther, 28);
+    MemoryStats::Snapshot during = MemoryStats::snapshot(MemoryStats::threadCounters());
+    check(bytesOf(during, MemoryStats::kOther) == bytesOf(before, MemoryStats::kOther) + 128 &&
+          allocationsOf(during, MemoryStats::kOther) == allocationsOf(before, MemoryStats::kOther) + 2,
+          "record counts bytes and allocations");
+    MemoryStats::record(MemoryStats::kOther, -100);
+    MemoryStats::record(MemoryStats::kOther, -28);
+    MemoryStats::Snapshot after = MemoryStats::snapshot(MemoryStats::threadCounters());
+    check(bytesOf(after, MemoryStats::kOther) == bytesOf(before, MemoryStats::kOther) &&
+          allocationsOf(after, MemoryStats::kOther) == allocationsOf(before, MemoryStats::kOther),
+          "bytes and allocations back after free");
+    check(after.subsystems[MemoryStats::kOther].peakBytes >= bytesOf(before, MemoryStats::kOther) + 128,
+          "peak kept after free");
+}
+
+void testThreads()
+{
+    // 其他线程的 Buffer 计入该线程，线程退出后并入总和
+    MemoryStats::Snapshot before = MemoryStats::snapshot();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i)
+    {
+        threads.emplace_back([] {
+            Buffer buffer;
+            buffer.append(std::string(64 * 1024, 'x'));
+            printSnapshot("worker thread", MemoryStats::snapshot(MemoryStats::threadCounters()));
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    MemoryStats::Snapshot after = MemoryStats::snapshot();
+    printSnapshot("after workers exited", after);
+    check(bytesOf(after, MemoryStats::kBuffer) == bytesOf(before, MemoryStats::kBuffer) &&
+          allocationsOf(after, MemoryStats::kBuffer) == allocationsOf(before, MemoryStats::kBuffer),
+          "buffer bytes back after worker threads exit");
+    check(after.subsystems[MemoryStats::kBuffer].totalAllocations >
+          before.subsystems[MemoryStats::kBuffer].totalAllocations,
+          "exited threads kept in totalAllocations");
+}
+
+// 模拟 TcpConnection：在一个线程创建，在另一个线程销毁，内存都计入所属loop
+struct FakeConnection
+{
+    Buffer inputBuffer;
+    Buffer outputBuffer;
+};
+
+void testLoopAttribution()
+{
+    EventLoop loop;
+    MemoryStats::Snapshot loopBefore = loop.memoryStats();
+    MemoryStats::Snapshot before = MemoryStats::snapshot();
+
+    std::shared_ptr<FakeConnection> conn;
+    MemoryStats::Snapshot creator;
+    std::thread([&] {
+        conn = std::allocate_shared<FakeConnection>(
+            TcpConnectionAllocator<FakeConnection>(loop.connectionSlabPool()));
+        creator = MemoryStats::snapshot(MemoryStats::threadCounters());
+    }).join();
+
+    MemoryStats::Snapshot loopDuring = loop.memoryStats();
+    check(bytesOf(creator, MemoryStats::kBuffer) == 0 && bytesOf(creator, MemoryStats::kConnection) == 0,
+          "creating thread not charged for the connection");
+    check(bytesOf(loopDuring, MemoryStats::kBuffer) >= bytesOf(loopBefore, MemoryStats::kBuffer) + 2 * 1024 &&
+          allocationsOf(loopDuring, MemoryStats::kBuffer) == allocationsOf(loopBefore, MemoryStats::kBuffer) + 2,
+          "connection buffers charged to the owning loop");
+    check(bytesOf(loopDuring, MemoryStats::kConnection) > bytesOf(loopBefore, MemoryStats::kConnection),
+          "connection slab charged to the owning loop");
+
+    MemoryStats::Snapshot destroyer;
+    std::thread([&] {
+        conn.reset();
+        destroyer = MemoryStats::snapshot(MemoryStats::threadCounters());
+    }).join();
+
+    MemoryStats::Snapshot loopAfter = loop.memoryStats();
+    check(bytesOf(destroyer, MemoryStats::kBuffer) == 0 && allocationsOf(destroyer, MemoryStats::kBuffer) == 0,
+          "destroying thread not credited for the buffers");
+    check(bytesOf(loopAfter, MemoryStats::kBuffer) == bytesOf(loopBefore, MemoryStats::kBuffer) &&
+          allocationsOf(loopAfter, MemoryStats::kBuffer) == allocationsOf(loopBefore, MemoryStats::kBuffer),
+          "loop buffer bytes back after the connection is freed");
+
+    // 块留在池的缓存中，池随loop析构后才归还
+    loop.connectionSlabPool()->setMaxCached(0);
+    MemoryStats::Snapshot after = MemoryStats::snapshot();
+    check(bytesOf(after, MemoryStats::kBuffer) == bytesOf(before, MemoryStats::kBuffer) &&
+          bytesOf(after, MemoryStats::kConnection) == bytesOf(before, MemoryStats::kConnection) &&
+          allocationsOf(after, MemoryStats::kConnection) == allocationsOf(before, MemoryStats::kConnection),
+          "process totals back after free");
+}
+
+void benchRecord(long count)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < count; ++i)
+    {
+        MemoryStats::record(MemoryStats::kOther, 64);
+        MemoryStats::record(MemoryStats::kOther, -64);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    printf("record: %.2f ns/call\n", ns / (count * 2));
+
+    start = std::chrono::steady_clock::now();
+    const int kSnapshots = 10000;
+    int64_t sum = 0;
+    for (int i = 0; i < kSnapshots; ++i)
+    {
+        sum += MemoryStats::snapshot().totalBytes();
+    }
+    end = std::chrono::steady_clock::now();
+    ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    printf("snapshot: %.2f ns/call (%lld)\n", ns / kSnapshots, static_cast<long long>(sum / kSnapshots));
+}
+
+int main(int argc, char* argv[])
+{
+    long count = argc > 1 ? atol(argv[1]) : 10000000;
+
+    testPool();
+    testRecord();
+
+    {
+        EventLoop loop;
+        Buffer buffer;
+        buffer.append(std::string(8192, 'x'));
+        printSnapshot("loop", loop.memoryStats());
+    }
+
+    testThreads();
+    testLoopAttribution();
+    benchRecord(count);
+    return g_failures == 0 ? 0 : 1;
+}
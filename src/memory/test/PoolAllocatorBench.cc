@@ -0,0 +1,178 @@
+#include "MemoryPool.h"
+#include "PoolAllocator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+/**
+ * 按 HttpRequest 的方式解析一个典型的 GET 请求(请求行 + 9 个头部)
+ *   std:  std::string + std::unordered_map，与 HttpRequest 现在的成员相同
+ *   pool: PoolString + PoolStringMap，每个请求结束后 resetPool
+ * 统计每个请求调用 operator new 的次数和耗时
+ * pool 的小块内存由 posix_memalign 申请，不经过 operator new，单独给出池中块的个数，
+ * 第一个请求之后块被复用，不再增长
+ *
+ * ./PoolAllocatorBench [请求个数]
+ */
+static size_t g_newCalls = 0;
+
+void* operator new(size_t size)
+{
+    ++g_newCalls;
+    void* p = ::malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    ::free(p);
+}
+
+const char kRequest[] =
+    "GET /api/v1/items/search?category=books&sort=price HTTP/1.1\r\n"
+    "Host: www.example.com:8080\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Connection: keep-alive\r\n"
+    "Cookie: session=8f3a2b1c9d4e5f60718293a4b5c6d7e8\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "\r\n";
+
+template <typename String, typename Map>
+struct Request
+{
+    template <typename... Alloc>
+    explicit Request(const Alloc&... alloc)
+        : method(alloc...), path(alloc...), query(alloc...), headers(0, typename Map::hasher(),
+                                                                     typename Map::key_equal(), alloc...)
+    {
+    }
+
+    String method;
+    String path;
+    String query;
+    Map headers;
+};
+
+const char* findCRLF(const char* begin, const char* end)
+{
+    const char kCRLF[] = "\r\n";
+    const char* crlf = std::search(begin, end, kCRLF, kCRLF + 2);
+    return crlf == end ? nullptr : crlf;
+}
+
+// 与 HttpContext::parseRequest 和 HttpRequest 的处理相同，String 的构造需要分配器时由 make 提供
+template <typename Req, typename Make>
+size_t parse(Req* req, const char* begin, const char* end, Make&& make)
+{
+    const char* crlf = findCRLF(begin, end);
+    const char* space = std::find(begin, crlf, ' ');
+    req->method.assign(begin, space);
+    const char* start = space + 1;
+    space = std::find(start, crlf, ' ');
+    const char* question = std::find(start, space, '?');
+    req->path.assign(start, question);
+    req->query.assign(question, space);
+
+    begin = crlf + 2;
+    while ((crlf = findCRLF(begin, end)) != nullptr && crlf != begin)
+    {
+        const char* colon = std::find(begin, crlf, ':');
+        auto field = make(begin, colon);
+        ++colon;
+        while (colon < crlf && isspace(*colon))
+        {
+            ++colon;
+        }
+        auto value = make(colon, crlf);
+        while (!value.empty() && isspace(value[value.size() - 1]))
+        {
+            value.resize(value.size() - 1);
+        }
+        // 与 HttpRequest::addHeader 相同，operator[] 默认构造的值不在池中
+        auto it = req->headers.find(field);
+        if (it != req->headers.end())
+        {
+            it->second = std::move(value);
+        }
+        else
+        {
+            req->headers.emplace(std::move(field), std::move(value));
+        }
+        begin = crlf + 2;
+    }
+    return req->headers.size();
+}
+
+template <typename Func>
+void bench(const char* name, int n, Func&& func)
+{
+    size_t before = g_newCalls;
+    size_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i)
+    {
+        checksum += func();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    printf("%-6s %8.1f ns/request  %6.2f operator new/request  (headers %zu)\n",
+           name, ns / n, static_cast<double>(g_newCalls - before) / n, checksum / n);
+}
+
+int countSmallBlocks(MemoryPool* pool)
+{
+    int count = 0;
+    for (SmallNode* node = pool->getPool()->head_; node != nullptr; node = node->next_)
+    {
+        ++count;
+    }
+    return count;
+}
+
+int main(int argc, char* argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : 200000;
+    const char* end = kRequest + sizeof(kRequest) - 1;
+
+    using StdRequest = Request<std::string, std::unordered_map<std::string, std::string>>;
+    bench("std", n, [end]() {
+        StdRequest req;
+        return parse(&req, kRequest, end, [](const char* b, const char* e) {
+            return std::string(b, e);
+        });
+    });
+
+    MemoryPool pool;
+    pool.createPool();
+    using PooledRequest = Request<PoolString, PoolStringMap>;
+    bench("pool", n, [&pool, end]() {
+        size_t headers = 0;
+        {
+            PoolAllocator<char> alloc(&pool);
+            PooledRequest req(alloc);
+            headers = parse(&req, kRequest, end, [alloc](const char* b, const char* e) {
+                return PoolString(b, e, alloc);
+            });
+        }
+        pool.resetPool();
+        return headers;
+    });
+    printf("pool small blocks: %d\n", countSmallBlocks(&pool));
+    pool.destroyPool();
+    return 0;
+}
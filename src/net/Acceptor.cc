@@ -81,7 +81,7 @@ void Acceptor::handleRead()
     }
     else
     {
-        LOG_ERROR << "accept() failed";
+        LOG_EVERY_T(ERROR, 1) << "accept() failed";
         // LOG_ERROR("%s:%s:%d accept err:%d\n", __FILE__, __FUNCTION__, __LINE__, errno);
 
         // 当前进程的fd已经用完了
@@ -89,7 +89,7 @@ void Acceptor::handleRead()
         // 也可以分布式部署
         if (errno == EMFILE)
         {
-            LOG_ERROR << "sockfd reached limit";
+            LOG_EVERY_T(ERROR, 1) << "sockfd reached limit";
             // LOG_ERROR("%s:%s:%d sockfd reached limit\n", __FILE__, __FUNCTION__, __LINE__);
         }
     }
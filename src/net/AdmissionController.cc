@@ -0,0 +1,30 @@
+#include "AdmissionController.h"
+#include "EventLoop.h"
+
+bool AdmissionController::overloaded(const EventLoop* loop) const
+{
+    int64_t maxLag = maxLoopLagUs_;
+    size_t maxQueue = maxQueueSize_;
+    return (maxLag > 0 && loop->loopLagMicroSeconds() > maxLag) ||
+           (maxQueue > 0 && loop->queueSize() > maxQueue);
+}
+
+bool AdmissionController::admitConnection(const EventLoop* loop)
+{
+    if (overloaded(loop))
+    {
+        ++rejectedConnections_;
+        return false;
+    }
+    return true;
+}
+
+bool AdmissionController::admitRequest(const EventLoop* loop)
+{
+    if (overloaded(loop))
+    {
+        ++rejectedRequests_;
+        return false;
+    }
+    return true;
+}
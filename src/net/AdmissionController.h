@@ -0,0 +1,57 @@
+#ifndef ADMISSION_CONTROLLER_H
+#define ADMISSION_CONTROLLER_H
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <stddef.h>
+
+class EventLoop;
+
+/**
+ * 过载保护：根据subLoop的负载决定是否接纳新连接/新请求
+ *
+ * 负载指标来自 EventLoop：
+ * - loopLagMicroSeconds: poll返回到开始执行回调的延迟
+ * - queueSize: 等待执行的pendingFunctors数量
+ * 任意一项超过阈值即认为该loop过载，TcpServer 直接关闭新连接，
+ * HttpServer 对新请求快速回复 503，让系统平滑降级而不是排队到超时
+ *
+ * 阈值可以在运行时从任意线程调整，阈值为0表示不检查该项
+ */
+class AdmissionController : noncopyable
+{
+public:
+    explicit AdmissionController(int64_t maxLoopLagUs = 100 * 1000,
+                                 size_t maxQueueSize = 10000)
+        : maxLoopLagUs_(maxLoopLagUs),
+          maxQueueSize_(maxQueueSize),
+          rejectedConnections_(0),
+          rejectedRequests_(0)
+    {
+    }
+
+    void setMaxLoopLag(int64_t us) { maxLoopLagUs_ = us; }
+    void setMaxQueueSize(size_t size) { maxQueueSize_ = size; }
+    int64_t maxLoopLag() const { return maxLoopLagUs_; }
+    size_t maxQueueSize() const { return maxQueueSize_; }
+
+    // loop 是否超过任一阈值
+    bool overloaded(const EventLoop* loop) const;
+
+    // 返回false表示拒绝，同时记录拒绝次数
+    bool admitConnection(const EventLoop* loop);
+    bool admitRequest(const EventLoop* loop);
+
+    uint64_t rejectedConnections() const { return rejectedConnections_; }
+    uint64_t rejectedRequests() const { return rejectedRequests_; }
+
+private:
+    std::atomic<int64_t> maxLoopLagUs_;
+    std::atomic<size_t> maxQueueSize_;
+    std::atomic<uint64_t> rejectedConnections_;
+    std::atomic<uint64_t> rejectedRequests_;
+};
+
+#endif // ADMISSION_CONTROLLER_H
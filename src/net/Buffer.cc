@@ -15,7 +15,7 @@ const char Buffer::kCRLF[] = "\r\n";
  * Buffer_空间如果不够会读入到栈上65536个字节大小的空间，然后以append的
  * 方式追加入buffer_。既考虑了避免系统调用带来开销，又不影响数据的接收。
  **/
-ssize_t Buffer::readFd(int fd, int *saveErrno)
+ssize_t Buffer::readFd(int fd, int *saveErrno, size_t maxBytes)
 {
     // 栈额外空间，用于从套接字往出读时，当buffer_暂时不够用时暂存数据，待buffer_重新分配足够空间后，在把数据交换给buffer_。
     char extrabuf[65536] = {0}; // 栈上内存空间 65536/1024 = 64KB
@@ -42,7 +42,18 @@ ssize_t Buffer::readFd(int fd, int *saveErrno)
     // when extrabuf is used, we read 128k-1 bytes at most.
     // 这里之所以说最多128k-1字节，是因为若writable为64k-1，那么需要两个缓冲区 第一个64k-1 第二个64k 所以做多128k-1
     // 如果第一个缓冲区>=64k 那就只采用一个缓冲区 而不使用栈空间extrabuf[65536]的内容
-    const int iovcnt = (writable < sizeof(extrabuf)) ? 2 : 1;
+    int iovcnt = (writable < sizeof(extrabuf)) ? 2 : 1;
+
+    // 有读取预算时截断两块缓冲区的长度，剩余数据留在内核中下一轮再读
+    if (maxBytes > 0)
+    {
+        vec[0].iov_len = std::min(writable, maxBytes);
+        vec[1].iov_len = std::min(sizeof(extrabuf), maxBytes - vec[0].iov_len);
+        if (vec[1].iov_len == 0)
+        {
+            iovcnt = 1;
+        }
+    }
     const ssize_t n = ::readv(fd, vec, iovcnt);
 
     if (n < 0)
@@ -5,6 +5,8 @@
 #include <string>
 #include <algorithm>
 
+#include "HugePageAllocator.h"
+
 /// +-------------------+------------------+------------------+
 /// | prependable bytes |  readable bytes  |  writable bytes  |
 /// |                   |     (CONTENT)    |                  |
@@ -147,8 +149,8 @@ public:
         return begin() + writerIndex_;
     }
 
-    // 从fd上读取数据
-    ssize_t readFd(int fd, int *saveErrno);
+    // 从fd上读取数据，maxBytes限制本次最多读取的字节数(0表示不限制)
+    ssize_t readFd(int fd, int *saveErrno, size_t maxBytes = 0);
     // 通过fd发送数据
     ssize_t writeFd(int fd, int *saveErrno);
     
@@ -190,8 +192,9 @@ private:
     /**
      * 采取 vector 形式，可以自动分配内存
      * 也可以提前预留空间大小、
+     * 构造时开启了 HugePageAllocator 则使用大页，占用计入 MemoryStats::kBuffer
      */ 
-    std::vector<char> buffer_;
+    std::vector<char, HugePageStlAllocator<char, MemoryStats::kBuffer>> buffer_;
     size_t readerIndex_;
     size_t writerIndex_;
     static const char kCRLF[];
@@ -87,7 +87,7 @@ void Channel::handleEventWithGuard(Timestamp receiveTime)
     // 错误事件
     if (revents_ & (EPOLLERR))
     {
-        LOG_ERROR << "the fd = " << this->fd();
+        LOG_RATE_LIMITED(ERROR, 10, 50) << "the fd = " << this->fd();
         if (errorCallback_)
         {
             errorCallback_();
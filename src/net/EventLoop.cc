@@ -1,6 +1,7 @@
 #include "EventLoop.h"
 #include "Logging.h"
 #include "Poller.h"
+#include "TcpConnectionSlabPool.h"
 #include <unistd.h>
 #include <sys/eventfd.h>
 #include <fcntl.h>
@@ -27,8 +28,22 @@ EventLoop::EventLoop() :
     quit_(false),
     callingPendingFunctors_(false),
     threadId_(CurrentThread::tid()),
+    polling_(false),
+    loopLag_(0),
+    pendingCount_(0),
+    maxReadBytesPerTurn_(0),
+    pendingFunctorsBudgetUs_(0),
+    iterations_(0),
+    eventsHandled_(0),
+    functorsRun_(0),
+    functorsDeferred_(0),
+    readBudgetHits_(0),
+    maxIterationUs_(0),
+    maxFunctorsUs_(0),
     poller_(Poller::newDefaultPoller(this)),
     timerQueue_(new TimerQueue(this)),
+    connectionSlabPool_(std::make_shared<TcpConnectionSlabPool>()),
+    memoryCounters_(MemoryStats::threadCounters()),
     wakeupFd_(createEventfd()),
     wakeupChannel_(new Channel(this, wakeupFd_)),
     currentActiveChannel_(nullptr)
@@ -74,11 +89,17 @@ void EventLoop::loop()
         // 清空activeChannels_
         activeChannels_.clear();
         // 获取
+        polling_ = true;
         pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        polling_ = false;
         for (Channel *channel : activeChannels_)
         {
             channel->handleEvent(pollReturnTime_);
         }
+        // 记录poll返回到开始执行回调的延迟，按 7/8 旧值 + 1/8 新值平滑
+        Timestamp functorsStart = Timestamp::now();
+        int64_t lag = functorsStart.microSecondsSinceEpoch() - pollReturnTime_.microSecondsSinceEpoch();
+        loopLag_ = (loopLag_ * 7 + lag) / 8;
         // 执行当前EventLoop事件循环需要处理的回调操作
         /**
          * IO thread：mainLoop accept fd 打包成 chennel 分发给 subLoop
@@ -86,6 +107,21 @@ void EventLoop::loop()
          * 这些回调函数在 std::vector<Functor> pendingFunctors_; 之中
          */
         doPendingFunctors();
+
+        // 更新公平性统计
+        Timestamp iterationEnd = Timestamp::now();
+        int64_t functorsUs = iterationEnd.microSecondsSinceEpoch() - functorsStart.microSecondsSinceEpoch();
+        int64_t iterationUs = iterationEnd.microSecondsSinceEpoch() - pollReturnTime_.microSecondsSinceEpoch();
+        ++iterations_;
+        eventsHandled_ += activeChannels_.size();
+        if (functorsUs > maxFunctorsUs_)
+        {
+            maxFunctorsUs_ = functorsUs;
+        }
+        if (iterationUs > maxIterationUs_)
+        {
+            maxIterationUs_ = iterationUs;
+        }
     }
     looping_ = false;    
 }
@@ -118,7 +154,7 @@ void EventLoop::runInLoop(Functor cb)
     // 在非当前eventLoop线程中执行回调函数，需要唤醒evevntLoop所在线程
     else
     {
-        queueInLoop(cb);
+        queueInLoop(std::move(cb));
     }
 }
 
@@ -126,7 +162,8 @@ void EventLoop::queueInLoop(Functor cb)
 {
     {
         std::unique_lock<std::mutex> lock(mutex_);
-        pendingFunctors_.emplace_back(cb); // 使用了std::move
+        pendingFunctors_.emplace_back(std::move(cb));
+        pendingCount_ = pendingFunctors_.size();
     }
 
     // 唤醒相应的，需要执行上面回调操作的loop线程
@@ -192,12 +229,72 @@ void EventLoop::doPendingFunctors()
     {
         std::unique_lock<std::mutex> lock(mutex_);
         functors.swap(pendingFunctors_);
+        pendingCount_ = 0;
     }
 
-    for (const Functor &functor : functors)
+    const int64_t budget = pendingFunctorsBudgetUs_;
+    const int64_t start = budget > 0 ? Timestamp::now().microSecondsSinceEpoch() : 0;
+    size_t done = 0;
+    while (done < functors.size())
     {
-        functor();
+        functors[done]();
+        ++done;
+        // 每执行8个回调检查一次时间，减少获取时间的开销
+        if (budget > 0 && done % 8 == 0 &&
+            Timestamp::now().microSecondsSinceEpoch() - start >= budget)
+        {
+            break;
+        }
+    }
+    functorsRun_ += done;
+
+    // 超出预算，剩余回调放回队列头部，保持原有顺序，下一轮继续执行
+    if (done < functors.size())
+    {
+        functorsDeferred_ += functors.size() - done;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            functors.erase(functors.begin(), functors.begin() + done);
+            functors.insert(functors.end(),
+                            std::make_move_iterator(pendingFunctors_.begin()),
+                            std::make_move_iterator(pendingFunctors_.end()));
+            pendingFunctors_.swap(functors);
+            pendingCount_ = pendingFunctors_.size();
+        }
+        // 保证下一轮poll立即返回
+        wakeup();
     }
 
     callingPendingFunctors_ = false;
 }
+
+EventLoop::Stats EventLoop::stats() const
+{
+    Stats stats;
+    stats.iterations = iterations_;
+    stats.eventsHandled = eventsHandled_;
+    stats.functorsRun = functorsRun_;
+    stats.functorsDeferred = functorsDeferred_;
+    stats.readBudgetHits = readBudgetHits_;
+    stats.maxIterationUs = maxIterationUs_;
+    stats.maxFunctorsUs = maxFunctorsUs_;
+    return stats;
+}
+
+MemoryStats::Snapshot EventLoop::memoryStats() const
+{
+    MemoryStats::Snapshot stats = MemoryStats::snapshot(memoryCounters_);
+    stats.add(connectionSlabPool_->memoryCounters().snapshot());
+    return stats;
+}
+
+void EventLoop::resetStats()
+{
+    iterations_ = 0;
+    eventsHandled_ = 0;
+    functorsRun_ = 0;
+    functorsDeferred_ = 0;
+    readBudgetHits_ = 0;
+    maxIterationUs_ = 0;
+    maxFunctorsUs_ = 0;
+}
@@ -5,6 +5,8 @@
 #include "Timestamp.h"
 #include "CurrentThread.h"
 #include "TimerQueue.h"
+#include "InplaceFunction.h"
+#include "MemoryStats.h"
 #include <functional>
 #include <vector>
 #include <memory>
@@ -12,12 +14,26 @@
 #include <mutex>
 
 class Channel;
+class TcpConnectionSlabPool;
 class Poller;
 // 事件循环类 主要包含了两大模块，channel poller
 class EventLoop : noncopyable
 {
 public:
-    using Functor = std::function<void()>;
+    // 只能移动，投递时不会为常见的 std::bind 对象分配内存
+    using Functor = InplaceFunction<void()>;
+
+    // 公平性统计，由loop线程更新，其他线程通过 stats() 读取快照
+    struct Stats
+    {
+        uint64_t iterations;        // 循环次数
+        uint64_t eventsHandled;     // 处理的channel事件数
+        uint64_t functorsRun;       // 执行的回调数
+        uint64_t functorsDeferred;  // 超出时间预算推迟到下一轮的回调数
+        uint64_t readBudgetHits;    // 单次读取用满字节预算的次数
+        int64_t maxIterationUs;     // 单轮循环最长耗时(微秒)
+        int64_t maxFunctorsUs;      // 单轮执行回调最长耗时(微秒)
+    };
 
     EventLoop();
     ~EventLoop();
@@ -27,6 +43,41 @@ public:
 
     Timestamp pollReturnTime() const { return pollReturnTime_; }
 
+    /**
+     * 负载指标，可以在其他线程读取，供 AdmissionController 判断是否过载
+     * loopLagMicroSeconds: poll返回到开始执行pendingFunctors的延迟(微秒，指数平滑)
+     *                      loop阻塞在poll中时为0，因为新任务可以立即执行
+     * queueSize: 等待执行的pendingFunctors数量
+     */
+    int64_t loopLagMicroSeconds() const { return polling_ ? 0 : loopLag_.load(); }
+    size_t queueSize() const { return pendingCount_; }
+
+    /**
+     * 每轮循环的预算，防止单个连接或者大量回调饿死定时器和其他fd，0表示不限制
+     * maxReadBytesPerTurn: 每个连接每轮最多读取的字节数，剩余数据在LT模式下下一轮继续读
+     * pendingFunctorsBudget: 每轮执行回调的最长时间(微秒)，剩余回调推迟到下一轮
+     */
+    void setMaxReadBytesPerTurn(size_t bytes) { maxReadBytesPerTurn_ = bytes; }
+    size_t maxReadBytesPerTurn() const { return maxReadBytesPerTurn_; }
+    void setPendingFunctorsBudget(int64_t us) { pendingFunctorsBudgetUs_ = us; }
+    int64_t pendingFunctorsBudget() const { return pendingFunctorsBudgetUs_; }
+
+    Stats stats() const;
+    void resetStats();
+    // TcpConnection 读取用满预算时调用
+    void recordReadBudgetHit() { ++readBudgetHits_; }
+
+    /**
+     * 该loop的内存统计，可以在其他线程读取
+     * loop线程中的分配(连接 Buffer 的增长、HttpContext 的内存池、日志暂存区)，
+     * 加上属于该loop的 TcpConnection 的内存块和它们构造、析构时的分配，不论在哪个线程发生
+     * 全局总和见 MemoryStats::snapshot()
+     */
+    MemoryStats::Snapshot memoryStats() const;
+
+    // 属于该loop的 TcpConnection 从这里分配，可以在任意线程使用
+    const std::shared_ptr<TcpConnectionSlabPool>& connectionSlabPool() const { return connectionSlabPool_; }
+
     // 在当前线程同步调用函数
     void runInLoop(Functor cb);
     /**
@@ -76,8 +127,24 @@ private:
     std::atomic_bool callingPendingFunctors_; // 标志当前loop是否有需要执行的回调操作
     const pid_t threadId_;      // 记录当前loop所在线程的id
     Timestamp pollReturnTime_;  // poller返回发生事件的channels的返回时间
+    std::atomic_bool polling_;          // 是否阻塞在poll中
+    std::atomic<int64_t> loopLag_;      // 平滑后的事件循环延迟(微秒)
+    std::atomic<size_t> pendingCount_;  // pendingFunctors_的大小
+
+    std::atomic<size_t> maxReadBytesPerTurn_;       // 每个连接每轮读取字节预算
+    std::atomic<int64_t> pendingFunctorsBudgetUs_;  // 每轮执行回调的时间预算
+
+    std::atomic<uint64_t> iterations_;
+    std::atomic<uint64_t> eventsHandled_;
+    std::atomic<uint64_t> functorsRun_;
+    std::atomic<uint64_t> functorsDeferred_;
+    std::atomic<uint64_t> readBudgetHits_;
+    std::atomic<int64_t> maxIterationUs_;
+    std::atomic<int64_t> maxFunctorsUs_;
     std::unique_ptr<Poller> poller_;
     std::unique_ptr<TimerQueue> timerQueue_;
+    std::shared_ptr<TcpConnectionSlabPool> connectionSlabPool_;
+    MemoryStats::ThreadCounters* memoryCounters_;   // loop线程的内存计数器
     
     /**
      * TODO:eventfd用于线程通知机制，libevent和我的webserver是使用sockepair
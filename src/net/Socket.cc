@@ -50,7 +50,7 @@ int Socket::accept(InetAddress *peeraddr)
     }
     else
     {
-        LOG_ERROR << "accept4() failed";
+        LOG_EVERY_T(ERROR, 1) << "accept4() failed";
     }
     return connfd;
 }
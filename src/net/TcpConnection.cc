@@ -32,29 +32,30 @@ TcpConnection::TcpConnection(EventLoop *loop,
     , name_(nameArg)
     , state_(kConnecting)
     , reading_(true)
-    , socket_(new Socket(sockfd))
-    , channel_(new Channel(loop, sockfd))
+    , socket_(sockfd)
+    , channel_(loop, sockfd)
     , localAddr_(localAddr)
     , peerAddr_(peerAddr)
     , highWaterMark_(64 * 1024 * 1024) // 64M 避免发送太快对方接受太慢
 {
     // 下面给channel设置相应的回调函数 poller给channel通知感兴趣的事件发生了 channel会回调相应的回调函数
-    channel_->setReadCallback(
-        std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
-    channel_->setWriteCallback(
-        std::bind(&TcpConnection::handleWrite, this));
-    channel_->setCloseCallback(
-        std::bind(&TcpConnection::handleClose, this));
-    channel_->setErrorCallback(
-        std::bind(&TcpConnection::handleError, this));
+    // 只捕获 this 的 lambda 可以放进 std::function 的内部缓冲区，不用另外分配内存
+    channel_.setReadCallback(
+        [this](Timestamp receiveTime) { handleRead(receiveTime); });
+    channel_.setWriteCallback(
+        [this]() { handleWrite(); });
+    channel_.setCloseCallback(
+        [this]() { handleClose(); });
+    channel_.setErrorCallback(
+        [this]() { handleError(); });
 
     LOG_INFO << "TcpConnection::ctor[" << name_.c_str() << "] at fd =" << sockfd;
-    socket_->setKeepAlive(true);
+    socket_.setKeepAlive(true);
 }
 
 TcpConnection::~TcpConnection()
 {
-    LOG_INFO << "TcpConnection::dtor[" << name_.c_str() << "] at fd=" << channel_->fd() << " state=" << static_cast<int>(state_);
+    LOG_INFO << "TcpConnection::dtor[" << name_.c_str() << "] at fd=" << channel_.fd() << " state=" << static_cast<int>(state_);
 }
 
 
@@ -115,14 +116,14 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
     // 之前调用过connection得shutdown，不能再进行发送了
     if (state_ == kDisconnected)
     {
-        LOG_ERROR << "disconnected, give up writing";
+        LOG_EVERY_T(ERROR, 1) << "disconnected, give up writing";
         return;
     }
 
     // channel第一次写数据，且缓冲区没有待发送数据
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    if (!channel_.isWriting() && outputBuffer_.readableBytes() == 0)
     {
-        nwrote = ::write(channel_->fd(), data, len);
+        nwrote = ::write(channel_.fd(), data, len);
         if (nwrote >= 0)
         {
             // 判断有没有一次性写完
@@ -140,7 +141,7 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
             nwrote = 0;
             if (errno != EWOULDBLOCK)
             {
-                LOG_ERROR << "TcpConnection::sendInLoop";
+                LOG_RATE_LIMITED(ERROR, 10, 50) << "TcpConnection::sendInLoop";
                 if (errno == EPIPE || errno == ECONNRESET) // SIGPIPE
                 {
                     faultError = true;
@@ -163,9 +164,9 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
                 highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
         }
         outputBuffer_.append((char *)data + nwrote, remaining);
-        if (!channel_->isWriting())
+        if (!channel_.isWriting())
         {
-            channel_->enableWriting(); // 这里一定要注册channel的写事件 否则poller不会给channel通知epollout
+            channel_.enableWriting(); // 这里一定要注册channel的写事件 否则poller不会给channel通知epollout
         }
     }
 }
@@ -183,9 +184,44 @@ void TcpConnection::shutdown()
 
 void TcpConnection::shutdownInLoop()
 {
-    if (!channel_->isWriting()) // 说明当前outputBuffer_的数据全部向外发送完成
+    if (!channel_.isWriting()) // 说明当前outputBuffer_的数据全部向外发送完成
     {
-        socket_->shutdownWrite();
+        socket_.shutdownWrite();
+    }
+}
+
+void TcpConnection::forceClose()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        loop_->queueInLoop(
+            std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::forceCloseWithDelay(double seconds)
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        // 定时器只持有弱引用，连接在此之前正常关闭则什么也不做
+        std::weak_ptr<TcpConnection> weakConn(shared_from_this());
+        loop_->runAfter(seconds, [weakConn]() {
+            TcpConnectionPtr conn = weakConn.lock();
+            if (conn)
+            {
+                conn->forceClose();
+            }
+        });
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        handleClose();
     }
 }
 
@@ -195,13 +231,13 @@ void TcpConnection::connectEstablished()
     setState(kConnected); // 建立连接，设置一开始状态为连接态
     /**
      * TODO:tie
-     * channel_->tie(shared_from_this());
+     * channel_.tie(shared_from_this());
      * tie相当于在底层有一个强引用指针记录着，防止析构
      * 为了防止TcpConnection这个资源被误删掉，而这个时候还有许多事件要处理
      * channel->tie 会进行一次判断，是否将弱引用指针变成强引用，变成得话就防止了计数为0而被析构得可能
      */
-    channel_->tie(shared_from_this());
-    channel_->enableReading(); // 向poller注册channel的EPOLLIN读事件
+    channel_.tie(shared_from_this());
+    channel_.enableReading(); // 向poller注册channel的EPOLLIN读事件
 
     // 新连接建立 执行回调
     connectionCallback_(shared_from_this());
@@ -213,19 +249,25 @@ void TcpConnection::connectDestroyed()
     if (state_ == kConnected)
     {
         setState(kDisconnected);
-        channel_->disableAll(); // 把channel的所有感兴趣的事件从poller中删除掉
+        channel_.disableAll(); // 把channel的所有感兴趣的事件从poller中删除掉
         connectionCallback_(shared_from_this());
     }
-    channel_->remove(); // 把channel从poller中删除掉
+    channel_.remove(); // 把channel从poller中删除掉
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
     int savedErrno = 0;
     // TcpConnection会从socket读取数据，然后写入inpuBuffer
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+    // 每轮读取受loop的字节预算限制，避免一个连接占满整轮循环
+    size_t budget = loop_->maxReadBytesPerTurn();
+    ssize_t n = inputBuffer_.readFd(channel_.fd(), &savedErrno, budget);
     if (n > 0)
     {
+        if (budget > 0 && static_cast<size_t>(n) == budget)
+        {
+            loop_->recordReadBudgetHit();
+        }
         // 已建立连接的用户，有可读事件发生，调用用户传入的回调操作
         // TODO:shared_from_this
         messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
@@ -239,17 +281,17 @@ void TcpConnection::handleRead(Timestamp receiveTime)
     {
         // 出错情况
         errno = savedErrno;
-        LOG_ERROR << "TcpConnection::handleRead() failed";
+        LOG_RATE_LIMITED(ERROR, 10, 50) << "TcpConnection::handleRead() failed";
         handleError();
     }
 }
 
 void TcpConnection::handleWrite()
 {
-    if (channel_->isWriting())
+    if (channel_.isWriting())
     {
         int saveErrno = 0;
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &saveErrno);
+        ssize_t n = outputBuffer_.writeFd(channel_.fd(), &saveErrno);
         // 正确读取数据
         if (n > 0)
         {
@@ -258,7 +300,7 @@ void TcpConnection::handleWrite()
             // 此时就可以关闭连接，否则还需继续提醒写事件
             if (outputBuffer_.readableBytes() == 0)
             {
-                channel_->disableWriting();
+                channel_.disableWriting();
                 // 调用用户自定义的写完数据处理函数
                 if (writeCompleteCallback_)
                 {
@@ -273,20 +315,20 @@ void TcpConnection::handleWrite()
         }
         else
         {
-            LOG_ERROR << "TcpConnection::handleWrite() failed";
+            LOG_RATE_LIMITED(ERROR, 10, 50) << "TcpConnection::handleWrite() failed";
         }
     }
     // state_不为写状态
     else
     {
-        LOG_ERROR << "TcpConnection fd=" << channel_->fd() << " is down, no more writing";
+        LOG_EVERY_T(ERROR, 1) << "TcpConnection fd=" << channel_.fd() << " is down, no more writing";
     }
 }
 
 void TcpConnection::handleClose()
 {
     setState(kDisconnected);    // 设置状态为关闭连接状态
-    channel_->disableAll();     // 注销Channel所有感兴趣事件
+    channel_.disableAll();     // 注销Channel所有感兴趣事件
     
     TcpConnectionPtr connPtr(shared_from_this());
     connectionCallback_(connPtr);   
@@ -299,7 +341,7 @@ void TcpConnection::handleError()
     socklen_t optlen = sizeof(optval);
     int err = 0;
     // TODO:getsockopt ERROR
-    if (::getsockopt(channel_->fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen))
+    if (::getsockopt(channel_.fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen))
     {
         err = errno;
     }
@@ -307,5 +349,5 @@ void TcpConnection::handleError()
     {
         err = optval;
     }
-    LOG_ERROR << "cpConnection::handleError name:" << name_.c_str() << " - SO_ERROR:" << err;
+    LOG_RATE_LIMITED(ERROR, 10, 50) << "TcpConnection::handleError name:" << name_.c_str() << " - SO_ERROR:" << err;
 }
\ No newline at end of file
@@ -11,10 +11,10 @@
 #include "Buffer.h"
 #include "Timestamp.h"
 #include "InetAddress.h"
+#include "Socket.h"
+#include "Channel.h"
 
-class Channel;
 class EventLoop;
-class Socket;
 
 class TcpConnection : noncopyable, 
     public std::enable_shared_from_this<TcpConnection>
@@ -40,6 +40,10 @@ public:
 
     // 关闭连接
     void shutdown();
+    // 不等待对端，直接关闭连接
+    void forceClose();
+    // seconds 秒后连接仍未断开则强制关闭，用于对端不响应关闭的情况
+    void forceCloseWithDelay(double seconds);
 
     // 保存用户自定义的回调函数
     void setConnectionCallback(const ConnectionCallback &cb)
@@ -52,6 +56,12 @@ public:
     { closeCallback_ = cb; }
     void setHighWaterMarkCallback(const HighWaterMarkCallback &cb, size_t highWaterMark)
     { highWaterMarkCallback_ = cb; highWaterMark_ = highWaterMark; }
+
+    // 连接上下文，由上层协议保存自己的解析状态(muduo中使用boost::any)
+    void setContext(const std::shared_ptr<void> &context)
+    { context_ = context; }
+    const std::shared_ptr<void>& getContext() const
+    { return context_; }
     
     // TcpServer会调用
     void connectEstablished(); // 连接建立
@@ -77,14 +87,16 @@ private:
     void sendInLoop(const void* message, size_t len);
     void sendInLoop(const std::string& message);
     void shutdownInLoop();
+    void forceCloseInLoop();
     
     EventLoop *loop_;           // 属于哪个subLoop（如果是单线程则为mainLoop）
     const std::string name_;
     std::atomic_int state_;     // 连接状态
     bool reading_;
 
-    std::unique_ptr<Socket> socket_;;
-    std::unique_ptr<Channel> channel_;
+    // 直接作为成员，和 TcpConnection 在同一块内存中，见 TcpConnectionSlabPool
+    Socket socket_;
+    Channel channel_;
 
     const InetAddress localAddr_;   // 本服务器地址
     const InetAddress peerAddr_;    // 对端地址
@@ -102,6 +114,8 @@ private:
 
     Buffer inputBuffer_;    // 读取数据的缓冲区
     Buffer outputBuffer_;   // 发送数据的缓冲区
+
+    std::shared_ptr<void> context_; // 上层协议的连接上下文
 };
 
 #endif // TCP_CONNECTION_H
\ No newline at end of file
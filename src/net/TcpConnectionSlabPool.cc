@@ -0,0 +1,99 @@
+#include "TcpConnectionSlabPool.h"
+
+TcpConnectionSlabPool::TcpConnectionSlabPool(size_t maxCached)
+    : freeList_(nullptr),
+      cached_(0),
+      maxCached_(maxCached),
+      slabSize_(0),
+      allocated_(0),
+      reused_(0)
+{
+}
+
+TcpConnectionSlabPool::~TcpConnectionSlabPool()
+{
+    while (freeList_ != nullptr)
+    {
+        FreeSlab* next = freeList_->next;
+        ::operator delete(freeList_);
+        memoryCounters_.record(MemoryStats::kConnection, -static_cast<int64_t>(slabSize_));
+        freeList_ = next;
+    }
+}
+
+void* TcpConnectionSlabPool::allocate(size_t size)
+{
+    ++allocated_;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (slabSize_ == 0)
+        {
+            slabSize_ = size;
+        }
+        if (size == slabSize_ && freeList_ != nullptr)
+        {
+            FreeSlab* slab = freeList_;
+            freeList_ = slab->next;
+            --cached_;
+            ++reused_;
+            return slab;
+        }
+    }
+    void* p = ::operator new(size);
+    memoryCounters_.record(MemoryStats::kConnection, size);
+    return p;
+}
+
+void TcpConnectionSlabPool::deallocate(void* p, size_t size)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (size == slabSize_ && cached_ < maxCached_)
+        {
+            FreeSlab* slab = static_cast<FreeSlab*>(p);
+            slab->next = freeList_;
+            freeList_ = slab;
+            ++cached_;
+            return;
+        }
+    }
+    ::operator delete(p);
+    memoryCounters_.record(MemoryStats::kConnection, -static_cast<int64_t>(size));
+}
+
+void TcpConnectionSlabPool::setMaxCached(size_t maxCached)
+{
+    FreeSlab* release = nullptr;
+    size_t slabSize = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        maxCached_ = maxCached;
+        slabSize = slabSize_;
+        while (cached_ > maxCached_)
+        {
+            FreeSlab* slab = freeList_;
+            freeList_ = slab->next;
+            slab->next = release;
+            release = slab;
+            --cached_;
+        }
+    }
+    while (release != nullptr)
+    {
+        FreeSlab* next = release->next;
+        ::operator delete(release);
+        memoryCounters_.record(MemoryStats::kConnection, -static_cast<int64_t>(slabSize));
+        release = next;
+    }
+}
+
+TcpConnectionSlabPool::Stats TcpConnectionSlabPool::stats() const
+{
+    Stats stats;
+    stats.allocated = allocated_;
+    stats.reused = reused_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.cached = cached_;
+    stats.cachedBytes = cached_ * slabSize_;
+    return stats;
+}
@@ -0,0 +1,143 @@
+#ifndef TCP_CONNECTION_SLAB_POOL_H
+#define TCP_CONNECTION_SLAB_POOL_H
+
+#include "noncopyable.h"
+#include "MemoryStats.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stddef.h>
+#include <utility>
+
+/**
+ * 每个 EventLoop 一个，缓存 TcpConnection 使用过的内存块
+ *
+ * TcpConnection 通过 std::allocate_shared 创建，Socket、Channel 是它的成员，
+ * 连同 shared_ptr 的控制块一共只占一块内存
+ * 最后一个 shared_ptr/weak_ptr 释放时这块内存回到所属loop的池中，下一个连接直接复用
+ *
+ * 最后的引用可能在任意线程释放(例如交给 ThreadPool 的 HttpResponseWriter)，所以用互斥锁保护
+ * 池本身由 shared_ptr 管理，每个分配出去的块都持有一份引用，loop 先析构也没有问题
+ * 向系统申请和归还的内存计入池自己的 MemoryStats::kConnection，缓存中的块也算作占用
+ * 连接在 mainLoop 创建、在任意线程销毁，构造和析构期间的内存(例如 Buffer)也计入池，
+ * 这样 EventLoop::memoryStats() 统计的是属于该loop的连接，而不是恰好执行分配的线程
+ */
+class TcpConnectionSlabPool : noncopyable
+{
+public:
+    struct Stats
+    {
+        size_t allocated;   // 累计分配次数
+        size_t reused;      // 其中复用缓存块的次数
+        size_t cached;      // 当前缓存的块数
+        size_t cachedBytes; // 缓存块占用的字节数
+    };
+
+    static const size_t kDefaultMaxCached = 1024;
+
+    explicit TcpConnectionSlabPool(size_t maxCached = kDefaultMaxCached);
+    ~TcpConnectionSlabPool();
+
+    /**
+     * 第一次分配的大小作为块大小，之后大小相同的请求走缓存，其他大小直接使用 operator new
+     * 缓存超过 maxCached 个块时多余的块直接释放，0 表示不缓存
+     */
+    void* allocate(size_t size);
+    void deallocate(void* p, size_t size);
+
+    void setMaxCached(size_t maxCached);
+    Stats stats() const;
+
+    MemoryStats::SharedCounters& memoryCounters() { return memoryCounters_; }
+    const MemoryStats::SharedCounters& memoryCounters() const { return memoryCounters_; }
+
+private:
+    // 空闲块的前8字节存放下一个空闲块的地址
+    struct FreeSlab
+    {
+        FreeSlab* next;
+    };
+
+    mutable std::mutex mutex_;
+    FreeSlab* freeList_;
+    size_t cached_;
+    size_t maxCached_;
+    size_t slabSize_;
+    std::atomic<size_t> allocated_;
+    std::atomic<size_t> reused_;
+    MemoryStats::SharedCounters memoryCounters_;
+};
+
+/**
+ * allocate_shared 使用的分配器，控制块和 TcpConnection 从池中的同一块内存分配
+ * 保存池的 shared_ptr，控制块中的分配器副本保证释放时池仍然存在
+ */
+template <typename T>
+class TcpConnectionAllocator
+{
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = TcpConnectionAllocator<U>;
+    };
+
+    explicit TcpConnectionAllocator(const std::shared_ptr<TcpConnectionSlabPool>& pool) noexcept
+        : pool_(pool)
+    {
+    }
+
+    template <typename U>
+    TcpConnectionAllocator(const TcpConnectionAllocator<U>& other) noexcept
+        : pool_(other.pool())
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(pool_->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n) noexcept
+    {
+        pool_->deallocate(p, n * sizeof(T));
+    }
+
+    // allocate_shared 通过 allocator_traits 调用，TcpConnection 构造和析构中的内存计入池
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args)
+    {
+        MemoryStats::ScopedCounters scope(&pool_->memoryCounters());
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+
+    template <typename U>
+    void destroy(U* p)
+    {
+        MemoryStats::ScopedCounters scope(&pool_->memoryCounters());
+        p->~U();
+    }
+
+    const std::shared_ptr<TcpConnectionSlabPool>& pool() const noexcept { return pool_; }
+
+private:
+    std::shared_ptr<TcpConnectionSlabPool> pool_;
+};
+
+template <typename T, typename U>
+bool operator==(const TcpConnectionAllocator<T>& lhs, const TcpConnectionAllocator<U>& rhs) noexcept
+{
+    return lhs.pool() == rhs.pool();
+}
+
+template <typename T, typename U>
+bool operator!=(const TcpConnectionAllocator<T>& lhs, const TcpConnectionAllocator<U>& rhs) noexcept
+{
+    return lhs.pool() != rhs.pool();
+}
+
+#endif // TCP_CONNECTION_SLAB_POOL_H
@@ -1,8 +1,10 @@
 #include <functional>
 #include <string.h>
+#include <unistd.h>
 
 #include "TcpServer.h"
 #include "TcpConnection.h"
+#include "TcpConnectionSlabPool.h"
 #include "Logging.h"
 
 // 检查传入的 baseLoop 指针是否有意义
@@ -73,6 +75,13 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
 {
     // 轮询算法 选择一个subLoop 来管理connfd对应的channel
     EventLoop *ioLoop = threadPool_->getNextLoop();
+    // subLoop过载，直接拒绝，避免继续排队拖慢所有连接
+    if (admissionController_ && !admissionController_->admitConnection(ioLoop))
+    {
+        LOG_EVERY_T(WARN, 1) << "TcpServer::newConnection [" << name_.c_str() << "] - loop overloaded, reject connection from " << peerAddr.toIpPort().c_str();
+        ::close(sockfd);
+        return;
+    }
     // 提示信息
     char buf[64] = {0};
     snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
@@ -93,11 +102,14 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
     }
 
     InetAddress localAddr(local);
-    TcpConnectionPtr conn(new TcpConnection(ioLoop,
-                                            connName,
-                                            sockfd,
-                                            localAddr,
-                                            peerAddr));
+    // 控制块、TcpConnection、Socket、Channel 一次分配，内存来自 ioLoop 的池，释放时还回去
+    TcpConnectionPtr conn = std::allocate_shared<TcpConnection>(
+        TcpConnectionAllocator<TcpConnection>(ioLoop->connectionSlabPool()),
+        ioLoop,
+        connName,
+        sockfd,
+        localAddr,
+        peerAddr);
     connections_[connName] = conn;
     // 下面的回调都是用户设置给TcpServer => TcpConnection的，至于Channel绑定的则是TcpConnection设置的四个，handleRead,handleWrite... 这下面的回调用于handlexxx函数中
     conn->setConnectionCallback(connectionCallback_);
@@ -106,7 +118,7 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
 
     // 设置了如何关闭连接的回调
     conn->setCloseCallback(
-        std::bind(&TcpServer::removeConnection, this, std::placeholders::_1));
+        [this](const TcpConnectionPtr& connection) { removeConnection(connection); });
 
     ioLoop->runInLoop(
         std::bind(&TcpConnection::connectEstablished, conn));
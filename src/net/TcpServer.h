@@ -14,6 +14,7 @@
 #include "noncopyable.h"
 #include "Callback.h"
 #include "TcpConnection.h"
+#include "AdmissionController.h"
 
 /**
  * 我们用户编写的时候就是使用的TcpServer
@@ -42,6 +43,9 @@ public:
     void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
     void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
 
+    // 设置过载保护，分配到的subLoop过载时直接关闭新连接
+    void setAdmissionController(const std::shared_ptr<AdmissionController> &controller) { admissionController_ = controller; }
+
     // 设置底层subLoop的个数
     void setThreadNum(int numThreads);
 
@@ -50,6 +54,9 @@ public:
     
     EventLoop* getLoop() const { return loop_; }
 
+    // start() 之后可以获取所有的subLoop
+    std::shared_ptr<EventLoopThreadPool> threadPool() { return threadPool_; }
+
     const std::string name() { return name_; }
 
     const std::string ipPort() { return ipPort_; }
@@ -80,6 +87,8 @@ private:
     ThreadInitCallback threadInitCallback_;  // loop线程初始化的回调函数
     std::atomic_int started_;                // TcpServer
 
+    std::shared_ptr<AdmissionController> admissionController_; // 过载保护
+
     int nextConnId_;            // 连接索引
     ConnectionMap connections_; // 保存所有的连接
 };
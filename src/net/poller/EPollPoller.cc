@@ -53,7 +53,7 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
         if (saveErrno != EINTR)
         {
             errno = saveErrno;
-            LOG_ERROR << "EPollPoller::poll() failed";
+            LOG_EVERY_T(ERROR, 1) << "EPollPoller::poll() failed";
         }
     }
     return now;
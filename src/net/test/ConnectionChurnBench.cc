@@ -0,0 +1,107 @@
+#include "TcpConnectionSlabPool.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "Logging.h"
+#include "TcpServer.h"
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+/**
+ * 短连接吞吐：客户端线程不断 connect，服务端在连接建立时 shutdown，
+ * 客户端读到 EOF 后 close，服务端随后销毁连接
+ * 分别在 TcpConnectionSlabPool 缓存打开和关闭(maxCached = 0)时测试每秒完成的连接数
+ *
+ * ./ConnectionChurnBench [连接数] [subLoop 数] [起始端口]
+ */
+void runClient(uint16_t port, int connections)
+{
+    sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    for (int i = 0; i < connections; ++i)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0)
+        {
+            perror("connect");
+            ::close(fd);
+            continue;
+        }
+        char buf[16];
+        while (::read(fd, buf, sizeof buf) > 0)
+        {
+        }
+        ::close(fd);
+    }
+}
+
+void bench(uint16_t port, int connections, int ioThreads, bool pooled)
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "ChurnServer");
+    server.setThreadNum(ioThreads);
+
+    int closed = 0;
+    server.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+        if (conn->connected())
+        {
+            conn->shutdown();
+        }
+        else
+        {
+            // 连接断开的回调在各自的subLoop中执行，计数交给mainLoop
+            loop.runInLoop([&]() {
+                if (++closed == connections)
+                {
+                    loop.quit();
+                }
+            });
+        }
+    });
+    server.start();
+
+    std::vector<EventLoop*> loops = server.threadPool()->getAllLoops();
+    for (EventLoop* ioLoop : loops)
+    {
+        ioLoop->connectionSlabPool()->setMaxCached(pooled ? TcpConnectionSlabPool::kDefaultMaxCached : 0);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread client(runClient, port, connections);
+    loop.loop();
+    auto end = std::chrono::steady_clock::now();
+    client.join();
+
+    size_t allocated = 0;
+    size_t reused = 0;
+    for (EventLoop* ioLoop : loops)
+    {
+        TcpConnectionSlabPool::Stats stats = ioLoop->connectionSlabPool()->stats();
+        allocated += stats.allocated;
+        reused += stats.reused;
+    }
+    double seconds = std::chrono::duration<double>(end - start).count();
+    printf("%-8s ioThreads=%d connections=%d %8.0f conn/s  slabs reused %zu/%zu\n",
+           pooled ? "pooled" : "unpooled", ioThreads, connections,
+           connections / seconds, reused, allocated);
+}
+
+int main(int argc, char* argv[])
+{
+    int connections = argc > 1 ? atoi(argv[1]) : 20000;
+    int ioThreads = argc > 2 ? atoi(argv[2]) : 1;
+    uint16_t port = static_cast<uint16_t>(argc > 3 ? atoi(argv[3]) : 19981);
+
+    Logger::setLogLevel(Logger::WARN);
+    bench(port, connections, ioThreads, false);
+    bench(static_cast<uint16_t>(port + 1), connections, ioThreads, true);
+    return 0;
+}
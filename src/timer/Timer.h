@@ -3,7 +3,7 @@
 
 #include "noncopyable.h"
 #include "Timestamp.h"
-#include <functional>
+#include "InplaceFunction.h"
 
 /**
  * Timer用于描述一个定时器
@@ -12,10 +12,10 @@
 class Timer : noncopyable
 {
 public:
-    using TimerCallback = std::function<void()>;
+    using TimerCallback = InplaceFunction<void()>;
 
     Timer(TimerCallback cb, Timestamp when, double interval)
-        : callback_(move(cb)),
+        : callback_(std::move(cb)),
           expiration_(when),
           interval_(interval),
           repeat_(interval > 0.0) // 一次性定时器设置为0
@@ -3,17 +3,17 @@
 
 #include "Timestamp.h"
 #include "Channel.h"
+#include "Timer.h"
 
 #include <vector>
 #include <set>
 
 class EventLoop;
-class Timer;
 
 class TimerQueue
 {
 public:
-    using TimerCallback = std::function<void()>;
+    using TimerCallback = Timer::TimerCallback;
 
     explicit TimerQueue(EventLoop* loop);
     ~TimerQueue();